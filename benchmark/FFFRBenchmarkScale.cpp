@@ -0,0 +1,89 @@
+/**
+ * Copyright 2019 Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "../test/FFFRTestData.h"
+#include "FFFrameReader.h"
+
+#include <algorithm>
+#include <benchmark/benchmark.h>
+
+using namespace Ffr;
+
+constexpr uint32_t iterations = 50;
+
+class BenchScale : public benchmark::Fixture
+{
+public:
+    void SetUp(::benchmark::State& state)
+    {
+        setLogLevel(LogLevel::Quiet);
+        // Use the first available 4K test file
+        const auto found = std::find_if(
+            g_testData.begin(), g_testData.end(), [](const TestParams& params) { return params.m_width == 3840; });
+        if (found == g_testData.end()) {
+            state.SkipWithError("No 4K input stream available");
+            return;
+        }
+        DecoderOptions options;
+        options.m_scale = {1920, 1080};
+        options.m_scaleAlgorithm = static_cast<ScaleAlgorithm>(state.range(0));
+        m_stream = Stream::getStream(found->m_fileName, options);
+        if (m_stream == nullptr) {
+            state.SkipWithError("Failed to create input stream");
+        }
+    }
+
+    void TearDown(const ::benchmark::State&)
+    {
+        m_stream.reset();
+    }
+
+    std::shared_ptr<Stream> m_stream = nullptr;
+};
+
+BENCHMARK_DEFINE_F(BenchScale, read)(benchmark::State& state)
+{
+    if (m_stream == nullptr) {
+        return;
+    }
+    if (iterations >= m_stream->getTotalFrames()) {
+        state.SkipWithError("Cannot perform required iterations on input stream");
+    }
+    for (auto _ : state) {
+        state.PauseTiming();
+        // Ignore the seek back to start after each loop
+        (void)m_stream->seek(0);
+        state.ResumeTiming();
+        for (int64_t i = 0; i < iterations; ++i) {
+            if (m_stream->getNextFrame() == nullptr) {
+                state.SkipWithError("Failed to retrieve valid frame");
+                break;
+            }
+        }
+    }
+}
+
+// Parameters in order are:
+//  1. The scale algorithm
+static void customArguments(benchmark::internal::Benchmark* b)
+{
+    for (int64_t algorithm = static_cast<int64_t>(ScaleAlgorithm::FastBilinear);
+         algorithm <= static_cast<int64_t>(ScaleAlgorithm::Lanczos); ++algorithm) {
+        b->Args({algorithm});
+    }
+    b->Unit(benchmark::kMillisecond);
+}
+
+BENCHMARK_REGISTER_F(BenchScale, read)->Apply(customArguments);
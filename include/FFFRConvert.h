@@ -0,0 +1,145 @@
+/**
+ * Copyright 2019 Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "FFFrameReader.h"
+
+namespace Ffr {
+class Convert
+{
+public:
+    /**
+     * Gets the number of tensor channels for a pixel format.
+     * @param format The pixel format of the tensor.
+     * @returns The number of channels or negative value if the format can not be used for tensors.
+     */
+    FFFRAMEREADER_NO_EXPORT static int32_t getTensorChannels(PixelFormat format) noexcept;
+
+    /**
+     * Gets the size in bytes of a single tensor element.
+     * @param type The tensor data type.
+     * @returns The element size in bytes.
+     */
+    FFFRAMEREADER_NO_EXPORT static uint32_t getTensorElementSize(TensorType type) noexcept;
+
+    /**
+     * Query if conversion options require values to be scaled or offset.
+     * @param options The conversion options.
+     * @returns True if normalisation is required, false if values are only converted.
+     */
+    FFFRAMEREADER_NO_EXPORT static bool hasNormalisation(const ConvertOptions& options) noexcept;
+
+    /**
+     * Converts a host frame and writes it into a tensor.
+     * @param       frame   The input frame.
+     * @param [out] outMem  Memory location to store the frames tensor data (must be allocated with enough size for a
+     *  single frame see @getTensorSize).
+     * @param       format  The pixel format used to determine the tensor channels.
+     * @param       layout  The tensor memory layout.
+     * @param       type    The tensor data type.
+     * @param       options The conversion options.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT static bool convertToTensor(const Frame& frame, uint8_t* outMem, PixelFormat format,
+        TensorLayout layout, TensorType type, const ConvertOptions& options) noexcept;
+
+    /**
+     * Converts a frame in CUDA device memory and writes it into a tensor using cuda.
+     * @note Only NV12 frames converted to RGB channels (RGB8, RGB8P or RGB32FP) with the Float16 type are supported.
+     * @param       frame   The input frame.
+     * @param [out] outMem  Device memory location to store the frames tensor data (must be allocated with enough size
+     *  for a single frame see @getTensorSize).
+     * @param       format  The pixel format used to determine the tensor channels.
+     * @param       layout  The tensor memory layout.
+     * @param       type    The tensor data type.
+     * @param       options The conversion options.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT static bool convertToTensorCuda(const Frame& frame, uint8_t* outMem, PixelFormat format,
+        TensorLayout layout, TensorType type, const ConvertOptions& options) noexcept;
+
+    /**
+     * Converts a host frame into an image with the same memory layout as used by @convertFormat.
+     * @param       frame     The input frame.
+     * @param [out] outMem    Memory location to store output (must be allocated with enough size for output frame see
+     *  @getImageSize).
+     * @param       outFormat The pixel format to convert to.
+     * @param       options   The conversion options.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT static bool convertToImage(
+        const Frame& frame, uint8_t* outMem, PixelFormat outFormat, const ConvertOptions& options) noexcept;
+
+private:
+    /**
+     * Converts a host frame and writes each channel to separate strided destinations.
+     * @param       frame      The input frame.
+     * @param [out] dest       The first element of each output channel.
+     * @param       channels   The number of output channels (1 outputs only luma).
+     * @param       pixelStep  The distance in bytes between consecutive pixels of a channel.
+     * @param       rowStep    The distance in bytes between consecutive rows of a channel.
+     * @param       type       The output data type.
+     * @param       toRGB      True to convert YUV input to RGB.
+     * @param       options    The conversion options.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT static bool convert(const Frame& frame, uint8_t* dest[3], int32_t channels,
+        size_t pixelStep, size_t rowStep, TensorType type, bool toRGB, const ConvertOptions& options) noexcept;
+
+    /**
+     * Reads a row of a frame into separate channels with values in the range [0, 255].
+     * @param       frame    The input frame.
+     * @param       row      The row to read.
+     * @param [out] channels The output channel rows (each must be at least frame width in size).
+     * @param       toRGB    True to convert YUV input to RGB.
+     * @returns True if it succeeds, false if the input format is not supported.
+     */
+    FFFRAMEREADER_NO_EXPORT static bool readRow(
+        const Frame& frame, uint32_t row, float* channels[3], bool toRGB) noexcept;
+
+    /**
+     * Converts single precision values to IEEE-754 half precision.
+     * @param       source The input values.
+     * @param [out] dest   The output half precision values.
+     * @param       count  The number of values.
+     */
+    FFFRAMEREADER_NO_EXPORT static void floatToHalf(const float* source, uint16_t* dest, uint32_t count) noexcept;
+
+    /**
+     * Converts a single precision value to IEEE-754 half precision using round to nearest even.
+     * @param value The input value.
+     * @returns The half precision value.
+     */
+    FFFRAMEREADER_NO_EXPORT static uint16_t floatToHalf(float value) noexcept;
+
+    /**
+     * Query if the host cpu supports the F16C conversion instructions.
+     * @note This is only available on x86 targets.
+     * @returns True if supported.
+     */
+    FFFRAMEREADER_NO_EXPORT static bool hasF16C() noexcept;
+
+    /**
+     * Converts single precision values to half precision using F16C instructions.
+     * @note This is only available on x86 targets.
+     * @param       source The input values.
+     * @param [out] dest   The output half precision values.
+     * @param       count  The number of values.
+     * @returns The number of values converted, any remaining values must be converted separately.
+     */
+    FFFRAMEREADER_NO_EXPORT static uint32_t floatToHalfF16C(
+        const float* source, uint16_t* dest, uint32_t count) noexcept;
+};
+} // namespace Ffr
@@ -17,7 +17,21 @@
 
 #include "FFFRStream.h"
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct AVBSFContext;
+struct AVCodecParameters;
+struct AVPacket;
+struct AVStream;
+
 namespace Ffr {
+template<typename T>
+class Queue;
+
 class Encoder
 {
     friend class Fmc::MultiCrop;
@@ -25,7 +39,7 @@ class Encoder
 public:
     FFFRAMEREADER_NO_EXPORT Encoder() = delete;
 
-    FFFRAMEREADER_EXPORT ~Encoder() = default;
+    FFFRAMEREADER_EXPORT ~Encoder() noexcept;
 
     FFFRAMEREADER_NO_EXPORT Encoder(const Encoder& other) = delete;
 
@@ -45,6 +59,140 @@ public:
     FFFRAMEREADER_EXPORT static bool encodeStream(const std::string& fileName, const std::shared_ptr<Stream>& stream,
         const EncoderOptions& options = EncoderOptions()) noexcept;
 
+    /**
+     * Encodes a stream to multiple files. The stream is only decoded once and each decoded frame is shared between all
+     * outputs, which are each scaled and encoded on their own thread.
+     * @note Scaled outputs require the stream to output frames in host memory. The segmented and pipelined encoder
+     *  options are ignored.
+     * @param outputs The outputs to encode.
+     * @param stream  The stream to encode.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_EXPORT static bool encodeStream(
+        const std::vector<EncoderOutput>& outputs, const std::shared_ptr<Stream>& stream) noexcept;
+
+    /**
+     * Decodes a stream once into a lossless intra-only intermediate file that can be read back much faster than the
+     * source. The streams output (including any crop, scale and format conversion) is encoded using FFV1 with every
+     * frame as a separately indexed key frame, so the cache can be opened with @Stream::getStream and any frame can be
+     * accessed directly.
+     * @note A Matroska (.mkv) file should be used so that every frame is indexed.
+     * @param fileName   File name of the cache file to write to.
+     * @param stream     The stream to cache.
+     * @param numThreads (Optional) Number of threads to use for encoding (0 for default).
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_EXPORT static bool cacheStream(
+        const std::string& fileName, const std::shared_ptr<Stream>& stream, uint32_t numThreads = 0) noexcept;
+
+    /**
+     * Copies the compressed packets of a stream to a file without re-encoding. Copying starts at the key frame at or
+     * before the requested start time so the output may begin slightly earlier than requested. Output time stamps are
+     * rebased so that the first copied packet starts at zero.
+     * @note The stream's source is re-opened so the current decode position of the stream is not affected.
+     * @note Packets are selected in decode order. Streams with B-frames may therefore also contain a few frames
+     *  presented at or after the end time, as these are needed to decode frames displayed before it. Use
+     *  @cutStream for exact cut points.
+     * @param fileName  File name of the file to write to.
+     * @param stream    The stream to copy.
+     * @param startTime (Optional) The start time in microseconds (AV_TIME_BASE).
+     * @param endTime   (Optional) The time in microseconds (AV_TIME_BASE) to stop copying at (exclusive).
+     * @param options   (Optional) Options for controlling the output. Only the output settings (such as the writer
+     *  and fragmentation) are used.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_EXPORT static bool copyStream(const std::string& fileName, const std::shared_ptr<Stream>& stream,
+        int64_t startTime = 0, int64_t endTime = INT64_MAX, const EncoderOptions& options = EncoderOptions()) noexcept;
+
+    /**
+     * Copies the compressed packets of a stream to a file without re-encoding. Copying starts at the key frame at or
+     * before the requested start frame.
+     * @note This will not be fully accurate when dealing with VFR video streams.
+     * @param fileName   File name of the file to write to.
+     * @param stream     The stream to copy.
+     * @param startFrame The zero-based first frame to copy.
+     * @param endFrame   The zero-based frame number to stop copying at (exclusive).
+     * @param options    (Optional) Options for controlling the output. Only the output settings (such as the writer
+     *  and fragmentation) are used.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_EXPORT static bool copyStreamFrames(const std::string& fileName,
+        const std::shared_ptr<Stream>& stream, int64_t startFrame, int64_t endFrame,
+        const EncoderOptions& options = EncoderOptions()) noexcept;
+
+    /**
+     * Copies a time range of a stream to a file with frame accurate cut points. Only the partial groups of pictures
+     * at the start and end of the range are re-encoded (using an encoder matched to the source codec), all complete
+     * groups of pictures in between are copied without re-encoding. Leading pictures of the key frame that ends the
+     * copied section (as found in open groups of pictures) are re-encoded along with the end of the range. Codec
+     * headers are stored in-band in every section (using avc3/hev1 sample entries for MP4/MOV outputs).
+     * @note Only H.264 and H.265 sources are supported. The options type is ignored.
+     * @param fileName  File name of the file to write to.
+     * @param stream    The stream to cut.
+     * @param startTime The start time in microseconds (AV_TIME_BASE).
+     * @param endTime   The time in microseconds (AV_TIME_BASE) to stop at (exclusive).
+     * @param options   (Optional) Options for controlling encoding of the partial groups of pictures.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_EXPORT static bool cutStream(const std::string& fileName, const std::shared_ptr<Stream>& stream,
+        int64_t startTime, int64_t endTime, const EncoderOptions& options = EncoderOptions()) noexcept;
+
+    /**
+     * Copies a frame range of a stream to a file with frame accurate cut points.
+     * @note This will not be fully accurate when dealing with VFR video streams.
+     * @param fileName   File name of the file to write to.
+     * @param stream     The stream to cut.
+     * @param startFrame The zero-based first frame to output.
+     * @param endFrame   The zero-based frame number to stop at (exclusive).
+     * @param options    (Optional) Options for controlling encoding of the partial groups of pictures.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_EXPORT static bool cutStreamFrames(const std::string& fileName,
+        const std::shared_ptr<Stream>& stream, int64_t startFrame, int64_t endFrame,
+        const EncoderOptions& options = EncoderOptions()) noexcept;
+
+    /**
+     * Creates an encoder that frames can be pushed to from any source. Frames are encoded asynchronously so that
+     * pushing only blocks if the encoder falls too far behind.
+     * @param fileName  File name of the file to write to.
+     * @param width     The width of all pushed frames.
+     * @param height    The height of all pushed frames.
+     * @param format    The pixel format of all pushed frames.
+     * @param frameRate The frame rate.
+     * @param options   (Optional) Options for controlling encoding.
+     * @param aspect    (Optional) The sample aspect ratio.
+     * @returns The new encoder if succeeded, nullptr otherwise.
+     */
+    FFFRAMEREADER_EXPORT static std::shared_ptr<Encoder> getEncoder(const std::string& fileName, uint32_t width,
+        uint32_t height, PixelFormat format, Rational frameRate, const EncoderOptions& options = EncoderOptions(),
+        Rational aspect = {1, 1}) noexcept;
+
+    /**
+     * Adds a frame to be encoded. The frame must be in host memory and match the encoders dimensions and format.
+     * @note The frames memory is referenced until it has been encoded so it must not be modified.
+     * @param frame The frame, its time stamp is used as the presentation time.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_EXPORT bool pushFrame(const Frame& frame) noexcept;
+
+    /**
+     * Adds raw image data to be encoded. The data is copied so can be reused as soon as this returns.
+     * @param planes    The data of each image plane (in the encoders pixel format).
+     * @param strides   The line size in bytes of each image plane.
+     * @param numPlanes The number of entries in planes and strides, must match the planes of the pixel format.
+     * @param timeStamp The presentation time stamp in microseconds.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_EXPORT bool pushRaw(
+        const uint8_t* const planes[], const int32_t strides[], uint32_t numPlanes, int64_t timeStamp) noexcept;
+
+    /**
+     * Encodes any remaining pushed frames and finalises the output file. No more frames can be pushed after this.
+     * @note This is also performed when the encoder is destroyed.
+     * @returns True if it succeeds, false if any frame failed to be encoded/written.
+     */
+    FFFRAMEREADER_EXPORT bool finish() noexcept;
+
     class ConstructorLock
     {
         friend class Encoder;
@@ -60,15 +208,19 @@ public:
      * @param format      Describes the format to use.
      * @param frameRate   The frame rate.
      * @param duration    The duration of the output encode.
-     * @param codecType   Type of the codec to encode with.
-     * @param quality     The encode quality.
-     * @param preset      The encode preset.
-     * @param numThreads  Number of threads to use.
-     * @param gopSize     Size of the gop.
+     * @param options     Options for controlling encoding.
      */
     FFFRAMEREADER_NO_EXPORT Encoder(const std::string& fileName, uint32_t width, uint32_t height, Rational aspect,
-        PixelFormat format, Rational frameRate, int64_t duration, EncodeType codecType, uint8_t quality,
-        EncoderOptions::Preset preset, uint32_t numThreads, uint32_t gopSize, ConstructorLock) noexcept;
+        PixelFormat format, Rational frameRate, int64_t duration, const EncoderOptions& options,
+        ConstructorLock) noexcept;
+
+    /**
+     * Constructor for an encoder that writes to an already opened output.
+     * @param formatContext The output context, its header must already have been written.
+     * @param codecContext  The opened encoder context (may be empty if only copied packets are written).
+     */
+    FFFRAMEREADER_NO_EXPORT Encoder(
+        OutputFormatContextPtr formatContext, CodecContextPtr codecContext, ConstructorLock) noexcept;
 
     /**
      * Query if this object is valid.
@@ -77,9 +229,122 @@ public:
     FFFRAMEREADER_EXPORT bool isEncoderValid() const noexcept;
 
 private:
+    struct PacketDeleter
+    {
+        void operator()(AVPacket* packet) const noexcept;
+    };
+    using PacketPtr = std::unique_ptr<AVPacket, PacketDeleter>;
+    using PacketQueue = Queue<PacketPtr>;
+
+    struct BitStreamFilterDeleter
+    {
+        void operator()(AVBSFContext* filter) const noexcept;
+    };
+    using BitStreamFilterPtr = std::unique_ptr<AVBSFContext, BitStreamFilterDeleter>;
+
     OutputFormatContextPtr m_formatContext;
     CodecContextPtr m_codecContext;
 
+    std::unique_ptr<Queue<std::shared_ptr<Frame>>> m_pushedFrames; /**< Frames pushed for asynchronous encoding */
+    std::thread m_pushThread;              /**< The thread encoding pushed frames */
+    std::atomic<bool> m_pushValid{true};   /**< False once encoding a pushed frame has failed */
+    std::mutex m_finishMutex;              /**< Serialises calls to @finish */
+    int64_t m_decodeDelay = 0; /**< Offset subtracted from output time stamps to create decode time stamps, 0 to use
+                                  the time stamps of the encoder */
+
+    static constexpr size_t s_frameQueueLength = 8;   /**< Maximum decoded frames waiting to be encoded */
+    static constexpr size_t s_packetQueueLength = 32; /**< Maximum encoded packets waiting to be muxed */
+    static constexpr size_t s_pushQueueLength = 32;   /**< Maximum pushed frames waiting to be encoded */
+    static constexpr int32_t s_ioBufferSize = 65536;  /**< Size of the buffer used for output writers */
+
+    /**
+     * Creates and opens an encoder context.
+     * @param width        The output width.
+     * @param height       The output height.
+     * @param aspect       The sample aspect ratio.
+     * @param format       Describes the format to use.
+     * @param frameRate    The frame rate.
+     * @param codecType    Type of the codec to encode with.
+     * @param quality      The encode quality.
+     * @param preset       The encode preset.
+     * @param numThreads   Number of threads to use.
+     * @param gopSize      Size of the gop.
+     * @param globalHeader True to store codec headers in the output container instead of in each key frame.
+     * @param reorder      False to disable frame reordering so that decode and presentation order match.
+     * @returns The codec context if succeeded, empty otherwise.
+     */
+    FFFRAMEREADER_NO_EXPORT static CodecContextPtr createCodec(uint32_t width, uint32_t height, Rational aspect,
+        PixelFormat format, Rational frameRate, EncodeType codecType, uint8_t quality, EncoderOptions::Preset preset,
+        uint32_t numThreads, uint32_t gopSize, bool globalHeader, bool reorder) noexcept;
+
+    /**
+     * Re-opens the source of a stream so that its packets can be read without affecting the streams position.
+     * @param stream The stream.
+     * @returns The format context if succeeded, empty otherwise.
+     */
+    FFFRAMEREADER_NO_EXPORT static FormatContextPtr openSource(const std::shared_ptr<Stream>& stream) noexcept;
+
+    /**
+     * Opens the output of a format context and writes the file header.
+     * @param formatContext The output format context with all streams already added.
+     * @param fileName      File name of the file to write to.
+     * @param options       Options for controlling the output.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT static bool openOutput(const OutputFormatContextPtr& formatContext,
+        const std::string& fileName, const EncoderOptions& options) noexcept;
+
+    /**
+     * Passes output data to an output writer.
+     * @param opaque     The output writer.
+     * @param buffer     The output data.
+     * @param bufferSize Size of the buffer in bytes.
+     * @returns The number of bytes written or negative value on error.
+     */
+    FFFRAMEREADER_NO_EXPORT static int writeOutput(void* opaque, uint8_t* buffer, int bufferSize) noexcept;
+
+    /**
+     * Opens an output file with a single stream using the codec parameters of an existing stream.
+     * @param fileName      File name of the file to write to.
+     * @param inStream      The stream to copy parameters from.
+     * @param inBandHeaders True if codec headers are only stored within the packets.
+     * @param options       (Optional) Options for controlling the output.
+     * @returns The format context if succeeded, empty otherwise.
+     */
+    FFFRAMEREADER_NO_EXPORT static OutputFormatContextPtr openCopyOutput(const std::string& fileName,
+        const AVStream* inStream, bool inBandHeaders, const EncoderOptions& options = EncoderOptions()) noexcept;
+
+    /**
+     * Copies all complete groups of pictures in a range without re-encoding.
+     * @param input          The source format context.
+     * @param stream         The source stream.
+     * @param startTimeStamp The time stamp of the first key frame to copy in the stream time base.
+     * @param endTimeStamp   The time stamp of the key frame to stop at in the stream time base.
+     * @param offset         The offset subtracted from all time stamps in the stream time base.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT bool copyPictureGroups(const FormatContextPtr& input, const std::shared_ptr<Stream>& stream,
+        int64_t startTimeStamp, int64_t endTimeStamp, int64_t offset) const noexcept;
+
+    /**
+     * Inserts the codec headers stored in a set of codec parameters at the start of a packet.
+     * @param [in,out] packet     The packet, this is replaced with a new packet containing the headers.
+     * @param          parameters The codec parameters containing the (Annex B) codec headers.
+     * @returns Zero if it succeeds, negative error code if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT static int prependHeaders(PacketPtr& packet, const AVCodecParameters* parameters) noexcept;
+
+    /**
+     * Decodes and encodes all frames in a time range.
+     * @param source    The stream to decode from.
+     * @param startTime The start time in microseconds (AV_TIME_BASE).
+     * @param endTime   The time in microseconds (AV_TIME_BASE) to stop at (exclusive).
+     * @param offset    The offset subtracted from all frame times in microseconds (AV_TIME_BASE).
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT bool encodeRange(
+        const std::shared_ptr<Stream>& source, int64_t startTime, int64_t endTime, int64_t offset) const noexcept;
+
     /**
      * Encodes all frames found in input stream from its current position.
      * @param stream The stream.
@@ -88,18 +353,76 @@ private:
     FFFRAMEREADER_NO_EXPORT bool encodeStream(const std::shared_ptr<Stream>& stream) const noexcept;
 
     /**
-     * Encode frame.
-     * @param frame The frame.
+     * Encodes a stream by splitting it into key frame aligned segments that are each decoded and encoded
+     * concurrently and then concatenated. As with a single pass encode the stream is left at its end once complete.
+     * @param fileName File name of the file to write to.
+     * @param stream   The stream to encode.
+     * @param options  Options for controlling encoding.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT static bool encodeStreamSegmented(
+        const std::string& fileName, const std::shared_ptr<Stream>& stream, const EncoderOptions& options) noexcept;
+
+    /**
+     * Concatenates the packets of multiple files into a single output file.
+     * @param fileName  File name of the file to write to.
+     * @param fileNames The files to concatenate, each must contain a single stream with matching codec parameters.
+     * @param options   Options for controlling the output.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT static bool concatenate(const std::string& fileName,
+        const std::vector<std::string>& fileNames, const EncoderOptions& options) noexcept;
+
+    /**
+     * Encodes all frames found in input stream from its current position. Decoding, encoding and muxing are each
+     * performed on separate threads connected by bounded queues.
      * @param stream The stream.
      * @returns True if it succeeds, false if it fails.
      */
-    FFFRAMEREADER_NO_EXPORT bool encodeFrame(
-        const std::shared_ptr<Frame>& frame, const std::shared_ptr<Stream>& stream) const noexcept;
+    FFFRAMEREADER_NO_EXPORT bool encodeStreamPipelined(const std::shared_ptr<Stream>& stream) const noexcept;
+
+    /**
+     * Encode frame.
+     * @param frame   The frame (nullptr to flush the encoder).
+     * @param stream  The stream.
+     * @param packets (Optional) Queue to pass encoded packets to instead of writing them directly. If not provided
+     *  then the file trailer is also written when flushing.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT bool encodeFrame(const std::shared_ptr<Frame>& frame,
+        const std::shared_ptr<Stream>& stream, PacketQueue* packets = nullptr) const noexcept;
+
+    /**
+     * Sends a frame to the encoder and writes any resulting packets.
+     * @param frame   The frame (nullptr to flush the encoder).
+     * @param packets (Optional) Queue to pass encoded packets to instead of writing them directly.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT bool sendFrame(AVFrame* frame, PacketQueue* packets) const noexcept;
+
+    /**
+     * Encodes pushed frames until @finish is called.
+     */
+    FFFRAMEREADER_NO_EXPORT void runPushed() noexcept;
+
+    /**
+     * Retrieves all available encoded frames and writes them to output.
+     * @param packets (Optional) Queue to pass encoded packets to instead of writing them directly.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT bool muxFrames(PacketQueue* packets = nullptr) const noexcept;
+
+    /**
+     * Writes an encoded packet to output.
+     * @param packet The packet.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT bool writePacket(AVPacket* packet) const noexcept;
 
     /**
-     * Writes encoded frames to output.
+     * Writes any remaining interleaved packets and the file trailer.
      * @returns True if it succeeds, false if it fails.
      */
-    FFFRAMEREADER_NO_EXPORT bool muxFrames() const noexcept;
+    FFFRAMEREADER_NO_EXPORT bool writeTrailer() const noexcept;
 };
 } // namespace Ffr
@@ -16,6 +16,7 @@
 #pragma once
 #include "FFFrameReader.h"
 
+#include <atomic>
 #include <memory>
 
 struct AVFilterGraph;
@@ -52,12 +53,20 @@ public:
      * @param scale         The output resolution or (0, 0) if no scaling should be performed. Scaling is performed
      *  after cropping.
      * @param crop          The output cropping or (0) if no crop should be performed.
+     * @param pad           The padded output resolution or (0, 0) if no padding should be performed. Padding is
+     *  performed after scaling.
+     * @param padOffset     The position of the scaled image within the padded output.
+     * @param padColour     The RGB colour (0xRRGGBB) used to fill padded areas.
+     * @param algorithm     The interpolation used for scaling.
+     * @param filterThreads Number of slice threads used by the filter graph (0 for auto).
      * @param format        The required output pixel format.
+     * @param lumaOnly      True if input frames have been reduced to only their luma plane.
      * @param formatContext Context for the format.
      * @param streamIndex   Zero-based index of the stream.
      * @param codecContext  Context for the codec.
      */
-    FFFRAMEREADER_NO_EXPORT Filter(Resolution scale, Crop crop, PixelFormat format,
+    FFFRAMEREADER_NO_EXPORT Filter(Resolution scale, Crop crop, Resolution pad, Resolution padOffset,
+        uint32_t padColour, ScaleAlgorithm algorithm, uint32_t filterThreads, PixelFormat format, bool lumaOnly,
         const FormatContextPtr& formatContext, uint32_t streamIndex, const CodecContextPtr& codecContext) noexcept;
 
     FFFRAMEREADER_NO_EXPORT ~Filter() = default;
@@ -75,14 +84,14 @@ public:
      * @param [in,out] frame The input frame.
      * @returns True if it succeeds, false if it fails.
      */
-    FFFRAMEREADER_NO_EXPORT bool sendFrame(FramePtr& frame) const noexcept;
+    FFFRAMEREADER_NO_EXPORT bool sendFrame(FramePtr& frame) noexcept;
 
     /**
      * Receive frame from filter graph
      * @param [in,out] frame The frame.
      * @returns True if it succeeds, false if it fails.
      */
-    FFFRAMEREADER_NO_EXPORT bool receiveFrame(FramePtr& frame) const noexcept;
+    FFFRAMEREADER_NO_EXPORT bool receiveFrame(FramePtr& frame) noexcept;
 
     /**
      * Gets the width of output frames.
@@ -122,9 +131,36 @@ public:
      */
     FFFRAMEREADER_NO_EXPORT uint32_t getFrameSize() const noexcept;
 
+    /**
+     * Gets the threading and timing statistics of the filter graph.
+     * @returns The statistics.
+     */
+    FFFRAMEREADER_NO_EXPORT FilterStatistics getStatistics() const noexcept;
+
 private:
-    FilterGraphPtr m_filterGraph;        /**< The filter graph. */
-    AVFilterContext* m_source = nullptr; /**< The input for the filter graph. */
-    AVFilterContext* m_sink = nullptr;   /**< The output of the filter graph.*/
+    FilterGraphPtr m_filterGraph;          /**< The filter graph. */
+    AVFilterContext* m_source = nullptr;   /**< The input for the filter graph. */
+    AVFilterContext* m_sink = nullptr;     /**< The output of the filter graph.*/
+    uint32_t m_threads = 1;                /**< The number of slice threads used by the filter graph. */
+    std::atomic<uint64_t> m_frames{0};     /**< The number of frames output from the filter graph. */
+    std::atomic<int64_t> m_sendTime{0};    /**< Total time spent in @sendFrame in nanoseconds. */
+    std::atomic<int64_t> m_receiveTime{0}; /**< Total time spent in @receiveFrame in nanoseconds. */
+
+    /**
+     * Gets the swscale flags string for a scaling algorithm.
+     * @param algorithm The scaling algorithm.
+     * @returns The flags string.
+     */
+    FFFRAMEREADER_NO_EXPORT static const char* getScaleFlags(ScaleAlgorithm algorithm) noexcept;
+
+    /**
+     * Gets the number of slice threads to use for a filter graph.
+     * @param threads The requested number of threads (0 for auto).
+     * @param width   The output width.
+     * @param height  The output height.
+     * @returns The number of threads.
+     */
+    FFFRAMEREADER_NO_EXPORT static uint32_t getFilterThreads(
+        uint32_t threads, uint32_t width, uint32_t height) noexcept;
 };
 } // namespace Ffr
\ No newline at end of file
@@ -119,5 +119,7 @@ private:
     FormatContextPtr m_formatContext = FormatContextPtr();
     int32_t m_index = -1; /**< Zero-based index of the video stream  */
     CodecContextPtr m_codecContext = CodecContextPtr();
+    MemoryReservation m_memory; /**< The memory accounted to this frame */
+    bool m_pending = false;     /**< True if the frame is still in its decoded format and requires processing */
 };
 } // namespace Ffr
\ No newline at end of file
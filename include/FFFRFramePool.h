@@ -0,0 +1,144 @@
+/**
+ * Copyright 2019 Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "FFFrameReader.h"
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include <libavutil/buffer.h>
+#include <libavutil/pixfmt.h>
+}
+
+struct AVCodecContext;
+
+namespace Ffr {
+class HostAllocator final : public FrameAllocator
+{
+public:
+    /**
+     * Allocates memory using the ffmpeg allocator.
+     * @param size The required size in bytes.
+     * @returns Pointer to the allocated memory, nullptr if failed.
+     */
+    FFFRAMEREADER_NO_EXPORT uint8_t* allocate(size_t size) noexcept override;
+
+    /**
+     * Frees memory previously returned by @allocate.
+     * @param data Pointer to the memory.
+     * @param size The size in bytes that was passed to @allocate.
+     */
+    FFFRAMEREADER_NO_EXPORT void deallocate(uint8_t* data, size_t size) noexcept override;
+
+    /**
+     * Gets the alignment guaranteed by the ffmpeg allocator.
+     * @returns The alignment.
+     */
+    FFFRAMEREADER_NO_EXPORT uint32_t getAlignment() const noexcept override;
+};
+
+class FramePool
+{
+public:
+    FFFRAMEREADER_NO_EXPORT FramePool() = delete;
+
+    /**
+     * Constructor.
+     * @param allocator The allocator used to allocate all frame memory.
+     */
+    FFFRAMEREADER_NO_EXPORT explicit FramePool(std::shared_ptr<FrameAllocator> allocator) noexcept;
+
+    FFFRAMEREADER_NO_EXPORT ~FramePool() noexcept;
+
+    FFFRAMEREADER_NO_EXPORT FramePool(const FramePool& other) = delete;
+
+    FFFRAMEREADER_NO_EXPORT FramePool(FramePool&& other) noexcept = delete;
+
+    FFFRAMEREADER_NO_EXPORT FramePool& operator=(const FramePool& other) = delete;
+
+    FFFRAMEREADER_NO_EXPORT FramePool& operator=(FramePool&& other) noexcept = delete;
+
+    /**
+     * Allocates the buffers for a frame using the frames current format, width and height.
+     * @param [in,out] frame The frame to allocate buffers for.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT bool getBuffer(AVFrame* frame) noexcept;
+
+    /**
+     * Replaces the buffers of a frame with a copy allocated from the pool.
+     * @param [in,out] frame The frame.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT bool copyFrame(FramePtr& frame) noexcept;
+
+    /**
+     * Decoder get_buffer2 callback. This requires the codec contexts opaque value to point to a FramePool.
+     * @param context The codec context.
+     * @param frame   The frame to allocate buffers for.
+     * @param flags   The allocation flags.
+     * @returns Zero if it succeeds, negative error code if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT static int getBuffer2(AVCodecContext* context, AVFrame* frame, int flags) noexcept;
+
+private:
+    struct PoolSet
+    {
+        std::array<AVBufferPool*, 4> m_pools = {nullptr, nullptr, nullptr, nullptr};
+        std::array<int32_t, 4> m_lineSizes = {0, 0, 0, 0};
+        std::array<int32_t, 4> m_lineAlign = {0, 0, 0, 0}; /**< The line alignment the pools were created for */
+        AVPixelFormat m_format = AV_PIX_FMT_NONE;
+        int32_t m_width = 0;
+        int32_t m_height = 0;
+    };
+
+    static constexpr size_t s_maxPoolSets = 4; /**< Maximum number of frame layouts with pools kept at once */
+
+    std::mutex m_mutex;
+    std::shared_ptr<FrameAllocator> m_allocator = nullptr;
+    std::vector<PoolSet> m_poolSets; /**< Pools for each frame layout in most recently used order */
+
+    /**
+     * Gets the buffer pools matching the required frame properties, creating them if needed. Decoder and output
+     * frames commonly use different layouts so pools for multiple layouts are kept at once.
+     * @param format      The pixel format.
+     * @param width       The width.
+     * @param height      The height.
+     * @param lineAlign   The line size alignment required for each plane.
+     * @returns The pools, nullptr if failed.
+     */
+    FFFRAMEREADER_NO_EXPORT const PoolSet* getPools(
+        AVPixelFormat format, int32_t width, int32_t height, const std::array<int32_t, 4>& lineAlign) noexcept;
+
+    /**
+     * Allocates the buffers for a frame from a set of pools.
+     * @param          pools The pools to allocate from.
+     * @param [in,out] frame The frame to allocate buffers for.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT static bool allocateBuffers(const PoolSet& pools, AVFrame* frame) noexcept;
+
+    /**
+     * Buffer pool allocation callback.
+     * @param opaque Pointer to the owning FramePool.
+     * @param size   The size of the buffer in bytes.
+     * @returns The new buffer, nullptr if failed.
+     */
+    FFFRAMEREADER_NO_EXPORT static AVBufferRef* allocateBuffer(void* opaque, int size) noexcept;
+};
+} // namespace Ffr
@@ -0,0 +1,75 @@
+/**
+ * Copyright 2019 Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "FFFrameReader.h"
+
+#include <atomic>
+
+struct AVFrame;
+
+namespace Ffr {
+class MemoryTracker
+{
+public:
+    FFFRAMEREADER_NO_EXPORT MemoryTracker() noexcept = default;
+
+    FFFRAMEREADER_NO_EXPORT ~MemoryTracker() noexcept = default;
+
+    FFFRAMEREADER_NO_EXPORT MemoryTracker(const MemoryTracker& other) = delete;
+
+    FFFRAMEREADER_NO_EXPORT MemoryTracker(MemoryTracker&& other) noexcept = delete;
+
+    FFFRAMEREADER_NO_EXPORT MemoryTracker& operator=(const MemoryTracker& other) = delete;
+
+    FFFRAMEREADER_NO_EXPORT MemoryTracker& operator=(MemoryTracker&& other) noexcept = delete;
+
+    /**
+     * Adds memory to this tracker and the global memory usage.
+     * @param size The size in bytes.
+     */
+    FFFRAMEREADER_NO_EXPORT void allocate(uint64_t size) noexcept;
+
+    /**
+     * Removes memory from this tracker and the global memory usage.
+     * @param size The size in bytes.
+     */
+    FFFRAMEREADER_NO_EXPORT void release(uint64_t size) noexcept;
+
+    /**
+     * Gets the memory currently tracked by this tracker.
+     * @returns The memory usage in bytes.
+     */
+    FFFRAMEREADER_NO_EXPORT uint64_t getUsage() const noexcept;
+
+    /**
+     * Query if there is memory available in the global budget. If the budget is exceeded then this will wait up to
+     * the configured budget wait time for memory to be released.
+     * @returns True if memory is available, false if the budget is exceeded.
+     */
+    FFFRAMEREADER_NO_EXPORT static bool waitForBudget() noexcept;
+
+    /**
+     * Gets the amount of host memory used by the buffers of a frame.
+     * @note Hardware frames do not use host memory and so return 0.
+     * @param frame The frame.
+     * @returns The memory size in bytes.
+     */
+    FFFRAMEREADER_NO_EXPORT static uint64_t getFrameMemory(const AVFrame* frame) noexcept;
+
+private:
+    std::atomic<uint64_t> m_usage{0}; /**< The memory tracked by this object in bytes */
+};
+} // namespace Ffr
@@ -0,0 +1,117 @@
+/**
+ * Copyright 2019 Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "FFFrameReader.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace Ffr {
+template<typename T>
+class Queue
+{
+public:
+    FFFRAMEREADER_NO_EXPORT Queue() = delete;
+
+    /**
+     * Constructor.
+     * @param maxSize The maximum number of items that can be queued before @push blocks.
+     */
+    FFFRAMEREADER_NO_EXPORT explicit Queue(size_t maxSize) noexcept
+        : m_maxSize(std::max<size_t>(maxSize, 1))
+    {}
+
+    FFFRAMEREADER_NO_EXPORT ~Queue() noexcept = default;
+
+    FFFRAMEREADER_NO_EXPORT Queue(const Queue& other) = delete;
+
+    FFFRAMEREADER_NO_EXPORT Queue(Queue&& other) noexcept = delete;
+
+    FFFRAMEREADER_NO_EXPORT Queue& operator=(const Queue& other) = delete;
+
+    FFFRAMEREADER_NO_EXPORT Queue& operator=(Queue&& other) noexcept = delete;
+
+    /**
+     * Adds an item to the back of the queue, blocking while the queue is full.
+     * @param item The item to add.
+     * @returns True if it succeeds, false if the queue has been closed.
+     */
+    FFFRAMEREADER_NO_EXPORT bool push(T item) noexcept
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_closed || m_items.size() < m_maxSize; });
+            if (m_closed) {
+                return false;
+            }
+            try {
+                m_items.emplace_back(std::move(item));
+            } catch (...) {
+                return false;
+            }
+        }
+        m_condition.notify_all();
+        return true;
+    }
+
+    /**
+     * Removes an item from the front of the queue, blocking while the queue is empty.
+     * @param [out] item The removed item.
+     * @returns True if it succeeds, false if the queue has been closed and all items have been removed.
+     */
+    FFFRAMEREADER_NO_EXPORT bool pop(T& item) noexcept
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_closed || !m_items.empty(); });
+            if (m_items.empty()) {
+                return false;
+            }
+            item = std::move(m_items.front());
+            m_items.pop_front();
+        }
+        m_condition.notify_all();
+        return true;
+    }
+
+    /**
+     * Closes the queue. Any further pushes fail and pops only return the remaining items.
+     * @param discard True to also discard any remaining items.
+     */
+    FFFRAMEREADER_NO_EXPORT void close(const bool discard = false) noexcept
+    {
+        std::deque<T> discarded;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+            if (discard) {
+                // Items are released outside the lock
+                std::swap(discarded, m_items);
+            }
+        }
+        m_condition.notify_all();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition; /**< Signalled whenever an item is added/removed or the queue is closed */
+    std::deque<T> m_items;               /**< The queued items */
+    size_t m_maxSize = 1;                /**< The maximum number of queued items */
+    bool m_closed = false;               /**< True once the queue has been closed */
+};
+} // namespace Ffr
@@ -0,0 +1,102 @@
+/**
+ * Copyright 2019 Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "FFFRFramePool.h"
+
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+#include <libavutil/rational.h>
+}
+
+struct SwsContext;
+
+namespace Ffr {
+class Scaler
+{
+public:
+    FFFRAMEREADER_NO_EXPORT Scaler() = delete;
+
+    /**
+     * Constructor
+     * @param inWidth   The width of input frames.
+     * @param inHeight  The height of input frames.
+     * @param inFormat  The pixel format of input frames.
+     * @param scale     The output resolution or (0, 0) if no scaling should be performed.
+     * @param format    The required output pixel format or Auto to keep the input format.
+     * @param algorithm The interpolation used for scaling.
+     * @param allocator Optional allocator used for output frame memory.
+     */
+    FFFRAMEREADER_NO_EXPORT Scaler(uint32_t inWidth, uint32_t inHeight, AVPixelFormat inFormat,
+        Resolution scale, PixelFormat format, ScaleAlgorithm algorithm,
+        const std::shared_ptr<FrameAllocator>& allocator) noexcept;
+
+    FFFRAMEREADER_NO_EXPORT ~Scaler() noexcept;
+
+    FFFRAMEREADER_NO_EXPORT Scaler(const Scaler& other) = delete;
+
+    FFFRAMEREADER_NO_EXPORT Scaler(Scaler&& other) noexcept = delete;
+
+    FFFRAMEREADER_NO_EXPORT Scaler& operator=(const Scaler& other) = delete;
+
+    FFFRAMEREADER_NO_EXPORT Scaler& operator=(Scaler&& other) noexcept = delete;
+
+    /**
+     * Scales and converts a frame. This may be called from multiple threads at once.
+     * @param [in,out] frame The frame, on success this is replaced with the converted frame.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT bool scaleFrame(FramePtr& frame) noexcept;
+
+    /**
+     * Gets the width of output frames.
+     * @returns The width.
+     */
+    FFFRAMEREADER_NO_EXPORT uint32_t getWidth() const noexcept;
+
+    /**
+     * Gets the height of output frames.
+     * @returns The height.
+     */
+    FFFRAMEREADER_NO_EXPORT uint32_t getHeight() const noexcept;
+
+    /**
+     * Gets pixel format of output frames.
+     * @returns The pixel format (AV_PIX_FMT_NONE if the scaler failed to initialise).
+     */
+    FFFRAMEREADER_NO_EXPORT AVPixelFormat getPixelFormat() const noexcept;
+
+    /**
+     * Gets the sample aspect ratio of output frames.
+     * @param sampleAspectRatio The sample aspect ratio of input frames.
+     * @returns The sample aspect ratio.
+     */
+    FFFRAMEREADER_NO_EXPORT AVRational getSampleAspectRatio(AVRational sampleAspectRatio) const noexcept;
+
+private:
+    std::mutex m_mutex;
+    std::vector<SwsContext*> m_contexts;               /**< Cached contexts not currently in use */
+    std::shared_ptr<FramePool> m_framePool = nullptr;  /**< The pool used to allocate output frames */
+    uint32_t m_inWidth = 0;                            /**< The width of input frames */
+    uint32_t m_inHeight = 0;                           /**< The height of input frames */
+    uint32_t m_width = 0;                              /**< The width of output frames */
+    uint32_t m_height = 0;                             /**< The height of output frames */
+    AVPixelFormat m_format = AV_PIX_FMT_NONE;          /**< The pixel format of output frames */
+    int32_t m_flags = 0;                               /**< The swscale flags */
+};
+} // namespace Ffr
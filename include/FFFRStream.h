@@ -17,6 +17,7 @@
 #include "FFFRTypes.h"
 
 #include <cstdint>
+#include <functional>
 #include <mutex>
 #include <vector>
 
@@ -24,6 +25,8 @@ namespace Ffr {
 class DecoderContext;
 class Filter;
 class Frame;
+class FramePool;
+class Scaler;
 
 class Stream
 {
@@ -61,20 +64,30 @@ public:
 
     /**
      * Constructor.
-     * @param fileName       Filename of the file to open.
-     * @param bufferLength   Number of frames in the the decode buffer.
-     * @param seekThreshold  Maximum number of frames for a forward seek to continue to decode instead of seeking.
-     * @param noBufferFlush  True to skip buffer flushing on seeks.
-     * @param decoderContext Pointer to an existing context to be used for hardware decoding.
-     * @param outputHost     True to output each frame to host CPU memory (only affects hardware decoding).
-     * @param crop           The output cropping or (0) if no crop should be performed.
-     * @param scale          The output resolution or (0, 0) if no scaling should be performed. Scaling is performed
+     * @param fileName        Filename of the file to open.
+     * @param bufferLength    Number of frames in the the decode buffer.
+     * @param adaptiveBuffer  True to adapt the buffer length to the consumption pattern.
+     * @param minBufferLength The minimum buffer length when using an adaptive buffer.
+     * @param maxBufferLength The maximum buffer length when using an adaptive buffer.
+     * @param seekThreshold   Maximum number of frames for a forward seek to continue to decode instead of seeking.
+     * @param noBufferFlush   True to skip buffer flushing on seeks.
+     * @param decoderContext  Pointer to an existing context to be used for hardware decoding.
+     * @param outputHost      True to output each frame to host CPU memory (only affects hardware decoding).
+     * @param crop            The output cropping or (0) if no crop should be performed.
+     * @param scale           The output resolution or (0, 0) if no scaling should be performed. Scaling is performed
      *  after cropping.
-     * @param format         The required output pixel format.
+     * @param scaleMode       How the output resolution is achieved when scaling.
+     * @param padColour       The RGB colour (0xRRGGBB) used to fill padded areas.
+     * @param scaleAlgorithm  The interpolation used for software scaling.
+     * @param filterThreads   Number of slice threads used for filtering (0 for auto).
+     * @param format          The required output pixel format.
+     * @param allocator       Optional allocator used for the memory of all host frames.
      */
-    FFFRAMEREADER_NO_EXPORT Stream(const std::string& fileName, uint32_t bufferLength, uint32_t seekThreshold,
-        bool noBufferFlush, const std::shared_ptr<DecoderContext>& decoderContext, bool outputHost, Crop crop,
-        Resolution scale, PixelFormat format, ConstructorLock) noexcept;
+    FFFRAMEREADER_NO_EXPORT Stream(const std::string& fileName, uint32_t bufferLength, bool adaptiveBuffer,
+        uint32_t minBufferLength, uint32_t maxBufferLength, uint32_t seekThreshold, bool noBufferFlush,
+        const std::shared_ptr<DecoderContext>& decoderContext, bool outputHost, Crop crop, Resolution scale,
+        ScaleMode scaleMode, uint32_t padColour, ScaleAlgorithm scaleAlgorithm, uint32_t filterThreads,
+        PixelFormat format, const std::shared_ptr<FrameAllocator>& allocator, ConstructorLock) noexcept;
 
     /**
      * Gets the width of the video stream.
@@ -126,12 +139,39 @@ public:
      */
     FFFRAMEREADER_EXPORT uint32_t getFrameSize() const noexcept;
 
+    /**
+     * Gets the transform that maps coordinates in the decoded source frame to coordinates in the output frames. This
+     * includes the effects of any cropping, scaling and letterbox padding.
+     * @returns The output transform.
+     */
+    FFFRAMEREADER_EXPORT OutputTransform getOutputTransform() const noexcept;
+
+    /**
+     * Gets the threading and timing statistics of the streams filter graph.
+     * @returns The statistics (all zero if the stream does not require a filter graph).
+     */
+    FFFRAMEREADER_EXPORT FilterStatistics getFilterStatistics() const noexcept;
+
     /**
      * Gets the type of decoding used.
      * @returns The decode type.
      */
     FFFRAMEREADER_EXPORT DecodeType getDecodeType() const noexcept;
 
+    /**
+     * Query if every frame in the stream can be decoded independently (e.g. MJPEG, ProRes, FFV1 or image sequences).
+     * Intra-only streams seek directly to each requested frame and may decode frame sequences concurrently.
+     * @returns True if intra-only, false if not.
+     */
+    FFFRAMEREADER_EXPORT bool isIntraOnly() const noexcept;
+
+    /**
+     * Gets the host memory currently used by decoded frames from this stream. This includes frames held by the user
+     * and frames held by any additional decoder instances used for concurrent retrieval.
+     * @returns The memory usage in bytes.
+     */
+    FFFRAMEREADER_EXPORT uint64_t getMemoryUsage() const noexcept;
+
     /**
      * Get the next frame in the stream without removing it from stream buffer.
      * @returns The next frame in current stream, or nullptr if an error occured or end of file reached.
@@ -146,7 +186,8 @@ public:
 
     /**
      * Gets maximum frames that can exist at a time.
-     * @remark This is effected by the setting of @DecoderOptions::m_bufferLength.
+     * @remark This is effected by the setting of @DecoderOptions::m_bufferLength. When using an adaptive buffer this
+     *  may change as frames are decoded.
      * @returns The maximum frames.
      */
     FFFRAMEREADER_EXPORT uint32_t getMaxFrames() noexcept;
@@ -199,6 +240,48 @@ public:
     FFFRAMEREADER_EXPORT std::vector<std::shared_ptr<Frame>> getFramesByIndex(
         const std::vector<int64_t>& frameSequence) noexcept;
 
+    /**
+     * Gets a sequence of frames based on there time stamps and writes them into a single contiguous tensor. Each frame
+     * is converted on a thread pool as soon as it has been decoded.
+     * @note Frames in device memory are converted using cuda, this only supports NV12 frames with RGB channels and the
+     *  Float16 tensor type and requires the tensor to be in device memory.
+     * @param       frameSequence The frame sequence. This is a list of absolute times used to specify which frames to
+     *  retrieve (see @getFrames).
+     * @param [out] outMem        Memory location to store the tensor (must be allocated with enough size for the
+     *  entire sequence see @getTensorSize).
+     * @param       format        The pixel format used to determine the tensor channels (RGB8, RGB8P and RGB32FP give
+     *  RGB channels, YUV444P gives YUV channels).
+     * @param       layout        (Optional) The tensor memory layout.
+     * @param       type          (Optional) The tensor data type.
+     * @param       options       (Optional) Per-channel normalisation and channel order applied during conversion.
+     * @returns The number of frames written to the tensor, if an error occurred then only the frames retrieved before
+     *  the error are written.
+     */
+    FFFRAMEREADER_EXPORT uint32_t getFramesTensor(const std::vector<int64_t>& frameSequence, uint8_t* outMem,
+        PixelFormat format, TensorLayout layout = TensorLayout::NCHW, TensorType type = TensorType::Float32,
+        const ConvertOptions& options = ConvertOptions()) noexcept;
+
+    /**
+     * Gets a sequence of frames using frame indices and writes them into a single contiguous tensor. Each frame is
+     * converted on a thread pool as soon as it has been decoded.
+     * @note Frames in device memory are converted using cuda, this only supports NV12 frames with RGB channels and the
+     *  Float16 tensor type and requires the tensor to be in device memory.
+     * @param       frameSequence The frame sequence. This is a list of absolute indices used to specify which frames to
+     *  retrieve (see @getFramesByIndex).
+     * @param [out] outMem        Memory location to store the tensor (must be allocated with enough size for the
+     *  entire sequence see @getTensorSize).
+     * @param       format        The pixel format used to determine the tensor channels (RGB8, RGB8P and RGB32FP give
+     *  RGB channels, YUV444P gives YUV channels).
+     * @param       layout        (Optional) The tensor memory layout.
+     * @param       type          (Optional) The tensor data type.
+     * @param       options       (Optional) Per-channel normalisation and channel order applied during conversion.
+     * @returns The number of frames written to the tensor, if an error occurred then only the frames retrieved before
+     *  the error are written.
+     */
+    FFFRAMEREADER_EXPORT uint32_t getFramesByIndexTensor(const std::vector<int64_t>& frameSequence, uint8_t* outMem,
+        PixelFormat format, TensorLayout layout = TensorLayout::NCHW, TensorType type = TensorType::Float32,
+        const ConvertOptions& options = ConvertOptions()) noexcept;
+
     /**
      * Query if the stream has reached end of input file.
      * @returns True if end of file, false if not.
@@ -236,10 +319,61 @@ public:
      */
     FFFRAMEREADER_EXPORT int64_t timeToFrame(int64_t time) const noexcept;
 
+    /**
+     * Scans all packets of the video stream without performing any decoding.
+     * @note This uses a separate demuxer so the current stream position is unaffected. Packets are returned in
+     *  decode order and time stamps use the same start time correction as decoded frames.
+     * @returns A list of packet information, if an error occurred then only the packets retrieved before the error
+     *  are returned.
+     */
+    FFFRAMEREADER_EXPORT std::vector<PacketInfo> scanPackets() const noexcept;
+
+    /**
+     * Scans all packets of the primary video stream in a file without opening a decoder.
+     * @note Packets are returned in decode order. Time stamps are relative to the start time reported by the container.
+     * @param fileName Filename of the file to open.
+     * @returns A list of packet information, if an error occurred then only the packets retrieved before the error
+     *  are returned.
+     */
+    FFFRAMEREADER_EXPORT static std::vector<PacketInfo> scanPackets(const std::string& fileName) noexcept;
+
+    /**
+     * Gets the properties of the primary video stream in a file without opening a decoder or decoding any frames.
+     * @note The returned values match those reported by a @Stream created with default options. Files that do not
+     *  store their duration or frame count require all packets to be read (but not decoded) to determine them.
+     * @param fileName        Filename of the file to open.
+     * @param probeSize       (Optional) Maximum number of bytes read when detecting stream properties (0 for the
+     *  FFmpeg default).
+     * @param analyzeDuration (Optional) Maximum duration in microseconds read when detecting stream properties (0 for
+     *  the FFmpeg default).
+     * @returns The stream information, @StreamInfo::m_valid is false if an error occurred.
+     */
+    FFFRAMEREADER_EXPORT static StreamInfo probe(
+        const std::string& fileName, int64_t probeSize = 0, int64_t analyzeDuration = 0) noexcept;
+
+    /**
+     * Gets the properties of the primary video stream in multiple files. Files are probed concurrently without opening
+     * a decoder (see @probe).
+     * @param fileNames       Filenames of the files to open.
+     * @param probeSize       (Optional) Maximum number of bytes read when detecting stream properties (0 for the
+     *  FFmpeg default).
+     * @param analyzeDuration (Optional) Maximum duration in microseconds read when detecting stream properties (0 for
+     *  the FFmpeg default).
+     * @returns The stream information for each file in the same order as the input list.
+     */
+    FFFRAMEREADER_EXPORT static std::vector<StreamInfo> probe(
+        const std::vector<std::string>& fileNames, int64_t probeSize = 0, int64_t analyzeDuration = 0) noexcept;
+
 private:
-    std::recursive_mutex m_mutex;
+    static constexpr uint32_t s_maxDecodeInstances = 4; /**< Maximum automatic number of concurrent decoders */
+
+    mutable std::recursive_mutex m_mutex;
 
     uint32_t m_bufferLength = 0;                      /**< Length of the ping and pong buffers */
+    uint32_t m_savedBufferLength = 0; /**< The buffer length to restore after a temporary override (0 if none) */
+    bool m_adaptiveBuffer = false;    /**< True to adapt the buffer length to the consumption pattern */
+    uint32_t m_minBufferLength = 1;   /**< The minimum adaptive buffer length */
+    uint32_t m_maxBufferLength = 1;   /**< The maximum adaptive buffer length */
     std::vector<std::shared_ptr<Frame>> m_bufferPing; /**< The primary buffer used to store decoded frames */
     uint32_t m_bufferPingHead =
         0; /**< The position in the ping buffer of the next available frame in the decoded stream */
@@ -265,6 +399,16 @@ private:
     int64_t m_seekThreshold = 0;  /**< Time stamp difference for determining if a forward seek should forward decode */
     bool m_noBufferFlush = false; /**< True to skip buffer flushing on seeks */
     bool m_frameSeekSupported = true; /**< True if frame seek supported */
+    std::shared_ptr<MemoryTracker> m_memoryTracker = nullptr; /**< The memory used by frames from this stream */
+    bool m_memoryLimited = false; /**< True if the current block was limited by the global memory budget */
+    std::shared_ptr<FramePool> m_framePool = nullptr; /**< Optional pool used to allocate host frame memory */
+    OutputTransform m_outputTransform;                /**< Mapping from source to output frame coordinates */
+    bool m_lumaOnly = false; /**< True if only the luma plane of decoded frames is output */
+    Crop m_crop = {0, 0, 0, 0}; /**< Cropping applied directly to decoded frames when no filter is required */
+    std::shared_ptr<Scaler> m_scaler = nullptr; /**< Direct scaler used instead of a filter graph when possible */
+    DecoderOptions m_options; /**< The options used to create the stream */
+    bool m_intraOnly = false; /**< True if every frame in the stream can be decoded independently */
+    std::vector<std::shared_ptr<Stream>> m_decoders; /**< Additional decoder instances used for concurrent retrieval */
 
     /**
      * Initialises codec parameters needed for future operations.
@@ -402,11 +546,87 @@ private:
     FFFRAMEREADER_NO_EXPORT bool decodeNextFrames(int64_t& flushTillTime) noexcept;
 
     /**
-     * Process all buffered with any required additional filtering/conversion.
+     * Grows or shrinks the buffer length when using an adaptive buffer. If the buffer length is temporarily overridden
+     * then the saved length is adapted instead.
+     * @param grow True to grow the buffer, false to shrink it.
+     */
+    FFFRAMEREADER_NO_EXPORT void adaptBufferLength(bool grow) noexcept;
+
+    /**
+     * Query if the pong buffer is full. This occurs once the buffer length is reached or the global memory budget has
+     * been exceeded and at least one frame is available.
+     * @returns True if the buffer is full, false if more frames should be decoded.
+     */
+    FFFRAMEREADER_NO_EXPORT bool isBufferFull() noexcept;
+
+    /**
+     * Detects if every frame in a stream can be decoded independently.
+     * @param format The format context containing the stream.
+     * @param index  Zero-based index of the video stream.
+     * @returns True if intra-only, false if not.
+     */
+    FFFRAMEREADER_NO_EXPORT static bool DetectIntraOnly(const FormatContextPtr& format, int32_t index) noexcept;
+
+    /**
+     * Gets a sequence of frames from an intra-only stream by splitting it across multiple decoder instances.
+     * @param frameSequence The frame sequence of absolute frame indices.
+     * @param instances     The number of decoder instances to use.
+     * @returns A list of frames corresponding to the input sequence, if an error occurred then only the frames
+     * retrieved before the error are returned.
+     */
+    FFFRAMEREADER_NO_EXPORT std::vector<std::shared_ptr<Frame>> getFramesByIndexConcurrent(
+        const std::vector<int64_t>& frameSequence, uint32_t instances) noexcept;
+
+    /**
+     * Gets a sequence of frames and passes each one to a callback as soon as it is available.
+     * @param frameSequence The frame sequence of either absolute times or frame indices.
+     * @param byIndex       True if the sequence contains frame indices, false if it contains times.
+     * @param maxFrames     The maximum number of frames to retrieve.
+     * @param callback      The callback used to consume each frame, returning false stops retrieval.
+     * @returns The number of frames passed to the callback.
+     */
+    FFFRAMEREADER_NO_EXPORT uint32_t getFramesInternal(const std::vector<int64_t>& frameSequence, bool byIndex,
+        uint32_t maxFrames, const std::function<bool(std::shared_ptr<Frame>&)>& callback) noexcept;
+
+    /**
+     * Gets a sequence of frames and writes them into a single contiguous tensor.
+     * @param       frameSequence The frame sequence of either absolute times or frame indices.
+     * @param       byIndex       True if the sequence contains frame indices, false if it contains times.
+     * @param [out] outMem        Host memory location to store the tensor.
+     * @param       format        The pixel format used to determine the tensor channels.
+     * @param       layout        The tensor memory layout.
+     * @param       type          The tensor data type.
+     * @param       options       The conversion options.
+     * @returns The number of frames written to the tensor.
+     */
+    FFFRAMEREADER_NO_EXPORT uint32_t getFramesTensorInternal(const std::vector<int64_t>& frameSequence, bool byIndex,
+        uint8_t* outMem, PixelFormat format, TensorLayout layout, TensorType type,
+        const ConvertOptions& options) noexcept;
+
+    /**
+     * Adds a new frame to the pong buffer.
+     * @param [in] frame     The frame pointer to frame data. This is reset to nullptr on function exit.
+     * @param      timeStamp The time stamp for the frame.
+     * @param      frameNum  The zero-indexed frame number in the stream.
+     * @param      position  The position in the pong buffer to insert the frame.
+     */
+    FFFRAMEREADER_NO_EXPORT void addFrame(FramePtr& frame, int64_t timeStamp, int64_t frameNum,
+        std::vector<std::shared_ptr<Frame>>::iterator position) noexcept;
+
+    /**
+     * Removes duplicates and fills in missing frames in the newly decoded buffer. Any additional
+     * filtering/conversion is deferred until each frame is retrieved.
      * @returns True if it succeeds, false if it fails.
      */
     FFFRAMEREADER_NO_EXPORT bool processFrames() noexcept;
 
+    /**
+     * Performs any deferred processing of all buffered frames in parallel.
+     * @note Only valid when using the direct scaler as each frame must be processed independently.
+     * @returns True if it succeeds, false if it fails.
+     */
+    FFFRAMEREADER_NO_EXPORT bool processFramesParallel() noexcept;
+
     /**
      * Process a frame with any required additional filtering/conversion.
      * @param [in,out] frame The frame.
@@ -442,20 +662,39 @@ private:
 
     /**
      * Gets stream start time in the stream timebase.
+     * @note This may read packets from the format context, it is returned to the start of the file afterwards.
+     * @param format     The format context.
+     * @param index      The index of the stream.
+     * @param maxPackets The maximum number of packets to check (see @GetCodecDelay).
      * @returns The stream start time.
      */
-    FFFRAMEREADER_NO_EXPORT int64_t getStreamStartTime() const noexcept;
+    FFFRAMEREADER_NO_EXPORT static int64_t GetStreamStartTime(
+        const FormatContextPtr& format, int32_t index, int32_t maxPackets) noexcept;
 
     /**
      * Gets total number of frames and the duration of a stream represented in microseconds.
+     * @note This may read packets from the format context, it is returned to the start of the file afterwards.
+     * @param format         The format context.
+     * @param index          The index of the stream.
+     * @param startTimeStamp The stream start time in the stream timebase (see @GetStreamStartTime).
      * @returns The stream frames and duration.
      */
-    FFFRAMEREADER_NO_EXPORT std::pair<int64_t, int64_t> getStreamFramesDuration() const noexcept;
+    FFFRAMEREADER_NO_EXPORT static std::pair<int64_t, int64_t> GetStreamFramesDuration(
+        const FormatContextPtr& format, int32_t index, int64_t startTimeStamp) noexcept;
 
     /**
      * Gets the duration of a stream represented in microseconds (AV_TIME_BASE).
      * @returns The duration.
      */
     FFFRAMEREADER_NO_EXPORT int64_t getStreamDuration() const noexcept;
+
+    /**
+     * Scans all packets of the primary video stream in a file without opening a decoder.
+     * @param fileName       Filename of the file to open.
+     * @param startTimeStamp The start time stamp in the stream time base, or INT64_MIN to use the container value.
+     * @returns A list of packet information.
+     */
+    FFFRAMEREADER_NO_EXPORT static std::vector<PacketInfo> scanStreamPackets(
+        const std::string& fileName, int64_t startTimeStamp) noexcept;
 };
 } // namespace Ffr
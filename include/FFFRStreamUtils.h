@@ -29,11 +29,31 @@ public:
 
     FFFRAMEREADER_NO_EXPORT static AVPixelFormat getPixelFormat(const Stream* stream) noexcept;
 
+    /**
+     * Gets the pixel format used for output frames by replacing any deprecated formats.
+     * @param format The decoded pixel format.
+     * @returns The output pixel format.
+     */
+    FFFRAMEREADER_NO_EXPORT static AVPixelFormat getPixelFormat(AVPixelFormat format) noexcept;
+
     FFFRAMEREADER_NO_EXPORT static AVRational getFrameRate(const Stream* stream) noexcept;
 
     FFFRAMEREADER_NO_EXPORT static AVRational getTimeBase(const Stream* stream) noexcept;
 
     FFFRAMEREADER_NO_EXPORT static void rescale(
         FramePtr& frame, const AVRational& sourceTimeBase, const AVRational& destTimeBase) noexcept;
+
+    /**
+     * Query if the luma plane of a pixel format can be used directly as a GRAY8 image.
+     * @param format The pixel format.
+     * @returns True if the format stores 8-bit luma in its own plane.
+     */
+    FFFRAMEREADER_NO_EXPORT static bool hasLumaPlane(AVPixelFormat format) noexcept;
+
+    /**
+     * Converts a YUV frame to GRAY8 by releasing all chroma planes. No data is copied.
+     * @param [in,out] frame The frame to convert.
+     */
+    FFFRAMEREADER_NO_EXPORT static void removeChroma(FramePtr& frame) noexcept;
 };
 } // namespace Ffr
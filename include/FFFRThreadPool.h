@@ -0,0 +1,82 @@
+/**
+ * Copyright 2019 Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+#include "FFFrameReader.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Ffr {
+class ThreadPool
+{
+public:
+    FFFRAMEREADER_NO_EXPORT ThreadPool() = delete;
+
+    /**
+     * Constructor.
+     * @param numThreads The number of worker threads (0 to use the number of hardware threads).
+     */
+    FFFRAMEREADER_NO_EXPORT explicit ThreadPool(uint32_t numThreads) noexcept;
+
+    FFFRAMEREADER_NO_EXPORT ~ThreadPool() noexcept;
+
+    FFFRAMEREADER_NO_EXPORT ThreadPool(const ThreadPool& other) = delete;
+
+    FFFRAMEREADER_NO_EXPORT ThreadPool(ThreadPool&& other) noexcept = delete;
+
+    FFFRAMEREADER_NO_EXPORT ThreadPool& operator=(const ThreadPool& other) = delete;
+
+    FFFRAMEREADER_NO_EXPORT ThreadPool& operator=(ThreadPool&& other) noexcept = delete;
+
+    /**
+     * Adds a task to the pool.
+     * @note This throws if the task state can not be allocated, callers should then run the task themselves.
+     * @param task The task to run.
+     * @returns A future holding the tasks return value. If the task could not be queued then it is run immediately on
+     *  the calling thread.
+     */
+    FFFRAMEREADER_NO_EXPORT std::future<bool> push(std::function<bool()> task);
+
+    /**
+     * Gets the number of worker threads.
+     * @returns The number of threads.
+     */
+    FFFRAMEREADER_NO_EXPORT uint32_t getNumThreads() const noexcept;
+
+    /**
+     * Gets the shared thread pool used for internal processing.
+     * @returns The thread pool.
+     */
+    FFFRAMEREADER_NO_EXPORT static std::shared_ptr<ThreadPool> getThreadPool() noexcept;
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition; /**< Signalled whenever a task is added or the pool is stopped */
+    std::deque<std::packaged_task<bool()>> m_tasks; /**< The queue of pending tasks */
+    std::vector<std::thread> m_threads;             /**< The worker threads */
+    bool m_stop = false;                            /**< True once the pool is being destroyed */
+
+    /**
+     * Worker thread loop.
+     */
+    FFFRAMEREADER_NO_EXPORT void run() noexcept;
+};
+} // namespace Ffr
@@ -18,8 +18,11 @@
 #include "FFFRExports.h"
 
 #include <any>
+#include <array>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <string>
 struct AVFormatContext;
 struct AVCodecContext;
 struct AVFrame;
@@ -29,6 +32,8 @@ class MultiCrop;
 }
 
 namespace Ffr {
+class MemoryTracker;
+
 enum class DecodeType
 {
     Software,
@@ -39,6 +44,7 @@ enum class EncodeType
 {
     h264,
     h265,
+    ffv1,
 };
 
 struct Resolution
@@ -55,6 +61,37 @@ struct Crop
     uint32_t m_right;  /**< The offset in pixels from right of frame */
 };
 
+enum class ScaleMode
+{
+    Stretch,   /**< Scale to exactly the requested resolution */
+    Letterbox, /**< Scale to fit within the requested resolution preserving aspect ratio and pad the remaining area */
+};
+
+enum class ScaleAlgorithm
+{
+    FastBilinear, /**< Fast bilinear, lowest quality but cheapest */
+    Bilinear,     /**< Bilinear */
+    Area,         /**< Area averaging, well suited to large downscales */
+    Bicubic,      /**< Bicubic */
+    Lanczos,      /**< Lanczos, highest quality but most expensive */
+};
+
+struct OutputTransform
+{
+    double m_scaleX = 1.0;  /**< Horizontal scale applied to source frame coordinates */
+    double m_scaleY = 1.0;  /**< Vertical scale applied to source frame coordinates */
+    double m_offsetX = 0.0; /**< Horizontal offset in output pixels added after scaling */
+    double m_offsetY = 0.0; /**< Vertical offset in output pixels added after scaling */
+};
+
+struct FilterStatistics
+{
+    uint32_t m_threads = 0;    /**< Number of slice threads used by the filter graph (0 if no filter graph is used) */
+    uint64_t m_frames = 0;     /**< Number of frames output from the filter graph */
+    int64_t m_sendTime = 0;    /**< Total time spent submitting frames to the filter graph in microseconds */
+    int64_t m_receiveTime = 0; /**< Total time spent retrieving filtered frames in microseconds */
+};
+
 struct Rational
 {
     int32_t m_numerator;
@@ -70,11 +107,119 @@ enum class PixelFormat : int32_t
     NV12 = 23,   /**< planar YUV 4:2:0, 12bpp, 1 plane for Y and 1 plane for the UV components, which are interleaved
                     (first byte U and the following byte V) */
 
+    YUV420P10 = 64, /**< planar YUV 4:2:0, 15bpp, (1 Cr & Cb sample per 2x2 Y samples), 10-bit little-endian */
+    YUV422P10 = 66, /**< planar YUV 4:2:2, 20bpp, (1 Cr & Cb sample per 2x1 Y samples), 10-bit little-endian */
+    YUV444P16 = 51, /**< planar YUV 4:4:4, 48bpp, (1 Cr & Cb sample per 1x1 Y samples), 16-bit little-endian */
+    P010 = 161,     /**< like NV12, with 10bpp per component, data in the high bits, zeros in the low bits,
+                       little-endian */
+
     RGB8P = 73, /**< planar RGB 4:4:4 24bpp */
 
     RGB32FP = 178, /**< IEEE-754 single precision planar RGB 4:4:4, 96bpp */
 
     RGB8 = 2, /**< packed RGB 8:8:8, 24bpp, RGBRGB... */
+
+    RGB48 = 35, /**< packed RGB 16:16:16, 48bpp, 16R, 16G, 16B, little-endian */
+
+    GRAY8 = 8,     /**< Y, 8bpp (luma only) */
+    GRAY32F = 186, /**< IEEE-754 single precision Y, 32bpp (luma only) */
+};
+
+enum class TensorLayout
+{
+    NCHW, /**< Planar, each frame stores each channel as a separate contiguous plane */
+    NHWC, /**< Interleaved, each frame stores all channels of a pixel contiguously */
+};
+
+enum class TensorType
+{
+    UInt8,   /**< Unsigned 8bit values in the range [0, 255] */
+    Float32, /**< IEEE-754 single precision values normalised to the range [0, 1] */
+    Float16, /**< IEEE-754 half precision values normalised to the range [0, 1] */
+};
+
+struct ConvertOptions
+{
+    std::array<float, 3> m_scale = {1.0f, 1.0f, 1.0f}; /**< Per-channel scale applied to each normalised value. For
+                                                          mean/std normalisation this is 1/std */
+    std::array<float, 3> m_offset = {0.0f, 0.0f, 0.0f}; /**< Per-channel offset added after scaling. For mean/std
+                                                           normalisation this is -mean/std */
+    bool m_swapRB = false; /**< True to swap the first and last channels (e.g. output BGR instead of RGB). This is
+                              only supported for RGB outputs, conversions to YUV or gray formats fail if set. */
+};
+
+struct PacketInfo
+{
+    int64_t m_timeStamp;       /**< The presentation time stamp in microseconds (AV_TIME_BASE), INT64_MIN if unknown */
+    int64_t m_decodeTimeStamp; /**< The decoding time stamp in microseconds (AV_TIME_BASE) or INT64_MIN if unknown */
+    int64_t m_duration;        /**< The packet duration in microseconds (AV_TIME_BASE) or 0 if unknown */
+    int64_t m_position;        /**< The byte position of the packet within the file or -1 if unknown */
+    uint32_t m_size;           /**< The size of the packet in bytes */
+    bool m_keyFrame;           /**< True if the packet contains a key frame */
+};
+
+struct StreamInfo
+{
+    bool m_valid = false;                     /**< True if the file was successfully probed */
+    uint32_t m_width = 0;                     /**< The width of the video stream */
+    uint32_t m_height = 0;                    /**< The height of the video stream */
+    double m_aspectRatio = 0.0;               /**< The display aspect ratio of the video stream */
+    PixelFormat m_format = PixelFormat::Auto; /**< The pixel format of decoded frames */
+    int64_t m_totalFrames = 0;                /**< The total number of frames in the video stream */
+    int64_t m_duration = 0;                   /**< The duration of the video stream in microseconds (AV_TIME_BASE) */
+    double m_frameRate = 0.0;                 /**< The frame rate (fps) of the video stream */
+    std::string m_codec;                      /**< The name of the codec used by the video stream */
+    bool m_intraOnly = false;                 /**< True if every frame can be decoded independently */
+};
+
+class FrameAllocator
+{
+public:
+    FFFRAMEREADER_EXPORT FrameAllocator() = default;
+
+    FFFRAMEREADER_EXPORT virtual ~FrameAllocator() = default;
+
+    FFFRAMEREADER_EXPORT FrameAllocator(const FrameAllocator& other) = default;
+
+    FFFRAMEREADER_EXPORT FrameAllocator(FrameAllocator&& other) = default;
+
+    FFFRAMEREADER_EXPORT FrameAllocator& operator=(const FrameAllocator& other) = default;
+
+    FFFRAMEREADER_EXPORT FrameAllocator& operator=(FrameAllocator&& other) = default;
+
+    /**
+     * Allocates memory used to store a frame image plane.
+     * @note This may be called from any decoding thread.
+     * @param size The required size in bytes.
+     * @returns Pointer to the allocated memory (aligned to at least @getAlignment), nullptr if failed.
+     */
+    FFFRAMEREADER_EXPORT virtual uint8_t* allocate(size_t size) noexcept = 0;
+
+    /**
+     * Frees memory previously returned by @allocate.
+     * @note This may be called from any thread once the last frame using the memory has been released.
+     * @param data Pointer to the memory.
+     * @param size The size in bytes that was passed to @allocate.
+     */
+    FFFRAMEREADER_EXPORT virtual void deallocate(uint8_t* data, size_t size) noexcept = 0;
+
+    /**
+     * Gets the required alignment of each image plane and line in bytes.
+     * @returns The alignment (must be a power of 2).
+     */
+    FFFRAMEREADER_EXPORT virtual uint32_t getAlignment() const noexcept
+    {
+        return 64;
+    }
+
+    /**
+     * Gets the number of additional bytes required at the end of each image plane.
+     * @returns The padding in bytes.
+     */
+    FFFRAMEREADER_EXPORT virtual uint32_t getPadding() const noexcept
+    {
+        return 0;
+    }
 };
 
 class DecoderOptions
@@ -102,21 +247,46 @@ public:
     Crop m_crop = {0, 0, 0, 0};               /**< The output cropping or (0) if no crop should be performed. */
     Resolution m_scale = {0, 0}; /**< The output resolution or (0, 0) if no scaling should be performed. Scaling is
                                     performed after cropping. */
+    ScaleMode m_scaleMode = ScaleMode::Stretch; /**< How the output resolution is achieved when scaling. */
+    uint32_t m_padColour = 0x000000;            /**< The RGB colour (0xRRGGBB) used to fill padded areas. */
+    ScaleAlgorithm m_scaleAlgorithm = ScaleAlgorithm::Bilinear; /**< The interpolation used for software scaling. */
+    uint32_t m_filterThreads = 0; /**< Number of threads used for slice threaded filtering (0 for auto based on the
+                                     output resolution and available cores, 1 to disable). */
     PixelFormat m_format = PixelFormat::Auto; /**< The required output pixel format (auto to keep format the same). */
     uint32_t m_bufferLength = 10;             /**< Number of frames in the the decode buffer.
                                               This also controls the maximum number of frames that can be allocated at a time. */
+    bool m_adaptiveBuffer = false;            /**< True to adapt the buffer length to the consumption pattern. The
+                                              buffer grows while frames are read sequentially and shrinks on seeks or
+                                              when the memory budget is exceeded. @m_bufferLength is used as the
+                                              initial length. */
+    uint32_t m_minBufferLength = 1;           /**< The minimum buffer length when using an adaptive buffer. */
+    uint32_t m_maxBufferLength = 60;          /**< The maximum buffer length when using an adaptive buffer. */
     uint32_t m_seekThreshold = 0;             /**< Maximum number of frames for a forward seek to continue
                                               to decode instead of seeking. This should be optimised based on a sources
                                               key frame interval so that forward decoding is used when it provides faster seeks. A
                                               value of 0 uses automatic detection. */
     bool m_noBufferFlush = false; /**< True to skip buffer flushing on seeks. This results in more decoding but can
                                      improve seek performance for decoders that have an expensive flush */
+    uint32_t m_decodeInstances = 0; /**< Maximum number of decoder instances used to retrieve a frame sequence from
+                                       an intra-only stream concurrently (0 for auto, 1 to disable). */
     std::any m_context;           /**< Pointer to an existing context to be used for hardware
                                    decoding. This must match the hardware type specified in @m_type. */
     uint32_t m_device = 0;        /**< The device index for the desired hardware device. */
     bool m_outputHost = true;     /**< True to output each frame to host CPU memory (only affects hardware decoding). */
+    std::shared_ptr<FrameAllocator> m_allocator = nullptr; /**< Optional allocator used for the memory of all host
+                                                          frames. Decoders that support direct rendering and hardware
+                                                          transfers write straight into this memory, filter output is
+                                                          copied into it. */
 };
 
+/**
+ * Callback that receives encoded output data.
+ * @param data The output data.
+ * @param size The size of the data in bytes.
+ * @returns True if the data was consumed, false to stop encoding.
+ */
+using OutputWriter = std::function<bool(const uint8_t* data, size_t size)>;
+
 class EncoderOptions
 {
 public:
@@ -156,6 +326,24 @@ public:
                              but increased encoding time. */
     uint32_t m_numThreads = 0;        /**< Requested number of threads to use for encoding (0 for default) */
     uint32_t m_gopSize = 0;           /**< Requested output gop size (0 for default) */
+    bool m_pipelined = true; /**< True to run decoding, encoding and muxing concurrently on separate threads */
+    uint32_t m_segments = 1; /**< Number of key frame aligned segments of the input that are encoded concurrently
+                                and then concatenated (0 for one per hardware thread, 1 to disable) */
+    bool m_fragmented = false; /**< True to write fragmented MP4/MOV output where each key frame starts a self
+                                  contained fragment that is output as soon as it is complete. The fragment duration is
+                                  controlled by @m_gopSize */
+    OutputWriter m_writer = nullptr; /**< Optional callback that receives all output data instead of it being written
+                                        to file (the file name is then only used to select the container). The output
+                                        is not seekable so the container must support streaming or @m_fragmented must
+                                        be used */
+};
+
+struct EncoderOutput
+{
+    std::string m_fileName;                                     /**< File name of the file to write to. */
+    Resolution m_scale = {0, 0};                                /**< The output resolution or (0, 0) for no scaling. */
+    ScaleAlgorithm m_scaleAlgorithm = ScaleAlgorithm::Bilinear; /**< The interpolation used for scaling. */
+    EncoderOptions m_options;                                   /**< Options for controlling encoding. */
 };
 
 class FormatContextPtr
@@ -191,6 +379,8 @@ class CodecContextPtr
 
     FFFRAMEREADER_NO_EXPORT explicit CodecContextPtr(AVCodecContext* codecContext) noexcept;
 
+    FFFRAMEREADER_NO_EXPORT CodecContextPtr(AVCodecContext* codecContext, std::shared_ptr<void> owned) noexcept;
+
     FFFRAMEREADER_NO_EXPORT AVCodecContext* get() const noexcept;
 
     FFFRAMEREADER_NO_EXPORT AVCodecContext* operator->() const noexcept;
@@ -207,6 +397,8 @@ class FramePtr
     friend class StreamUtils;
     friend class FFR;
     friend class Fmc::MultiCrop;
+    friend class FramePool;
+    friend class Scaler;
 
 public:
     FFFRAMEREADER_NO_EXPORT ~FramePtr() noexcept;
@@ -235,6 +427,37 @@ private:
     AVFrame* m_frame = nullptr;
 };
 
+class MemoryReservation
+{
+    friend class Frame;
+    friend class Stream;
+
+public:
+    FFFRAMEREADER_NO_EXPORT ~MemoryReservation() noexcept;
+
+    FFFRAMEREADER_NO_EXPORT MemoryReservation(const MemoryReservation& other) noexcept = delete;
+
+    FFFRAMEREADER_NO_EXPORT MemoryReservation& operator=(const MemoryReservation& other) noexcept = delete;
+
+private:
+    FFFRAMEREADER_NO_EXPORT MemoryReservation() noexcept = default;
+
+    FFFRAMEREADER_NO_EXPORT MemoryReservation(std::shared_ptr<MemoryTracker> tracker, uint64_t size) noexcept;
+
+    FFFRAMEREADER_NO_EXPORT MemoryReservation(MemoryReservation&& other) noexcept;
+
+    FFFRAMEREADER_NO_EXPORT MemoryReservation& operator=(MemoryReservation&& other) noexcept;
+
+    /**
+     * Updates the size of the reservation.
+     * @param size The new size in bytes.
+     */
+    FFFRAMEREADER_NO_EXPORT void update(uint64_t size) noexcept;
+
+    std::shared_ptr<MemoryTracker> m_tracker = nullptr;
+    uint64_t m_size = 0;
+};
+
 class OutputFormatContextPtr
 {
     friend class Encoder;
@@ -81,7 +81,52 @@ FFFRAMEREADER_EXPORT int32_t getImagePlaneStep(
     PixelFormat format, uint32_t width, uint32_t height, uint32_t plane) noexcept;
 
 /**
- * Convert pixel format using cuda.
+ * Gets the size of a contiguous tensor used to hold a batch of frames.
+ * @param format The pixel format used to determine the tensor channels (RGB8, RGB8P and RGB32FP give RGB channels,
+ *  YUV444P gives YUV channels).
+ * @param width  The frame width.
+ * @param height The frame height.
+ * @param frames The number of frames in the batch.
+ * @param type   The tensor data type.
+ * @returns The tensor size in bytes or negative value if invalid format.
+ */
+FFFRAMEREADER_EXPORT int64_t getTensorSize(
+    PixelFormat format, uint32_t width, uint32_t height, uint32_t frames, TensorType type) noexcept;
+
+/**
+ * Sets a process wide budget for the host memory used by decoded frames across all streams. Once the budget is
+ * exceeded streams stop decoding ahead and only return the frames they have already decoded.
+ * @param budget   The memory budget in bytes (0 for unlimited).
+ * @param waitTime (Optional) Maximum time in milliseconds a stream will block waiting for other frames to be released
+ *  once the budget is exceeded (0 to not wait).
+ */
+FFFRAMEREADER_EXPORT void setMemoryBudget(uint64_t budget, uint32_t waitTime = 0) noexcept;
+
+/**
+ * Gets the current process wide memory budget.
+ * @returns The memory budget in bytes (0 if unlimited).
+ */
+FFFRAMEREADER_EXPORT uint64_t getMemoryBudget() noexcept;
+
+/**
+ * Gets the host memory currently used by decoded frames across all streams. This includes frames held by the user.
+ * @returns The memory usage in bytes.
+ */
+FFFRAMEREADER_EXPORT uint64_t getMemoryUsage() noexcept;
+
+/**
+ * Gets the peak host memory used by decoded frames across all streams.
+ * @returns The peak memory usage in bytes.
+ */
+FFFRAMEREADER_EXPORT uint64_t getPeakMemoryUsage() noexcept;
+
+/**
+ * Resets the peak memory usage to the current memory usage.
+ */
+FFFRAMEREADER_EXPORT void resetPeakMemoryUsage() noexcept;
+
+/**
+ * Convert pixel format using cuda (or the CPU for frames in host memory).
  * @param       frame     The input frame.
  * @param [out] outMem    Memory location to store output (must be allocated with enough size for output frame see
  *  @getImageSize).
@@ -91,6 +136,20 @@ FFFRAMEREADER_EXPORT int32_t getImagePlaneStep(
 FFFRAMEREADER_EXPORT bool convertFormat(
     const std::shared_ptr<Frame>& frame, uint8_t* outMem, PixelFormat outFormat) noexcept;
 
+/**
+ * Convert pixel format using cuda (or the CPU for frames in host memory) and apply per-channel normalisation in the
+ * same pass. Each value is normalised to the range [0, 1] before the options scale and offset are applied.
+ * @note Cuda frames only support normalisation when converting to RGB32FP.
+ * @param       frame     The input frame.
+ * @param [out] outMem    Memory location to store output (must be allocated with enough size for output frame see
+ *  @getImageSize).
+ * @param       outFormat The pixel format to convert to.
+ * @param       options   The per-channel normalisation and channel order to apply.
+ * @returns True if it succeeds, false if it fails.
+ */
+FFFRAMEREADER_EXPORT bool convertFormat(const std::shared_ptr<Frame>& frame, uint8_t* outMem, PixelFormat outFormat,
+    const ConvertOptions& options) noexcept;
+
 /**
  * Convert pixel format using cuda asynchronously. This requires the user to manually synchronise the cuda context using
  * @synchroniseConvert.
@@ -103,6 +162,19 @@ FFFRAMEREADER_EXPORT bool convertFormat(
 FFFRAMEREADER_EXPORT bool convertFormatAsync(
     const std::shared_ptr<Frame>& frame, uint8_t* outMem, const PixelFormat outFormat) noexcept;
 
+/**
+ * Convert pixel format using cuda asynchronously and apply per-channel normalisation in the same pass. This requires
+ * the user to manually synchronise the cuda context using @synchroniseConvert.
+ * @param       frame     The input frame.
+ * @param [out] outMem    Memory location to store output (must be allocated with enough size for output frame see
+ *  @getImageSize).
+ * @param       outFormat The pixel format to convert to.
+ * @param       options   The per-channel normalisation and channel order to apply.
+ * @returns True if it succeeds, false if it fails.
+ */
+FFFRAMEREADER_EXPORT bool convertFormatAsync(const std::shared_ptr<Frame>& frame, uint8_t* outMem,
+    PixelFormat outFormat, const ConvertOptions& options) noexcept;
+
 /**
  * Synchronises the internal cuda context.
  * @param stream The last stream used for cuda operations.
@@ -25,6 +25,15 @@ void bindFrameReader(pybind11::module& m)
 {
     m.doc() = "Provides functions to decode and analyse input videos";
 
+    m.def("setMemoryBudget", &setMemoryBudget,
+        "Sets a process wide budget for the host memory used by decoded frames across all streams.",
+        pybind11::arg("budget"), pybind11::arg("waitTime") = 0);
+    m.def("getMemoryBudget", &getMemoryBudget, "Gets the current process wide memory budget.");
+    m.def("getMemoryUsage", &getMemoryUsage,
+        "Gets the host memory currently used by decoded frames across all streams.");
+    m.def("getPeakMemoryUsage", &getPeakMemoryUsage, "Gets the peak host memory used by decoded frames.");
+    m.def("resetPeakMemoryUsage", &resetPeakMemoryUsage, "Resets the peak memory usage to the current memory usage.");
+
     pybind11::enum_<DecodeType>(m, "DecodeType", "")
         .value("Software", DecodeType::Software)
         .value("Cuda", DecodeType::Cuda);
@@ -49,15 +58,88 @@ void bindFrameReader(pybind11::module& m)
         .def("assign", static_cast<Crop& (Crop::*)(const Crop&)>(&Crop::operator=), "",
             pybind11::return_value_policy::automatic, pybind11::arg("other"));
 
+    pybind11::enum_<ScaleMode>(m, "ScaleMode", "")
+        .value("Stretch", ScaleMode::Stretch)
+        .value("Letterbox", ScaleMode::Letterbox);
+
+    pybind11::enum_<ScaleAlgorithm>(m, "ScaleAlgorithm", "")
+        .value("FastBilinear", ScaleAlgorithm::FastBilinear)
+        .value("Bilinear", ScaleAlgorithm::Bilinear)
+        .value("Area", ScaleAlgorithm::Area)
+        .value("Bicubic", ScaleAlgorithm::Bicubic)
+        .value("Lanczos", ScaleAlgorithm::Lanczos);
+
+    pybind11::class_<Rational, std::shared_ptr<Rational>>(m, "Rational", "")
+        .def(pybind11::init(
+            [](int32_t numerator, int32_t denominator) { return new Rational{numerator, denominator}; }))
+        .def_readwrite("numerator", &Rational::m_numerator)
+        .def_readwrite("denominator", &Rational::m_denominator);
+
+    pybind11::class_<OutputTransform, std::shared_ptr<OutputTransform>>(m, "OutputTransform", "")
+        .def(pybind11::init([]() { return new OutputTransform(); }))
+        .def(pybind11::init([](OutputTransform const& o) { return new OutputTransform(o); }))
+        .def_readwrite("scaleX", &OutputTransform::m_scaleX)
+        .def_readwrite("scaleY", &OutputTransform::m_scaleY)
+        .def_readwrite("offsetX", &OutputTransform::m_offsetX)
+        .def_readwrite("offsetY", &OutputTransform::m_offsetY);
+
+    pybind11::class_<FilterStatistics, std::shared_ptr<FilterStatistics>>(m, "FilterStatistics", "")
+        .def(pybind11::init([]() { return new FilterStatistics(); }))
+        .def(pybind11::init([](FilterStatistics const& o) { return new FilterStatistics(o); }))
+        .def_readwrite("threads", &FilterStatistics::m_threads)
+        .def_readwrite("frames", &FilterStatistics::m_frames)
+        .def_readwrite("sendTime", &FilterStatistics::m_sendTime)
+        .def_readwrite("receiveTime", &FilterStatistics::m_receiveTime);
+
     pybind11::enum_<PixelFormat>(m, "PixelFormat", "")
         .value("Auto", PixelFormat::Auto)
         .value("YUV420P", PixelFormat::YUV420P)
         .value("YUV422P", PixelFormat::YUV422P)
         .value("YUV444P", PixelFormat::YUV444P)
         .value("NV12", PixelFormat::NV12)
+        .value("YUV420P10", PixelFormat::YUV420P10)
+        .value("YUV422P10", PixelFormat::YUV422P10)
+        .value("YUV444P16", PixelFormat::YUV444P16)
+        .value("P010", PixelFormat::P010)
         .value("RGB8P", PixelFormat::RGB8P)
         .value("RGB32FP", PixelFormat::RGB32FP)
-        .value("RGB8", PixelFormat::RGB8);
+        .value("RGB8", PixelFormat::RGB8)
+        .value("RGB48", PixelFormat::RGB48)
+        .value("GRAY8", PixelFormat::GRAY8)
+        .value("GRAY32F", PixelFormat::GRAY32F);
+
+    pybind11::enum_<TensorLayout>(m, "TensorLayout", "")
+        .value("NCHW", TensorLayout::NCHW)
+        .value("NHWC", TensorLayout::NHWC);
+
+    pybind11::enum_<TensorType>(m, "TensorType", "")
+        .value("UInt8", TensorType::UInt8)
+        .value("Float32", TensorType::Float32)
+        .value("Float16", TensorType::Float16);
+
+    pybind11::class_<PacketInfo, std::shared_ptr<PacketInfo>>(m, "PacketInfo", "")
+        .def(pybind11::init([]() { return new PacketInfo(); }))
+        .def(pybind11::init([](PacketInfo const& o) { return new PacketInfo(o); }))
+        .def_readwrite("timeStamp", &PacketInfo::m_timeStamp)
+        .def_readwrite("decodeTimeStamp", &PacketInfo::m_decodeTimeStamp)
+        .def_readwrite("duration", &PacketInfo::m_duration)
+        .def_readwrite("position", &PacketInfo::m_position)
+        .def_readwrite("size", &PacketInfo::m_size)
+        .def_readwrite("keyFrame", &PacketInfo::m_keyFrame);
+
+    pybind11::class_<StreamInfo, std::shared_ptr<StreamInfo>>(m, "StreamInfo", "")
+        .def(pybind11::init([]() { return new StreamInfo(); }))
+        .def(pybind11::init([](StreamInfo const& o) { return new StreamInfo(o); }))
+        .def_readwrite("valid", &StreamInfo::m_valid)
+        .def_readwrite("width", &StreamInfo::m_width)
+        .def_readwrite("height", &StreamInfo::m_height)
+        .def_readwrite("aspectRatio", &StreamInfo::m_aspectRatio)
+        .def_readwrite("format", &StreamInfo::m_format)
+        .def_readwrite("totalFrames", &StreamInfo::m_totalFrames)
+        .def_readwrite("duration", &StreamInfo::m_duration)
+        .def_readwrite("frameRate", &StreamInfo::m_frameRate)
+        .def_readwrite("codec", &StreamInfo::m_codec)
+        .def_readwrite("intraOnly", &StreamInfo::m_intraOnly);
 
     pybind11::class_<DecoderOptions, std::shared_ptr<DecoderOptions>>(m, "DecoderOptions", "")
         .def(pybind11::init([]() { return new DecoderOptions(); }))
@@ -66,10 +148,18 @@ void bindFrameReader(pybind11::module& m)
         .def_readwrite("type", &DecoderOptions::m_type)
         .def_readwrite("crop", &DecoderOptions::m_crop)
         .def_readwrite("scale", &DecoderOptions::m_scale)
+        .def_readwrite("scaleMode", &DecoderOptions::m_scaleMode)
+        .def_readwrite("padColour", &DecoderOptions::m_padColour)
+        .def_readwrite("scaleAlgorithm", &DecoderOptions::m_scaleAlgorithm)
+        .def_readwrite("filterThreads", &DecoderOptions::m_filterThreads)
         .def_readwrite("format", &DecoderOptions::m_format)
         .def_readwrite("bufferLength", &DecoderOptions::m_bufferLength)
+        .def_readwrite("adaptiveBuffer", &DecoderOptions::m_adaptiveBuffer)
+        .def_readwrite("minBufferLength", &DecoderOptions::m_minBufferLength)
+        .def_readwrite("maxBufferLength", &DecoderOptions::m_maxBufferLength)
         .def_readwrite("seekThreshold", &DecoderOptions::m_seekThreshold)
         .def_readwrite("noBufferFlush", &DecoderOptions::m_noBufferFlush)
+        .def_readwrite("decodeInstances", &DecoderOptions::m_decodeInstances)
         .def_readwrite("context", &DecoderOptions::m_context)
         .def_readwrite("device", &DecoderOptions::m_device)
         .def_readwrite("outputHost", &DecoderOptions::m_outputHost)
@@ -124,8 +214,16 @@ void bindFrameReader(pybind11::module& m)
             "Gets the frame rate (fps) of the video stream.")
         .def("getFrameSize", static_cast<uint32_t (Stream::*)() const>(&Stream::getFrameSize),
             "Gets the storage size of each decoded frame in the video stream.")
+        .def("getOutputTransform", static_cast<OutputTransform (Stream::*)() const>(&Stream::getOutputTransform),
+            "Gets the transform that maps coordinates in the decoded source frame to the output frames.")
+        .def("getFilterStatistics", static_cast<FilterStatistics (Stream::*)() const>(&Stream::getFilterStatistics),
+            "Gets the threading and timing statistics of the streams filter graph.")
         .def("getDecodeType", static_cast<DecodeType (Stream::*)() const>(&Stream::getDecodeType),
             "Gets the type of decoding used.")
+        .def("isIntraOnly", static_cast<bool (Stream::*)() const>(&Stream::isIntraOnly),
+            "Query if every frame in the stream can be decoded independently.")
+        .def("getMemoryUsage", static_cast<uint64_t (Stream::*)() const>(&Stream::getMemoryUsage),
+            "Gets the host memory currently used by decoded frames from this stream.")
         .def("peekNextFrame", static_cast<std::shared_ptr<Frame> (Stream::*)()>(&Stream::peekNextFrame),
             "Get the next frame in the stream without removing it from stream buffer.")
         .def("getNextFrame", static_cast<std::shared_ptr<Frame> (Stream::*)()>(&Stream::getNextFrame),
@@ -144,9 +242,29 @@ void bindFrameReader(pybind11::module& m)
             pybind11::arg("frame"))
         .def("timeToFrame", static_cast<int64_t (Stream::*)(int64_t) const>(&Stream::timeToFrame),
             "Convert a time value represented in microseconds (AV_TIME_BASE) to a zero-based frame number.",
-            pybind11::arg("time"));
+            pybind11::arg("time"))
+        .def("scanPackets", static_cast<std::vector<PacketInfo> (Stream::*)() const>(&Stream::scanPackets),
+            "Scans all packets of the video stream without performing any decoding.")
+        .def_static("scanFilePackets",
+            static_cast<std::vector<PacketInfo> (*)(const std::string&)>(&Stream::scanPackets),
+            "Scans all packets of the primary video stream in a file without opening a decoder.",
+            pybind11::arg("fileName"))
+        .def_static("probe",
+            static_cast<StreamInfo (*)(const std::string&, int64_t, int64_t)>(&Stream::probe),
+            "Gets the properties of the primary video stream in a file without opening a decoder.",
+            pybind11::arg("fileName"), pybind11::arg("probeSize") = 0, pybind11::arg("analyzeDuration") = 0,
+            pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def_static("probe",
+            static_cast<std::vector<StreamInfo> (*)(const std::vector<std::string>&, int64_t, int64_t)>(
+                &Stream::probe),
+            "Gets the properties of the primary video stream in multiple files concurrently.",
+            pybind11::arg("fileNames"), pybind11::arg("probeSize") = 0, pybind11::arg("analyzeDuration") = 0,
+            pybind11::call_guard<pybind11::gil_scoped_release>());
 
-    pybind11::enum_<EncodeType>(m, "EncodeType", "").value("h264", EncodeType::h264).value("h265", EncodeType::h265);
+    pybind11::enum_<EncodeType>(m, "EncodeType", "")
+        .value("h264", EncodeType::h264)
+        .value("h265", EncodeType::h265)
+        .value("ffv1", EncodeType::ffv1);
 
     {
         pybind11::class_<EncoderOptions, std::shared_ptr<EncoderOptions>> cl(m, "EncoderOptions", "");
@@ -168,6 +286,27 @@ void bindFrameReader(pybind11::module& m)
         cl.def_readwrite("preset", &EncoderOptions::m_preset);
         cl.def_readwrite("numThreads", &EncoderOptions::m_numThreads);
         cl.def_readwrite("gopSize", &EncoderOptions::m_gopSize);
+        cl.def_readwrite("pipelined", &EncoderOptions::m_pipelined);
+        cl.def_readwrite("segments", &EncoderOptions::m_segments);
+        cl.def_readwrite("fragmented", &EncoderOptions::m_fragmented);
+        cl.def_property(
+            "writer", nullptr,
+            [](EncoderOptions& options, const pybind11::object& writer) {
+                if (writer.is_none()) {
+                    options.m_writer = nullptr;
+                    return;
+                }
+                // The writer is called from encoding threads so the GIL must be held whenever it is used or released
+                std::shared_ptr<pybind11::object> function(new pybind11::object(writer), [](pybind11::object* p) {
+                    pybind11::gil_scoped_acquire gil;
+                    delete p;
+                });
+                options.m_writer = [function](const uint8_t* data, const size_t size) {
+                    pybind11::gil_scoped_acquire gil;
+                    return (*function)(pybind11::bytes(reinterpret_cast<const char*>(data), size)).cast<bool>();
+                };
+            },
+            "Callback that receives all output data as bytes");
         cl.def("assign",
             static_cast<EncoderOptions& (EncoderOptions::*)(const EncoderOptions&)>(&EncoderOptions::operator=), "",
             pybind11::return_value_policy::automatic, pybind11::arg("other"));
@@ -179,12 +318,104 @@ void bindFrameReader(pybind11::module& m)
             pybind11::arg("other"));
     }
 
+    pybind11::class_<EncoderOutput, std::shared_ptr<EncoderOutput>>(m, "EncoderOutput", "")
+        .def(pybind11::init([]() { return new EncoderOutput(); }))
+        .def(pybind11::init([](EncoderOutput const& o) { return new EncoderOutput(o); }))
+        .def_readwrite("fileName", &EncoderOutput::m_fileName)
+        .def_readwrite("scale", &EncoderOutput::m_scale)
+        .def_readwrite("scaleAlgorithm", &EncoderOutput::m_scaleAlgorithm)
+        .def_readwrite("options", &EncoderOutput::m_options);
+
     pybind11::class_<Encoder, std::shared_ptr<Encoder>>(m, "Encoder", "")
         .def_static("encodeStream",
             static_cast<bool (*)(const std::string&, const std::shared_ptr<Stream>&, const EncoderOptions&)>(
                 &Encoder::encodeStream),
             "Encodes a stream to a file", pybind11::arg("fileName"), pybind11::arg("stream"),
-            pybind11::arg_v("options", EncoderOptions(), "EncoderOptions()"));
+            pybind11::arg_v("options", EncoderOptions(), "EncoderOptions()"),
+            pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def_static("encodeStream",
+            static_cast<bool (*)(const std::vector<EncoderOutput>&, const std::shared_ptr<Stream>&)>(
+                &Encoder::encodeStream),
+            "Encodes a stream to multiple files using a single decode", pybind11::arg("outputs"),
+            pybind11::arg("stream"), pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def_static("cacheStream",
+            static_cast<bool (*)(const std::string&, const std::shared_ptr<Stream>&, uint32_t)>(&Encoder::cacheStream),
+            "Decodes a stream once into a lossless intra-only intermediate file", pybind11::arg("fileName"),
+            pybind11::arg("stream"), pybind11::arg("numThreads") = 0,
+            pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def_static("copyStream",
+            static_cast<bool (*)(const std::string&, const std::shared_ptr<Stream>&, int64_t, int64_t,
+                const EncoderOptions&)>(&Encoder::copyStream),
+            "Copies the compressed packets of a stream to a file without re-encoding", pybind11::arg("fileName"),
+            pybind11::arg("stream"), pybind11::arg("startTime") = 0, pybind11::arg("endTime") = INT64_MAX,
+            pybind11::arg_v("options", EncoderOptions(), "EncoderOptions()"),
+            pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def_static("copyStreamFrames",
+            static_cast<bool (*)(const std::string&, const std::shared_ptr<Stream>&, int64_t, int64_t,
+                const EncoderOptions&)>(&Encoder::copyStreamFrames),
+            "Copies the compressed packets of a frame range of a stream to a file without re-encoding",
+            pybind11::arg("fileName"), pybind11::arg("stream"), pybind11::arg("startFrame"), pybind11::arg("endFrame"),
+            pybind11::arg_v("options", EncoderOptions(), "EncoderOptions()"),
+            pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def_static("cutStream",
+            static_cast<bool (*)(const std::string&, const std::shared_ptr<Stream>&, int64_t, int64_t,
+                const EncoderOptions&)>(&Encoder::cutStream),
+            "Copies a time range of a stream to a file with frame accurate cut points", pybind11::arg("fileName"),
+            pybind11::arg("stream"), pybind11::arg("startTime"), pybind11::arg("endTime"),
+            pybind11::arg_v("options", EncoderOptions(), "EncoderOptions()"),
+            pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def_static("cutStreamFrames",
+            static_cast<bool (*)(const std::string&, const std::shared_ptr<Stream>&, int64_t, int64_t,
+                const EncoderOptions&)>(&Encoder::cutStreamFrames),
+            "Copies a frame range of a stream to a file with frame accurate cut points", pybind11::arg("fileName"),
+            pybind11::arg("stream"), pybind11::arg("startFrame"), pybind11::arg("endFrame"),
+            pybind11::arg_v("options", EncoderOptions(), "EncoderOptions()"),
+            pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def_static("getEncoder",
+            [](const std::string& fileName, const uint32_t width, const uint32_t height, const PixelFormat format,
+                const Rational frameRate, const EncoderOptions& options, const Rational aspect) {
+                std::shared_ptr<Encoder> encoder;
+                {
+                    pybind11::gil_scoped_release release;
+                    encoder = Encoder::getEncoder(fileName, width, height, format, frameRate, options, aspect);
+                }
+                if (encoder == nullptr) {
+                    return encoder;
+                }
+                // Destroying the encoder waits for any writer callbacks which need the GIL, so it must be released
+                return std::shared_ptr<Encoder>(encoder.get(), [encoder](Encoder*) mutable {
+                    pybind11::gil_scoped_release release;
+                    encoder.reset();
+                });
+            },
+            "Creates an encoder that frames can be pushed to from any source", pybind11::arg("fileName"),
+            pybind11::arg("width"), pybind11::arg("height"), pybind11::arg("format"), pybind11::arg("frameRate"),
+            pybind11::arg_v("options", EncoderOptions(), "EncoderOptions()"),
+            pybind11::arg_v("aspect", Rational{1, 1}, "Rational(1, 1)"))
+        .def("pushFrame", static_cast<bool (Encoder::*)(const Frame&)>(&Encoder::pushFrame),
+            "Adds a frame to be encoded", pybind11::arg("frame"), pybind11::call_guard<pybind11::gil_scoped_release>())
+        .def(
+            "pushRaw",
+            [](Encoder& encoder, const std::vector<pybind11::buffer>& planes, const std::vector<int32_t>& strides,
+                const int64_t timeStamp) {
+                if (planes.size() != strides.size()) {
+                    return false;
+                }
+                // Hold the buffers while the data is copied
+                std::vector<pybind11::buffer_info> buffers;
+                std::vector<const uint8_t*> data;
+                for (const auto& plane : planes) {
+                    buffers.emplace_back(plane.request());
+                    data.push_back(static_cast<const uint8_t*>(buffers.back().ptr));
+                }
+                pybind11::gil_scoped_release release;
+                return encoder.pushRaw(data.data(), strides.data(), static_cast<uint32_t>(data.size()), timeStamp);
+            },
+            "Adds raw image data (one buffer and line size per plane) to be encoded", pybind11::arg("planes"),
+            pybind11::arg("strides"), pybind11::arg("timeStamp"))
+        .def("finish", static_cast<bool (Encoder::*)()>(&Encoder::finish),
+            "Encodes any remaining pushed frames and finalises the output file",
+            pybind11::call_guard<pybind11::gil_scoped_release>());
 }
 
 PYBIND11_MODULE(pyFrameReader, m)
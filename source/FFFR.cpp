@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 #include "FFFRConfig.h"
+#include "FFFRConvert.h"
 #include "FFFRUtility.h"
 #include "FFFrameReader.h"
 
@@ -78,6 +79,16 @@ int32_t getImagePlaneStep(
     return static_cast<int32_t>(ret);
 }
 
+int64_t getTensorSize(const PixelFormat format, const uint32_t width, const uint32_t height, const uint32_t frames,
+    const TensorType type) noexcept
+{
+    const auto channels = Convert::getTensorChannels(format);
+    if (channels < 0) {
+        return -1;
+    }
+    return static_cast<int64_t>(frames) * channels * width * height * Convert::getTensorElementSize(type);
+}
+
 #if FFFR_BUILD_CUDA
 class FFR
 {
@@ -95,6 +106,12 @@ private:
         CUdeviceptr m_plane3;
     };
 
+    struct Normalise
+    {
+        float m_scale[3];
+        float m_offset[3];
+    };
+
     class KernelContext
     {
     public:
@@ -103,6 +120,10 @@ private:
         int m_kernelNV12ToRGB8PMem = 0;
         CUfunction m_kernelNV12ToRGB32FP = nullptr;
         int m_kernelNV12ToRGB32FPMem = 0;
+        CUfunction m_kernelNV12ToRGB16FP = nullptr;
+        int m_kernelNV12ToRGB16FPMem = 0;
+        CUfunction m_kernelNV12ToRGB16F = nullptr;
+        int m_kernelNV12ToRGB16FMem = 0;
         CUcontext m_context = nullptr;
         CUstream m_stream = nullptr;
 
@@ -139,8 +160,26 @@ private:
                 return;
             }
 
+            err = cuModuleGetFunction(&m_kernelNV12ToRGB16FP, m_module, "convertNV12ToRGB16FP");
+            if (err != CUDA_SUCCESS) {
+                const char* errorString;
+                cuGetErrorName(err, &errorString);
+                logInternal(LogLevel::Error, "Failed to retrieve CUDA kernel: ", errorString);
+                return;
+            }
+
+            err = cuModuleGetFunction(&m_kernelNV12ToRGB16F, m_module, "convertNV12ToRGB16F");
+            if (err != CUDA_SUCCESS) {
+                const char* errorString;
+                cuGetErrorName(err, &errorString);
+                logInternal(LogLevel::Error, "Failed to retrieve CUDA kernel: ", errorString);
+                return;
+            }
+
             cuFuncGetAttribute(&m_kernelNV12ToRGB8PMem, CU_FUNC_ATTRIBUTE_SHARED_SIZE_BYTES, m_kernelNV12ToRGB8P);
             cuFuncGetAttribute(&m_kernelNV12ToRGB32FPMem, CU_FUNC_ATTRIBUTE_SHARED_SIZE_BYTES, m_kernelNV12ToRGB32FP);
+            cuFuncGetAttribute(&m_kernelNV12ToRGB16FPMem, CU_FUNC_ATTRIBUTE_SHARED_SIZE_BYTES, m_kernelNV12ToRGB16FP);
+            cuFuncGetAttribute(&m_kernelNV12ToRGB16FMem, CU_FUNC_ATTRIBUTE_SHARED_SIZE_BYTES, m_kernelNV12ToRGB16F);
 
             m_context = context;
             m_stream = stream;
@@ -242,7 +281,8 @@ private:
     }
 
     static CUresult convertNV12ToRGB32FP(const uint8_t* const source[2], uint32_t sourceStep, uint32_t width,
-        uint32_t height, uint8_t* dest[3], uint32_t destStep, KernelContext* context) noexcept
+        uint32_t height, uint8_t* dest[3], uint32_t destStep, const ConvertOptions& options,
+        KernelContext* context) noexcept
     {
         const uint32_t blockX = 8;
         const uint32_t blockY = 8;
@@ -250,11 +290,48 @@ private:
         NV12Planes inMem = {reinterpret_cast<CUdeviceptr>(source[0]), reinterpret_cast<CUdeviceptr>(source[1])};
         RGBPlanes outMem = {reinterpret_cast<CUdeviceptr>(dest[0]), reinterpret_cast<CUdeviceptr>(dest[1]),
             reinterpret_cast<CUdeviceptr>(dest[2])};
-        void* args[] = {&inMem, &sourceStep, &width, &height, &outMem, &destStep};
+        Normalise normalise = {{options.m_scale[0], options.m_scale[1], options.m_scale[2]},
+            {options.m_offset[0], options.m_offset[1], options.m_offset[2]}};
+        void* args[] = {&inMem, &sourceStep, &width, &height, &outMem, &destStep, &normalise};
         return cuLaunchKernel(context->m_kernelNV12ToRGB32FP, divUp(width, blockX), divUp(height, blockY), 1, blockX,
             blockY, 1, context->m_kernelNV12ToRGB32FPMem, context->m_stream, args, nullptr);
     }
 
+    static CUresult convertNV12ToRGB16FP(const uint8_t* const source[2], uint32_t sourceStep, uint32_t width,
+        uint32_t height, uint8_t* dest[3], uint32_t destStep, const ConvertOptions& options,
+        KernelContext* context) noexcept
+    {
+        const uint32_t blockX = 8;
+        const uint32_t blockY = 8;
+
+        NV12Planes inMem = {reinterpret_cast<CUdeviceptr>(source[0]), reinterpret_cast<CUdeviceptr>(source[1])};
+        RGBPlanes outMem = {reinterpret_cast<CUdeviceptr>(dest[0]), reinterpret_cast<CUdeviceptr>(dest[1]),
+            reinterpret_cast<CUdeviceptr>(dest[2])};
+        Normalise normalise = {{options.m_scale[0], options.m_scale[1], options.m_scale[2]},
+            {options.m_offset[0], options.m_offset[1], options.m_offset[2]}};
+        void* args[] = {&inMem, &sourceStep, &width, &height, &outMem, &destStep, &normalise};
+        return cuLaunchKernel(context->m_kernelNV12ToRGB16FP, divUp(width, blockX), divUp(height, blockY), 1, blockX,
+            blockY, 1, context->m_kernelNV12ToRGB16FPMem, context->m_stream, args, nullptr);
+    }
+
+    static CUresult convertNV12ToRGB16F(const uint8_t* const source[2], uint32_t sourceStep, uint32_t width,
+        uint32_t height, uint8_t* dest, uint32_t destStep, const ConvertOptions& options,
+        KernelContext* context) noexcept
+    {
+        const uint32_t blockX = 8;
+        const uint32_t blockY = 8;
+
+        NV12Planes inMem = {reinterpret_cast<CUdeviceptr>(source[0]), reinterpret_cast<CUdeviceptr>(source[1])};
+        RGBPlanes outMem = {reinterpret_cast<CUdeviceptr>(dest), reinterpret_cast<CUdeviceptr>(nullptr),
+            reinterpret_cast<CUdeviceptr>(nullptr)};
+        Normalise normalise = {{options.m_scale[0], options.m_scale[1], options.m_scale[2]},
+            {options.m_offset[0], options.m_offset[1], options.m_offset[2]}};
+        bool swapRB = options.m_swapRB;
+        void* args[] = {&inMem, &sourceStep, &width, &height, &outMem, &destStep, &normalise, &swapRB};
+        return cuLaunchKernel(context->m_kernelNV12ToRGB16F, divUp(width, blockX), divUp(height, blockY), 1, blockX,
+            blockY, 1, context->m_kernelNV12ToRGB16FMem, context->m_stream, args, nullptr);
+    }
+
 #    if FFFR_BUILD_NPPI
     static CUresult cudaNppStatusToError(const NppStatus err) noexcept
     {
@@ -275,8 +352,8 @@ private:
 #    endif
 
 public:
-    static bool convertFormat(
-        const std::shared_ptr<Frame>& frame, uint8_t* const outMem, const PixelFormat outFormat, const bool asynch)
+    static bool convertFormat(const std::shared_ptr<Frame>& frame, uint8_t* const outMem, const PixelFormat outFormat,
+        const ConvertOptions& options, const bool asynch)
     {
         if (frame == nullptr || outMem == nullptr) {
             logInternal(LogLevel::Error, "Invalid frame");
@@ -320,6 +397,22 @@ public:
         int32_t outStep[4];
         av_image_fill_arrays(
             outPlanes, outStep, outMem, getPixelFormat(outFormat), frame->getWidth(), frame->getHeight(), 32);
+        if (options.m_swapRB) {
+            // Planar outputs can swap channels by just swapping the output planes
+            if (outFormat != PixelFormat::RGB8P && outFormat != PixelFormat::RGB32FP) {
+                logInternal(LogLevel::Error, "Channel swapping is only supported for planar RGB output");
+                CUcontext dummy;
+                cuCtxPopCurrent(&dummy);
+                return false;
+            }
+            std::swap(outPlanes[0], outPlanes[2]);
+        }
+        if (outFormat != PixelFormat::RGB32FP && Convert::hasNormalisation(options)) {
+            logInternal(LogLevel::Error, "Normalisation is only supported for RGB32FP output");
+            CUcontext dummy;
+            cuCtxPopCurrent(&dummy);
+            return false;
+        }
 
         const auto data1 = frame->getFrameData(0);
         CUresult ret = CUDA_ERROR_UNKNOWN;
@@ -411,7 +504,7 @@ public:
                     }
                     case PixelFormat::RGB32FP: {
                         ret = convertNV12ToRGB32FP(inMem, data1.second, frame->getWidth(), frame->getHeight(),
-                            outPlanes, outStep[0], kernelProps.get());
+                            outPlanes, outStep[0], options, kernelProps.get());
                         break;
                     }
                     default:
@@ -497,6 +590,81 @@ public:
         return (ret == CUDA_SUCCESS);
     }
 
+    static bool convertToTensor(const Frame& frame, uint8_t* const outMem, const PixelFormat format,
+        const TensorLayout layout, const TensorType type, const ConvertOptions& options) noexcept
+    {
+        if (outMem == nullptr) {
+            logInternal(LogLevel::Error, "Invalid tensor memory");
+            return false;
+        }
+        if (frame.getDataType() != DecodeType::Cuda) {
+            logInternal(LogLevel::Error, "Only CUDA frames are currently supported by CUDA tensor conversion");
+            return false;
+        }
+        if (type != TensorType::Float16) {
+            logInternal(LogLevel::Error, "CUDA tensor conversion only supports the Float16 tensor type");
+            return false;
+        }
+        if (frame.getPixelFormat() != PixelFormat::NV12 ||
+            (format != PixelFormat::RGB8 && format != PixelFormat::RGB8P && format != PixelFormat::RGB32FP)) {
+            logInternal(LogLevel::Error, "CUDA tensor conversion only supports NV12 frames to RGB tensors");
+            return false;
+        }
+        auto* framesContext = reinterpret_cast<AVHWFramesContext*>(frame.m_frame->hw_frames_ctx->data);
+        auto* cudaDevice = reinterpret_cast<AVCUDADeviceContext*>(framesContext->device_ctx->hwctx);
+        if (cuCtxPushCurrent(cudaDevice->cuda_ctx) != CUDA_SUCCESS) {
+            logInternal(LogLevel::Error, "Failed to set CUDA context");
+            return false;
+        }
+        shared_ptr<KernelContext> kernelProps;
+        {
+            lock_guard<mutex> lock(s_mutex);
+            if (!setupContext(cudaDevice->cuda_ctx, cudaDevice->stream)) {
+                CUcontext dummy;
+                cuCtxPopCurrent(&dummy);
+                return false;
+            }
+#    if FFFR_BUILD_NPPI
+            kernelProps = s_contextProperties[cudaDevice->cuda_ctx].second;
+#    else
+            kernelProps = s_contextProperties[cudaDevice->cuda_ctx];
+#    endif
+        }
+
+        // Tensors are tightly packed so each row and plane directly follows the previous one
+        const auto width = frame.getWidth();
+        const auto height = frame.getHeight();
+        const auto data1 = frame.getFrameData(0);
+        const auto data2 = frame.getFrameData(1);
+        const uint8_t* const inMem[2] = {data1.first, data2.first};
+        CUresult ret;
+        if (layout == TensorLayout::NCHW) {
+            const size_t planeSize = static_cast<size_t>(width) * height * sizeof(uint16_t);
+            uint8_t* outPlanes[3] = {outMem, outMem + planeSize, outMem + planeSize * 2};
+            if (options.m_swapRB) {
+                std::swap(outPlanes[0], outPlanes[2]);
+            }
+            ret = convertNV12ToRGB16FP(inMem, data1.second, width, height, outPlanes,
+                width * static_cast<uint32_t>(sizeof(uint16_t)), options, kernelProps.get());
+        } else {
+            ret = convertNV12ToRGB16F(inMem, data1.second, width, height, outMem,
+                width * 3 * static_cast<uint32_t>(sizeof(uint16_t)), options, kernelProps.get());
+        }
+        if (ret == CUDA_SUCCESS) {
+            ret = cuCtxSynchronize();
+        }
+        if (ret != CUDA_SUCCESS) {
+            const char* errorString;
+            cuGetErrorName(ret, &errorString);
+            logInternal(LogLevel::Error, "Tensor conversion failed: ", errorString);
+        }
+        CUcontext dummy;
+        if (cuCtxPopCurrent(&dummy) != CUDA_SUCCESS) {
+            logInternal(LogLevel::Error, "Failed to restore CUDA context");
+        }
+        return (ret == CUDA_SUCCESS);
+    }
+
     static bool synchroniseConvert(const std::shared_ptr<Stream>& stream) noexcept
     {
         if (stream == nullptr || stream->m_codecContext->pix_fmt != AV_PIX_FMT_CUDA || stream->m_outputHost) {
@@ -536,24 +704,56 @@ public:
 
 bool convertFormat(const std::shared_ptr<Frame>& frame, uint8_t* outMem, const PixelFormat outFormat) noexcept
 {
+    return convertFormat(frame, outMem, outFormat, ConvertOptions());
+}
+
+bool convertFormat(const std::shared_ptr<Frame>& frame, uint8_t* outMem, const PixelFormat outFormat,
+    const ConvertOptions& options) noexcept
+{
+    if (frame != nullptr && frame->getDataType() == DecodeType::Software) {
+        return Convert::convertToImage(*frame, outMem, outFormat, options);
+    }
 #if FFFR_BUILD_CUDA
-    return FFR::convertFormat(frame, outMem, outFormat, false);
+    return FFR::convertFormat(frame, outMem, outFormat, options, false);
 #else
-    (void)(frame);
-    (void)(outMem);
-    (void)(outFormat);
+    logInternal(LogLevel::Error, "Invalid frame");
     return false;
 #endif
 }
 
 bool convertFormatAsync(const std::shared_ptr<Frame>& frame, uint8_t* outMem, const PixelFormat outFormat) noexcept
+{
+    return convertFormatAsync(frame, outMem, outFormat, ConvertOptions());
+}
+
+bool convertFormatAsync(const std::shared_ptr<Frame>& frame, uint8_t* outMem, const PixelFormat outFormat,
+    const ConvertOptions& options) noexcept
+{
+    if (frame != nullptr && frame->getDataType() == DecodeType::Software) {
+        // Host conversion is always synchronous
+        return Convert::convertToImage(*frame, outMem, outFormat, options);
+    }
+#if FFFR_BUILD_CUDA
+    return FFR::convertFormat(frame, outMem, outFormat, options, true);
+#else
+    logInternal(LogLevel::Error, "Invalid frame");
+    return false;
+#endif
+}
+
+bool Convert::convertToTensorCuda(const Frame& frame, uint8_t* const outMem, const PixelFormat format,
+    const TensorLayout layout, const TensorType type, const ConvertOptions& options) noexcept
 {
 #if FFFR_BUILD_CUDA
-    return FFR::convertFormat(frame, outMem, outFormat, true);
+    return FFR::convertToTensor(frame, outMem, format, layout, type, options);
 #else
     (void)(frame);
     (void)(outMem);
-    (void)(outFormat);
+    (void)(format);
+    (void)(layout);
+    (void)(type);
+    (void)(options);
+    logInternal(LogLevel::Error, "CUDA tensor conversion requires CUDA support");
     return false;
 #endif
 }
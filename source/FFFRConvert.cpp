@@ -0,0 +1,477 @@
+/**
+ * Copyright 2019 Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "FFFRConvert.h"
+
+#include "FFFRUtility.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#    define FFFR_F16C 1
+#else
+#    define FFFR_F16C 0
+#endif
+
+#if FFFR_F16C
+#    if defined(_MSC_VER)
+#        include <intrin.h>
+#    endif
+#    include <immintrin.h>
+#endif
+
+extern "C" {
+#include <libavutil/imgutils.h>
+}
+
+using namespace std;
+
+namespace Ffr {
+int32_t Convert::getTensorChannels(const PixelFormat format) noexcept
+{
+    switch (format) {
+        case PixelFormat::RGB8:
+        case PixelFormat::RGB8P:
+        case PixelFormat::RGB32FP:
+        case PixelFormat::YUV444P:
+            return 3;
+        case PixelFormat::GRAY8:
+        case PixelFormat::GRAY32F:
+            return 1;
+        default:
+            return -1;
+    }
+}
+
+uint32_t Convert::getTensorElementSize(const TensorType type) noexcept
+{
+    switch (type) {
+        case TensorType::Float32:
+            return sizeof(float);
+        case TensorType::Float16:
+            return sizeof(uint16_t);
+        default:
+            return sizeof(uint8_t);
+    }
+}
+
+bool Convert::hasNormalisation(const ConvertOptions& options) noexcept
+{
+    for (uint32_t i = 0; i < 3; ++i) {
+        if (options.m_scale[i] != 1.0f || options.m_offset[i] != 0.0f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Convert::convertToTensor(const Frame& frame, uint8_t* const outMem, const PixelFormat format,
+    const TensorLayout layout, const TensorType type, const ConvertOptions& options) noexcept
+{
+    if (outMem == nullptr) {
+        logInternal(LogLevel::Error, "Invalid tensor memory");
+        return false;
+    }
+    const auto channels = getTensorChannels(format);
+    if (channels < 0) {
+        logInternal(LogLevel::Error, "Pixel format not supported for tensor output: ", static_cast<int32_t>(format));
+        return false;
+    }
+    const size_t elementSize = getTensorElementSize(type);
+    const size_t rowSize = static_cast<size_t>(frame.getWidth()) * elementSize;
+    const bool toRGB = format != PixelFormat::YUV444P && channels == 3;
+    uint8_t* dest[3] = {nullptr, nullptr, nullptr};
+    if (layout == TensorLayout::NCHW) {
+        // Planar layouts store each channel contiguously
+        const size_t planeSize = rowSize * frame.getHeight();
+        for (int32_t c = 0; c < channels; ++c) {
+            dest[c] = outMem + c * planeSize;
+        }
+        return convert(frame, dest, channels, elementSize, rowSize, type, toRGB, options);
+    }
+    // Interleaved layouts step over all channels
+    for (int32_t c = 0; c < channels; ++c) {
+        dest[c] = outMem + c * elementSize;
+    }
+    return convert(frame, dest, channels, elementSize * channels, rowSize * channels, type, toRGB, options);
+}
+
+bool Convert::convertToImage(
+    const Frame& frame, uint8_t* const outMem, const PixelFormat outFormat, const ConvertOptions& options) noexcept
+{
+    if (outMem == nullptr) {
+        logInternal(LogLevel::Error, "Invalid frame");
+        return false;
+    }
+    uint8_t* outPlanes[4];
+    int32_t outStep[4];
+    if (av_image_fill_arrays(
+            outPlanes, outStep, outMem, getPixelFormat(outFormat), frame.getWidth(), frame.getHeight(), 32) < 0) {
+        logInternal(LogLevel::Error, "Format conversion not currently supported");
+        return false;
+    }
+    switch (outFormat) {
+        case PixelFormat::RGB8: {
+            uint8_t* dest[3] = {outPlanes[0], outPlanes[0] + 1, outPlanes[0] + 2};
+            return convert(frame, dest, 3, 3, outStep[0], TensorType::UInt8, true, options);
+        }
+        case PixelFormat::RGB8P: {
+            return convert(frame, outPlanes, 3, 1, outStep[0], TensorType::UInt8, true, options);
+        }
+        case PixelFormat::RGB32FP: {
+            return convert(frame, outPlanes, 3, sizeof(float), outStep[0], TensorType::Float32, true, options);
+        }
+        case PixelFormat::YUV444P: {
+            return convert(frame, outPlanes, 3, 1, outStep[0], TensorType::UInt8, false, options);
+        }
+        case PixelFormat::GRAY8: {
+            return convert(frame, outPlanes, 1, 1, outStep[0], TensorType::UInt8, false, options);
+        }
+        case PixelFormat::GRAY32F: {
+            return convert(frame, outPlanes, 1, sizeof(float), outStep[0], TensorType::Float32, false, options);
+        }
+        default:
+            logInternal(LogLevel::Error, "Format conversion not currently supported");
+            return false;
+    }
+}
+
+bool Convert::convert(const Frame& frame, uint8_t* dest[3], const int32_t channels, const size_t pixelStep,
+    const size_t rowStep, const TensorType type, const bool toRGB, const ConvertOptions& options) noexcept
+{
+    if (frame.getDataType() != DecodeType::Software) {
+        logInternal(LogLevel::Error, "Conversion requires frames in host memory");
+        return false;
+    }
+    const auto inFormat = frame.getPixelFormat();
+    if (!toRGB &&
+        (inFormat == PixelFormat::RGB8 || inFormat == PixelFormat::RGB8P || inFormat == PixelFormat::RGB32FP ||
+            inFormat == PixelFormat::RGB48)) {
+        logInternal(LogLevel::Error, "Conversion from RGB to YUV is not supported");
+        return false;
+    }
+    if (options.m_swapRB && !toRGB) {
+        logInternal(LogLevel::Error, "Channel swapping is only supported for RGB output");
+        return false;
+    }
+
+    const auto width = frame.getWidth();
+    const auto height = frame.getHeight();
+    vector<float> rowData;
+    vector<uint16_t> halfData;
+    try {
+        rowData.resize(static_cast<size_t>(width) * 3);
+        if (type == TensorType::Float16) {
+            halfData.resize(width);
+        }
+    } catch (...) {
+        logInternal(LogLevel::Error, "Failed to allocate conversion memory");
+        return false;
+    }
+    float* rows[3] = {rowData.data(), rowData.data() + width, rowData.data() + static_cast<size_t>(width) * 2};
+
+    // Normalisation is fused with conversion so that each value is only written once
+    uint8_t* outChannels[3] = {dest[0], dest[1], dest[2]};
+    if (options.m_swapRB && channels == 3) {
+        std::swap(outChannels[0], outChannels[2]);
+    }
+    float scale[3];
+    float offset[3];
+    for (uint32_t c = 0; c < 3; ++c) {
+        scale[c] = options.m_scale[c] / 255.0f;
+        offset[c] = options.m_offset[c];
+    }
+    const bool normalise = hasNormalisation(options);
+
+    for (uint32_t y = 0; y < height; ++y) {
+        if (!readRow(frame, y, rows, toRGB)) {
+            logInternal(
+                LogLevel::Error, "Pixel format not supported for conversion: ", static_cast<int32_t>(inFormat));
+            return false;
+        }
+        for (int32_t c = 0; c < channels; ++c) {
+            float* __restrict source = rows[c];
+            uint8_t* out = outChannels[c] + y * rowStep;
+            if (type != TensorType::UInt8) {
+                // Simple contiguous loops are used so that the compiler can vectorise them
+                const float channelScale = scale[c];
+                const float channelOffset = offset[c];
+                for (uint32_t x = 0; x < width; ++x) {
+                    source[x] = std::min(std::max(source[x], 0.0f), 255.0f) * channelScale + channelOffset;
+                }
+                const uint8_t* values = reinterpret_cast<const uint8_t*>(source);
+                size_t elementSize = sizeof(float);
+                if (type == TensorType::Float16) {
+                    floatToHalf(source, halfData.data(), width);
+                    values = reinterpret_cast<const uint8_t*>(halfData.data());
+                    elementSize = sizeof(uint16_t);
+                }
+                if (pixelStep == elementSize) {
+                    memcpy(out, values, static_cast<size_t>(width) * elementSize);
+                } else {
+                    for (uint32_t x = 0; x < width; ++x) {
+                        memcpy(out + x * pixelStep, values + x * elementSize, elementSize);
+                    }
+                }
+            } else {
+                if (normalise) {
+                    const float channelScale = scale[c] * 255.0f;
+                    const float channelOffset = offset[c] * 255.0f;
+                    for (uint32_t x = 0; x < width; ++x) {
+                        source[x] = std::min(std::max(source[x], 0.0f), 255.0f) * channelScale + channelOffset;
+                    }
+                }
+                // Round to nearest to match the CUDA conversion
+                for (uint32_t x = 0; x < width; ++x) {
+                    out[x * pixelStep] = static_cast<uint8_t>(std::min(std::max(source[x], 0.0f), 255.0f) + 0.5f);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+void Convert::floatToHalf(const float* const source, uint16_t* const dest, const uint32_t count) noexcept
+{
+    uint32_t x = 0;
+#if FFFR_F16C
+    if (hasF16C()) {
+        x = floatToHalfF16C(source, dest, count);
+    }
+#endif
+    for (; x < count; ++x) {
+        dest[x] = floatToHalf(source[x]);
+    }
+}
+
+uint16_t Convert::floatToHalf(const float value) noexcept
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(float));
+    const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000U);
+    const uint32_t exponent = (bits >> 23) & 0xFFU;
+    uint32_t mantissa = bits & 0x7FFFFFU;
+    if (exponent == 0xFFU) {
+        // Infinity or NaN
+        return static_cast<uint16_t>(sign | 0x7C00U | (mantissa != 0 ? 0x200U : 0U));
+    }
+    const int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+    if (halfExponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7C00U);
+    }
+    if (halfExponent <= 0) {
+        // Denormal or zero
+        if (halfExponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000U;
+        const uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+        uint32_t half = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1U << shift) - 1);
+        const uint32_t midpoint = 1U << (shift - 1);
+        if (remainder > midpoint || (remainder == midpoint && (half & 1U))) {
+            ++half;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+    // Round to nearest even, any carry correctly increments the exponent
+    uint32_t half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+    const uint32_t remainder = mantissa & 0x1FFFU;
+    if (remainder > 0x1000U || (remainder == 0x1000U && (half & 1U))) {
+        ++half;
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+#if FFFR_F16C
+bool Convert::hasF16C() noexcept
+{
+#    if defined(_MSC_VER)
+    static const bool s_supported = [] {
+        int32_t info[4];
+        __cpuid(info, 1);
+        // Requires both AVX (for the 256bit registers) and F16C
+        if ((info[2] & (1 << 28)) == 0 || (info[2] & (1 << 29)) == 0) {
+            return false;
+        }
+        // The OS must also save the AVX register state (OSXSAVE set and XMM/YMM enabled in XCR0)
+        return (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+    }();
+#    else
+    static const bool s_supported = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+#    endif
+    return s_supported;
+}
+
+#    if !defined(_MSC_VER)
+__attribute__((target("avx,f16c")))
+#    endif
+uint32_t Convert::floatToHalfF16C(const float* const source, uint16_t* const dest, const uint32_t count) noexcept
+{
+    uint32_t x = 0;
+    for (; x + 8 <= count; x += 8) {
+        const __m256 values = _mm256_loadu_ps(source + x);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x), _mm256_cvtps_ph(values, _MM_FROUND_TO_NEAREST_INT));
+    }
+    return x;
+}
+#endif
+
+bool Convert::readRow(const Frame& frame, const uint32_t row, float* channels[3], const bool toRGB) noexcept
+{
+    const auto width = frame.getWidth();
+    const auto format = frame.getPixelFormat();
+    const auto data1 = frame.getFrameData(0);
+    const uint8_t* luma = data1.first + static_cast<size_t>(row) * data1.second;
+    bool yuv = true;
+    switch (format) {
+        case PixelFormat::YUV420P:
+        case PixelFormat::YUV422P:
+        case PixelFormat::YUV444P: {
+            // This doesn't perform any chroma interpolation, each chroma sample is used for the entire chroma block
+            const uint32_t shiftX = format == PixelFormat::YUV444P ? 0 : 1;
+            const uint32_t chromaRow = format == PixelFormat::YUV420P ? row >> 1 : row;
+            const auto data2 = frame.getFrameData(1);
+            const auto data3 = frame.getFrameData(2);
+            const uint8_t* chromaCb = data2.first + static_cast<size_t>(chromaRow) * data2.second;
+            const uint8_t* chromaCr = data3.first + static_cast<size_t>(chromaRow) * data3.second;
+            for (uint32_t x = 0; x < width; ++x) {
+                channels[0][x] = luma[x];
+                channels[1][x] = chromaCb[x >> shiftX];
+                channels[2][x] = chromaCr[x >> shiftX];
+            }
+            break;
+        }
+        case PixelFormat::YUV420P10:
+        case PixelFormat::YUV422P10:
+        case PixelFormat::YUV444P16: {
+            // High bit depth values are scaled to the same range as 8-bit values without losing precision
+            const float scale = format == PixelFormat::YUV444P16 ? 255.0f / 65535.0f : 255.0f / 1023.0f;
+            const uint32_t shiftX = format == PixelFormat::YUV444P16 ? 0 : 1;
+            const uint32_t chromaRow = format == PixelFormat::YUV420P10 ? row >> 1 : row;
+            const auto data2 = frame.getFrameData(1);
+            const auto data3 = frame.getFrameData(2);
+            const auto* luma16 = reinterpret_cast<const uint16_t*>(luma);
+            const auto* chromaCb =
+                reinterpret_cast<const uint16_t*>(data2.first + static_cast<size_t>(chromaRow) * data2.second);
+            const auto* chromaCr =
+                reinterpret_cast<const uint16_t*>(data3.first + static_cast<size_t>(chromaRow) * data3.second);
+            for (uint32_t x = 0; x < width; ++x) {
+                channels[0][x] = luma16[x] * scale;
+                channels[1][x] = chromaCb[x >> shiftX] * scale;
+                channels[2][x] = chromaCr[x >> shiftX] * scale;
+            }
+            break;
+        }
+        case PixelFormat::P010: {
+            // Values are stored in the high bits so can be treated as 16-bit
+            constexpr float scale = 255.0f / 65535.0f;
+            const auto data2 = frame.getFrameData(1);
+            const auto* luma16 = reinterpret_cast<const uint16_t*>(luma);
+            const auto* chroma =
+                reinterpret_cast<const uint16_t*>(data2.first + static_cast<size_t>(row >> 1) * data2.second);
+            for (uint32_t x = 0; x < width; ++x) {
+                const uint32_t chromaOffset = x & ~1U;
+                channels[0][x] = luma16[x] * scale;
+                channels[1][x] = chroma[chromaOffset] * scale;
+                channels[2][x] = chroma[chromaOffset + 1] * scale;
+            }
+            break;
+        }
+        case PixelFormat::NV12: {
+            const auto data2 = frame.getFrameData(1);
+            const uint8_t* chroma = data2.first + static_cast<size_t>(row >> 1) * data2.second;
+            for (uint32_t x = 0; x < width; ++x) {
+                const uint32_t chromaOffset = x & ~1U;
+                channels[0][x] = luma[x];
+                channels[1][x] = chroma[chromaOffset];
+                channels[2][x] = chroma[chromaOffset + 1];
+            }
+            break;
+        }
+        case PixelFormat::RGB8: {
+            for (uint32_t x = 0; x < width; ++x) {
+                channels[0][x] = luma[x * 3];
+                channels[1][x] = luma[x * 3 + 1];
+                channels[2][x] = luma[x * 3 + 2];
+            }
+            yuv = false;
+            break;
+        }
+        case PixelFormat::RGB48: {
+            constexpr float scale = 255.0f / 65535.0f;
+            const auto* source = reinterpret_cast<const uint16_t*>(luma);
+            for (uint32_t x = 0; x < width; ++x) {
+                channels[0][x] = source[x * 3] * scale;
+                channels[1][x] = source[x * 3 + 1] * scale;
+                channels[2][x] = source[x * 3 + 2] * scale;
+            }
+            yuv = false;
+            break;
+        }
+        case PixelFormat::RGB8P: {
+            for (uint32_t c = 0; c < 3; ++c) {
+                const auto data = frame.getFrameData(c);
+                const uint8_t* source = data.first + static_cast<size_t>(row) * data.second;
+                for (uint32_t x = 0; x < width; ++x) {
+                    channels[c][x] = source[x];
+                }
+            }
+            yuv = false;
+            break;
+        }
+        case PixelFormat::RGB32FP: {
+            for (uint32_t c = 0; c < 3; ++c) {
+                const auto data = frame.getFrameData(c);
+                const float* source =
+                    reinterpret_cast<const float*>(data.first + static_cast<size_t>(row) * data.second);
+                for (uint32_t x = 0; x < width; ++x) {
+                    channels[c][x] = source[x] * 255.0f;
+                }
+            }
+            yuv = false;
+            break;
+        }
+        case PixelFormat::GRAY8:
+        case PixelFormat::GRAY32F: {
+            // Grey is treated as YUV with neutral chroma
+            const float* lumaFloat = reinterpret_cast<const float*>(luma);
+            for (uint32_t x = 0; x < width; ++x) {
+                channels[0][x] = format == PixelFormat::GRAY8 ? luma[x] : lumaFloat[x] * 255.0f;
+                channels[1][x] = 128.0f;
+                channels[2][x] = 128.0f;
+            }
+            break;
+        }
+        default:
+            return false;
+    }
+
+    if (yuv && toRGB) {
+        for (uint32_t x = 0; x < width; ++x) {
+            // Convert to RGB using BT601
+            const float lumaY = channels[0][x];
+            const float chromaU = channels[1][x] - 128.0f;
+            const float chromaV = channels[2][x] - 128.0f;
+            channels[0][x] = lumaY + 1.13983f * chromaV;
+            channels[1][x] = lumaY - 0.39465f * chromaU - 0.58060f * chromaV;
+            channels[2][x] = lumaY + 2.03211f * chromaU;
+        }
+    }
+    return true;
+}
+} // namespace Ffr
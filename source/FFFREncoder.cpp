@@ -16,16 +16,25 @@
 #include "FFFREncoder.h"
 
 #include "FFFRFilter.h"
+#include "FFFRQueue.h"
+#include "FFFRScaler.h"
 #include "FFFRStreamUtils.h"
 #include "FFFRUtility.h"
 #include "FFFrameReader.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
 
 extern "C" {
 #include <libavfilter/avfilter.h>
 #include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
 #include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
 }
 
 using namespace std;
@@ -40,6 +49,9 @@ AVCodecID getCodecID(const EncodeType encoder) noexcept
         case EncodeType::h265: {
             return AV_CODEC_ID_H265;
         }
+        case EncodeType::ffv1: {
+            return AV_CODEC_ID_FFV1;
+        }
         default: {
             return AV_CODEC_ID_NONE;
         }
@@ -88,6 +100,9 @@ string getPresetString(const EncoderOptions::Preset preset) noexcept
 bool Encoder::encodeStream(
     const std::string& fileName, const std::shared_ptr<Stream>& stream, const EncoderOptions& options) noexcept
 {
+    if (options.m_segments != 1) {
+        return encodeStreamSegmented(fileName, stream, options);
+    }
     // Create the new encoder
     const shared_ptr<Encoder> encoder = make_shared<Encoder>(fileName, stream->getWidth(), stream->getHeight(),
         getRational(StreamUtils::getSampleAspectRatio(stream.get())), stream->getPixelFormat(),
@@ -95,18 +110,529 @@ bool Encoder::encodeStream(
         stream->getDuration() -
             (stream->m_lastDecodedTimeStamp != INT64_MIN ? stream->timeStampToTime2(stream->m_lastDecodedTimeStamp) :
                                                            0),
-        options.m_type, options.m_quality, options.m_preset, options.m_numThreads, options.m_gopSize,
-        ConstructorLock());
+        options, ConstructorLock());
     if (!encoder->isEncoderValid()) {
         // Encoder creation failed
         return false;
     }
-    return encoder->encodeStream(stream);
+    return options.m_pipelined ? encoder->encodeStreamPipelined(stream) : encoder->encodeStream(stream);
+}
+
+bool Encoder::encodeStream(const std::vector<EncoderOutput>& outputs, const std::shared_ptr<Stream>& stream) noexcept
+{
+    if (outputs.empty()) {
+        logInternal(LogLevel::Error, "No encoder outputs specified");
+        return false;
+    }
+    const AVRational aspect = StreamUtils::getSampleAspectRatio(stream.get());
+    const int64_t duration = stream->getDuration() -
+        (stream->m_lastDecodedTimeStamp != INT64_MIN ? stream->timeStampToTime2(stream->m_lastDecodedTimeStamp) : 0);
+
+    // Create an encoder for each output along with any scaler required to convert to the output resolution
+    vector<shared_ptr<Encoder>> encoders;
+    vector<shared_ptr<Scaler>> scalers;
+    vector<unique_ptr<Queue<shared_ptr<Frame>>>> queues;
+    try {
+        for (const auto& i : outputs) {
+            shared_ptr<Scaler> scaler = nullptr;
+            uint32_t width = stream->getWidth();
+            uint32_t height = stream->getHeight();
+            AVRational outAspect = aspect;
+            if ((i.m_scale.m_width != 0 && i.m_scale.m_width != width) ||
+                (i.m_scale.m_height != 0 && i.m_scale.m_height != height)) {
+                scaler = make_shared<Scaler>(width, height, getPixelFormat(stream->getPixelFormat()), i.m_scale,
+                    PixelFormat::Auto, i.m_scaleAlgorithm, nullptr);
+                if (scaler->getPixelFormat() == AV_PIX_FMT_NONE) {
+                    logInternal(LogLevel::Error, "Failed to create scaler for output: ", i.m_fileName);
+                    return false;
+                }
+                width = scaler->getWidth();
+                height = scaler->getHeight();
+                outAspect = scaler->getSampleAspectRatio(aspect);
+            }
+            auto encoder = make_shared<Encoder>(i.m_fileName, width, height, getRational(outAspect),
+                stream->getPixelFormat(), getRational(StreamUtils::getFrameRate(stream.get())), duration,
+                i.m_options, ConstructorLock());
+            if (!encoder->isEncoderValid()) {
+                // Encoder creation failed
+                return false;
+            }
+            encoders.emplace_back(move(encoder));
+            scalers.emplace_back(move(scaler));
+            queues.emplace_back(make_unique<Queue<shared_ptr<Frame>>>(s_frameQueueLength));
+        }
+    } catch (...) {
+        logInternal(LogLevel::Error, "Failed to allocate encoder outputs");
+        return false;
+    }
+
+    atomic<bool> abort(false);
+    vector<uint8_t> results(outputs.size(), 1);
+    const auto stop = [&]() noexcept {
+        abort = true;
+        for (auto& i : queues) {
+            i->close(true);
+        }
+    };
+    const auto encodeStage = [&](const size_t output) noexcept {
+        const auto& encoder = encoders[output];
+        shared_ptr<Frame> frame;
+        const auto encodeFrame = [&]() noexcept {
+            // Each output references the shared frame so that its properties can be changed independently
+            FramePtr newFrame(av_frame_alloc());
+            if (*newFrame == nullptr) {
+                logInternal(LogLevel::Error, "Failed to allocate new frame");
+                return false;
+            }
+            const auto ret = av_frame_ref(*newFrame, *frame->m_frame);
+            if (ret < 0) {
+                logInternal(LogLevel::Error, "Failed to reference frame: ", getFfmpegErrorString(ret));
+                return false;
+            }
+            if (scalers[output] != nullptr) {
+                if (newFrame->hw_frames_ctx != nullptr) {
+                    logInternal(LogLevel::Error, "Scaled encoder outputs require frames in host memory");
+                    return false;
+                }
+                if (!scalers[output]->scaleFrame(newFrame)) {
+                    return false;
+                }
+            }
+            newFrame->pts = av_rescale_q(frame->m_frame->best_effort_timestamp, stream->m_codecContext->time_base,
+                encoder->m_codecContext->time_base);
+            return encoder->sendFrame(*newFrame, nullptr);
+        };
+        while (queues[output]->pop(frame)) {
+            if (!encodeFrame()) {
+                results[output] = 0;
+                stop();
+                return;
+            }
+            frame = nullptr;
+        }
+        // Only flush once all frames have been successfully decoded
+        if (!abort && (!encoder->sendFrame(nullptr, nullptr) || !encoder->writeTrailer())) {
+            results[output] = 0;
+        }
+    };
+
+    vector<thread> threads;
+    try {
+        threads.reserve(outputs.size());
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            threads.emplace_back(encodeStage, i);
+        }
+    } catch (...) {
+        logInternal(LogLevel::Error, "Failed to create encoding threads");
+        stop();
+        for (auto& i : threads) {
+            i.join();
+        }
+        return false;
+    }
+
+    // Decode on the calling thread and share each frame with every output
+    bool decodeValid = true;
+    while (!abort) {
+        auto frame = stream->getNextFrame();
+        if (frame == nullptr) {
+            decodeValid = stream->isEndOfFile();
+            break;
+        }
+        for (auto& i : queues) {
+            if (!i->push(frame)) {
+                // An output has failed
+                break;
+            }
+        }
+    }
+    if (decodeValid) {
+        for (auto& i : queues) {
+            i->close();
+        }
+    } else {
+        stop();
+    }
+    for (auto& i : threads) {
+        i.join();
+    }
+    return decodeValid && !abort &&
+        std::all_of(results.begin(), results.end(), [](const uint8_t result) { return result != 0; });
+}
+
+bool Encoder::cacheStream(
+    const std::string& fileName, const std::shared_ptr<Stream>& stream, const uint32_t numThreads) noexcept
+{
+    // Every frame is encoded as a key frame so that the muxer indexes each one
+    EncoderOptions options;
+    options.m_type = EncodeType::ffv1;
+    options.m_gopSize = 1;
+    options.m_numThreads = numThreads;
+    return encodeStream(fileName, stream, options);
+}
+
+bool Encoder::copyStream(const std::string& fileName, const std::shared_ptr<Stream>& stream, const int64_t startTime,
+    const int64_t endTime, const EncoderOptions& options) noexcept
+{
+    if (startTime < 0 || endTime <= startTime) {
+        logInternal(LogLevel::Error, "Invalid stream copy range: ", startTime, ", ", endTime);
+        return false;
+    }
+
+    // Open a separate demuxer so that the copy does not affect any existing decode position
+    const FormatContextPtr inFormat = openSource(stream);
+    if (inFormat.get() == nullptr) {
+        return false;
+    }
+    const int32_t index = stream->m_index;
+    const AVStream* const inStream = inFormat->streams[index];
+    const Encoder output(openCopyOutput(fileName, inStream, false, options), CodecContextPtr(), ConstructorLock());
+    if (output.m_formatContext.get() == nullptr) {
+        return false;
+    }
+    const AVStream* const outStream = output.m_formatContext->streams[0];
+
+    // Seek to the key frame at or before the start time
+    const int64_t startTimeStamp = stream->timeToTimeStamp(startTime);
+    const int64_t endTimeStamp = endTime == INT64_MAX ? INT64_MAX : stream->timeToTimeStamp(endTime);
+    if (startTime > 0) {
+        const auto ret = av_seek_frame(inFormat.get(), index, startTimeStamp, AVSEEK_FLAG_BACKWARD);
+        if (ret < 0) {
+            logInternal(LogLevel::Error, "Failed to seek to start of copy: ", getFfmpegErrorString(ret));
+            return false;
+        }
+    }
+
+    PacketPtr packet(av_packet_alloc());
+    if (packet == nullptr) {
+        logInternal(LogLevel::Error, "Failed to allocate packet");
+        return false;
+    }
+    int64_t offset = AV_NOPTS_VALUE;
+    while (true) {
+        const auto ret = av_read_frame(inFormat.get(), packet.get());
+        if (ret == AVERROR_EOF) {
+            break;
+        } else if (ret < 0) {
+            logInternal(LogLevel::Error, "Failed to retrieve new frame: ", getFfmpegErrorString(ret));
+            return false;
+        }
+        if (packet->stream_index != index) {
+            av_packet_unref(packet.get());
+            continue;
+        }
+        const int64_t decodeStamp = packet->dts != AV_NOPTS_VALUE ? packet->dts : packet->pts;
+        if (offset == AV_NOPTS_VALUE) {
+            // The output must start on a key frame so that it can be decoded
+            if (!(packet->flags & AV_PKT_FLAG_KEY) || decodeStamp == AV_NOPTS_VALUE) {
+                av_packet_unref(packet.get());
+                continue;
+            }
+            offset = decodeStamp;
+        }
+        // Decode time stamps are monotonic and never exceed presentation time stamps, so stopping on the first packet
+        // decoded at or after the end keeps every frame displayed before it along with any frames it references
+        if (decodeStamp != AV_NOPTS_VALUE && decodeStamp >= endTimeStamp) {
+            av_packet_unref(packet.get());
+            break;
+        }
+
+        // Rebase time stamps so that the output starts at zero
+        if (packet->pts != AV_NOPTS_VALUE) {
+            packet->pts -= offset;
+        }
+        if (packet->dts != AV_NOPTS_VALUE) {
+            packet->dts -= offset;
+        }
+        av_packet_rescale_ts(packet.get(), inStream->time_base, outStream->time_base);
+        packet->stream_index = 0;
+        packet->pos = -1;
+        if (!output.writePacket(packet.get())) {
+            return false;
+        }
+    }
+    if (offset == AV_NOPTS_VALUE) {
+        logInternal(LogLevel::Error, "No key frame found within copy range: ", startTime, ", ", endTime);
+        return false;
+    }
+    return output.writeTrailer();
+}
+
+bool Encoder::copyStreamFrames(const std::string& fileName, const std::shared_ptr<Stream>& stream,
+    const int64_t startFrame, const int64_t endFrame, const EncoderOptions& options) noexcept
+{
+    return copyStream(fileName, stream, stream->frameToTime(startFrame), stream->frameToTime(endFrame), options);
+}
+
+bool Encoder::cutStream(const std::string& fileName, const std::shared_ptr<Stream>& stream, const int64_t startTime,
+    const int64_t endTime, const EncoderOptions& options) noexcept
+{
+    if (startTime < 0 || endTime <= startTime) {
+        logInternal(LogLevel::Error, "Invalid stream cut range: ", startTime, ", ", endTime);
+        return false;
+    }
+    EncodeType type;
+    if (stream->m_codecContext->codec_id == AV_CODEC_ID_H264) {
+        type = EncodeType::h264;
+    } else if (stream->m_codecContext->codec_id == AV_CODEC_ID_HEVC) {
+        type = EncodeType::h265;
+    } else {
+        logInternal(LogLevel::Error, "Frame accurate cuts are only supported for H.264 and H.265 streams");
+        return false;
+    }
+
+    // Find the key frames that bound the groups of pictures that can be copied
+    const auto packets = stream->scanPackets();
+    if (packets.empty()) {
+        logInternal(LogLevel::Error, "Failed to find any packets in stream");
+        return false;
+    }
+    int64_t firstKey = INT64_MAX;
+    int64_t lastKey = INT64_MIN;
+    int64_t delay = 0;
+    for (const auto& i : packets) {
+        if (i.m_timeStamp == INT64_MIN) {
+            continue;
+        }
+        if (i.m_decodeTimeStamp != INT64_MIN) {
+            delay = std::max(delay, i.m_timeStamp - i.m_decodeTimeStamp);
+        }
+        if (i.m_keyFrame && i.m_timeStamp >= startTime && i.m_timeStamp <= endTime) {
+            firstKey = std::min(firstKey, i.m_timeStamp);
+            lastKey = std::max(lastKey, i.m_timeStamp);
+        }
+    }
+    // Any range continuing past the last frame can be copied through to the end of the stream
+    const bool toEnd = endTime >= stream->getDuration();
+    int64_t copyEnd = toEnd ? INT64_MAX : lastKey;
+    int64_t tailStart = copyEnd;
+    if (firstKey == INT64_MAX) {
+        // No complete group of pictures so the entire range must be re-encoded
+        firstKey = endTime;
+        copyEnd = endTime;
+        tailStart = endTime;
+    } else if (!toEnd) {
+        // Leading pictures of the key frame that ends the copy are decoded after it (and may reference it) so they
+        // cannot be copied. Re-encoding must instead start from the first of them.
+        auto i = std::find_if(packets.begin(), packets.end(),
+            [&](const PacketInfo& packet) { return packet.m_keyFrame && packet.m_timeStamp == lastKey; });
+        if (i != packets.end()) {
+            for (++i; i != packets.end(); ++i) {
+                if (i->m_timeStamp == INT64_MIN) {
+                    continue;
+                }
+                if (i->m_timeStamp >= lastKey) {
+                    break;
+                }
+                tailStart = std::min(tailStart, i->m_timeStamp);
+            }
+        }
+        if (tailStart <= firstKey) {
+            // Nothing remains that can be copied
+            copyEnd = firstKey;
+            tailStart = firstKey;
+        }
+    }
+
+    const FormatContextPtr inFormat = openSource(stream);
+    if (inFormat.get() == nullptr) {
+        return false;
+    }
+    const AVStream* const inStream = inFormat->streams[stream->m_index];
+    // Both copied and re-encoded packets carry their own codec headers so that each section uses the correct ones
+    const OutputFormatContextPtr outFormat = openCopyOutput(fileName, inStream, true, options);
+    if (outFormat.get() == nullptr) {
+        return false;
+    }
+    const Encoder output(outFormat, CodecContextPtr(), ConstructorLock());
+
+    // Re-encoded frames have no reordering. Delaying the decode time stamps of the leading section by the sources
+    // maximum reordering keeps them before those of the first copied packets, while every packet copied before the
+    // trailing section is presented (and therefore decoded) before it starts.
+    const int64_t outDelay = av_rescale_q(delay, av_make_q(1, AV_TIME_BASE), outFormat->streams[0]->time_base);
+    const auto encodeSection = [&](const int64_t sectionStart, const int64_t sectionEnd,
+                                   const int64_t decodeDelay) noexcept {
+        if (sectionStart >= sectionEnd) {
+            return true;
+        }
+        const auto source = Stream::getStream(inFormat->url);
+        if (source == nullptr) {
+            return false;
+        }
+        Encoder encoder(outFormat,
+            createCodec(source->getWidth(), source->getHeight(),
+                getRational(StreamUtils::getSampleAspectRatio(source.get())), source->getPixelFormat(),
+                getRational(StreamUtils::getFrameRate(source.get())), type, options.m_quality, options.m_preset,
+                options.m_numThreads, 0, false, false),
+            ConstructorLock());
+        if (!encoder.isEncoderValid()) {
+            return false;
+        }
+        encoder.m_decodeDelay = decodeDelay;
+        return encoder.encodeRange(source, sectionStart, sectionEnd, startTime);
+    };
+
+    if (!encodeSection(startTime, firstKey, outDelay)) {
+        return false;
+    }
+    if (firstKey < copyEnd &&
+        !output.copyPictureGroups(inFormat, stream, stream->timeToTimeStamp(firstKey),
+            copyEnd == INT64_MAX ? INT64_MAX : stream->timeToTimeStamp(copyEnd), stream->timeToTimeStamp(startTime))) {
+        return false;
+    }
+    if (!toEnd && !encodeSection(tailStart, endTime, 0)) {
+        return false;
+    }
+    return output.writeTrailer();
+}
+
+bool Encoder::cutStreamFrames(const std::string& fileName, const std::shared_ptr<Stream>& stream,
+    const int64_t startFrame, const int64_t endFrame, const EncoderOptions& options) noexcept
+{
+    return cutStream(fileName, stream, stream->frameToTime(startFrame), stream->frameToTime(endFrame), options);
+}
+
+shared_ptr<Encoder> Encoder::getEncoder(const std::string& fileName, const uint32_t width, const uint32_t height,
+    const PixelFormat format, const Rational frameRate, const EncoderOptions& options, const Rational aspect) noexcept
+{
+    // The duration is unknown so no hint is given to the muxer
+    const shared_ptr<Encoder> encoder =
+        make_shared<Encoder>(fileName, width, height, aspect, format, frameRate, 0, options, ConstructorLock());
+    if (!encoder->isEncoderValid()) {
+        // Encoder creation failed
+        return nullptr;
+    }
+    try {
+        encoder->m_pushedFrames = make_unique<Queue<shared_ptr<Frame>>>(s_pushQueueLength);
+        encoder->m_pushThread = thread(&Encoder::runPushed, encoder.get());
+    } catch (...) {
+        logInternal(LogLevel::Error, "Failed to create encoding thread");
+        return nullptr;
+    }
+    return encoder;
+}
+
+Encoder::~Encoder() noexcept
+{
+    finish();
+}
+
+bool Encoder::pushFrame(const Frame& frame) noexcept
+{
+    if (m_pushedFrames == nullptr) {
+        logInternal(LogLevel::Error, "Frames can only be pushed to encoders created with getEncoder");
+        return false;
+    }
+    const AVFrame* source = *frame.m_frame;
+    if (source == nullptr || source->hw_frames_ctx != nullptr || source->format != m_codecContext->pix_fmt ||
+        source->width != m_codecContext->width || source->height != m_codecContext->height) {
+        logInternal(LogLevel::Error, "Pushed frame does not match the encoders format");
+        return false;
+    }
+    FramePtr newFrame(av_frame_alloc());
+    if (*newFrame == nullptr) {
+        logInternal(LogLevel::Error, "Failed to allocate new frame");
+        return false;
+    }
+    const auto ret = av_frame_ref(*newFrame, source);
+    if (ret < 0) {
+        logInternal(LogLevel::Error, "Failed to reference pushed frame: ", getFfmpegErrorString(ret));
+        return false;
+    }
+    shared_ptr<Frame> pushed = make_shared<Frame>(
+        newFrame, frame.getTimeStamp(), frame.getFrameNumber(), FormatContextPtr(), CodecContextPtr());
+    return m_pushedFrames->push(move(pushed)) && m_pushValid;
+}
+
+bool Encoder::pushRaw(const uint8_t* const planes[], const int32_t strides[], const uint32_t numPlanes,
+    const int64_t timeStamp) noexcept
+{
+    if (m_pushedFrames == nullptr) {
+        logInternal(LogLevel::Error, "Frames can only be pushed to encoders created with getEncoder");
+        return false;
+    }
+    const auto formatPlanes = av_pix_fmt_count_planes(m_codecContext->pix_fmt);
+    if (formatPlanes <= 0 || formatPlanes > 4 || numPlanes != static_cast<uint32_t>(formatPlanes)) {
+        logInternal(LogLevel::Error, "Raw image plane count does not match the encoders format: ", numPlanes);
+        return false;
+    }
+    int32_t lineSizes[4] = {0, 0, 0, 0};
+    av_image_fill_linesizes(lineSizes, m_codecContext->pix_fmt, m_codecContext->width);
+    for (uint32_t i = 0; i < numPlanes; ++i) {
+        if (planes[i] == nullptr || abs(strides[i]) < lineSizes[i]) {
+            logInternal(LogLevel::Error, "Invalid raw image plane: ", i);
+            return false;
+        }
+    }
+    FramePtr newFrame(av_frame_alloc());
+    if (*newFrame == nullptr) {
+        logInternal(LogLevel::Error, "Failed to allocate new frame");
+        return false;
+    }
+    newFrame->format = m_codecContext->pix_fmt;
+    newFrame->width = m_codecContext->width;
+    newFrame->height = m_codecContext->height;
+    auto ret = av_frame_get_buffer(*newFrame, 0);
+    if (ret < 0) {
+        logInternal(LogLevel::Error, "Failed to allocate frame memory: ", getFfmpegErrorString(ret));
+        return false;
+    }
+    const uint8_t* sourceData[4] = {nullptr, nullptr, nullptr, nullptr};
+    int32_t sourceLineSizes[4] = {0, 0, 0, 0};
+    for (uint32_t i = 0; i < numPlanes; ++i) {
+        sourceData[i] = planes[i];
+        sourceLineSizes[i] = strides[i];
+    }
+    av_image_copy(newFrame->data, newFrame->linesize, sourceData, sourceLineSizes, m_codecContext->pix_fmt,
+        m_codecContext->width, m_codecContext->height);
+    shared_ptr<Frame> pushed = make_shared<Frame>(newFrame, timeStamp, 0, FormatContextPtr(), CodecContextPtr());
+    return m_pushedFrames->push(move(pushed)) && m_pushValid;
+}
+
+bool Encoder::finish() noexcept
+{
+    lock_guard<mutex> lock(m_finishMutex);
+    if (m_pushedFrames == nullptr) {
+        return false;
+    }
+    m_pushedFrames->close();
+    if (m_pushThread.joinable()) {
+        m_pushThread.join();
+    }
+    return m_pushValid;
+}
+
+void Encoder::runPushed() noexcept
+{
+    shared_ptr<Frame> frame;
+    while (m_pushedFrames->pop(frame)) {
+        frame->m_frame->pts =
+            av_rescale_q(frame->getTimeStamp(), av_make_q(1, AV_TIME_BASE), m_codecContext->time_base);
+        if (!sendFrame(*frame->m_frame, nullptr)) {
+            // Stop accepting new frames, any already queued are discarded
+            m_pushValid = false;
+            m_pushedFrames->close(true);
+            return;
+        }
+        frame = nullptr;
+    }
+    if (!sendFrame(nullptr, nullptr) || !writeTrailer()) {
+        m_pushValid = false;
+    }
+}
+
+void Encoder::PacketDeleter::operator()(AVPacket* packet) const noexcept
+{
+    av_packet_free(&packet);
+}
+
+void Encoder::BitStreamFilterDeleter::operator()(AVBSFContext* filter) const noexcept
+{
+    av_bsf_free(&filter);
 }
 
 Encoder::Encoder(const std::string& fileName, const uint32_t width, const uint32_t height, const Rational aspect,
-    const PixelFormat format, const Rational frameRate, const int64_t duration, const EncodeType codecType,
-    const uint8_t quality, const EncoderOptions::Preset preset, const uint32_t numThreads, const uint32_t gopSize,
+    const PixelFormat format, const Rational frameRate, const int64_t duration, const EncoderOptions& options,
     ConstructorLock) noexcept
 {
     AVFormatContext* formatPtr = nullptr;
@@ -122,40 +648,102 @@ Encoder::Encoder(const std::string& fileName, const uint32_t width, const uint32
         return;
     }
 
+    CodecContextPtr tempCodec = createCodec(width, height, aspect, format, frameRate, options.m_type,
+        options.m_quality, options.m_preset, options.m_numThreads, options.m_gopSize,
+        tempFormat->oformat->flags & AVFMT_GLOBALHEADER, true);
+    if (tempCodec.get() == nullptr) {
+        return;
+    }
+    ret = avcodec_parameters_from_context(outStream->codecpar, tempCodec.get());
+    if (ret < 0) {
+        logInternal(LogLevel::Error, "Failed copying parameters to encoder context: ", getFfmpegErrorString(ret));
+        return;
+    }
+
+    // Set the output stream timebase
+    outStream->time_base = tempCodec->time_base;
+    outStream->r_frame_rate = tempCodec->framerate;
+    outStream->avg_frame_rate = tempCodec->framerate;
+
+    // Open the output and write out file header
+    if (!openOutput(tempFormat, fileName, options)) {
+        return;
+    }
+
+    // Give muxer hint about duration
+    outStream->duration = av_rescale_q(duration, av_make_q(1, AV_TIME_BASE), outStream->time_base);
+    tempFormat->duration = outStream->duration;
+
+    // Make the new encoder
+    m_formatContext = move(tempFormat);
+    m_codecContext = move(tempCodec);
+}
+
+Encoder::Encoder(OutputFormatContextPtr formatContext, CodecContextPtr codecContext, ConstructorLock) noexcept
+    : m_formatContext(move(formatContext))
+    , m_codecContext(move(codecContext))
+{}
+
+CodecContextPtr Encoder::createCodec(const uint32_t width, const uint32_t height, const Rational aspect,
+    const PixelFormat format, const Rational frameRate, const EncodeType codecType, const uint8_t quality,
+    const EncoderOptions::Preset preset, const uint32_t numThreads, const uint32_t gopSize, const bool globalHeader,
+    const bool reorder) noexcept
+{
     // Find the required encoder
     const AVCodec* const encoder = avcodec_find_encoder(getCodecID(codecType));
     if (!encoder) {
         logInternal(LogLevel::Error, "Requested encoder is not supported");
-        return;
+        return CodecContextPtr();
     }
     CodecContextPtr tempCodec(avcodec_alloc_context3(encoder));
     if (tempCodec.get() == nullptr) {
         logInternal(LogLevel::Error, "Failed allocating encoder context");
-        return;
+        return CodecContextPtr();
+    }
+
+    // Check the encoder can accept the input format
+    const AVPixelFormat pixelFormat = getPixelFormat(format);
+    if (encoder->pix_fmts != nullptr) {
+        bool supported = false;
+        for (auto* i = encoder->pix_fmts; *i != AV_PIX_FMT_NONE; ++i) {
+            supported = supported || (*i == pixelFormat);
+        }
+        if (!supported) {
+            logInternal(LogLevel::Error, "Requested encoder does not support pixel format: ", pixelFormat);
+            return CodecContextPtr();
+        }
     }
 
     // Setup encoding parameters
     tempCodec->height = height;
     tempCodec->width = width;
     tempCodec->sample_aspect_ratio = {aspect.m_numerator, aspect.m_denominator};
-    tempCodec->pix_fmt = getPixelFormat(format);
+    tempCodec->pix_fmt = pixelFormat;
     tempCodec->framerate = {frameRate.m_numerator, frameRate.m_denominator};
     tempCodec->time_base = av_inv_q(tempCodec->framerate);
     av_opt_set_int(tempCodec.get(), "refcounted_frames", 1, 0);
 
-    if (tempFormat->oformat->flags & AVFMT_GLOBALHEADER) {
+    if (globalHeader) {
         tempCodec->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
     }
+    if (!reorder) {
+        tempCodec->max_b_frames = 0;
+    }
 
     // Setup the desired encoding options
     AVDictionary* opts = nullptr;
-    int32_t encoderCRF = 255 - quality;
-    encoderCRF = encoderCRF / (255 / 51);
-    // x264 allows crf from 0->51 where 23 is default
-    // x265 allows crf from 0->51 where 28 is default and should correspond to 23 in x264
-    // vp9 allows crf from 0->63 where 31 is default
-    av_dict_set(&opts, "crf", to_string(encoderCRF).c_str(), 0);
-    av_dict_set(&opts, "preset", getPresetString(preset).c_str(), 0);
+    if (codecType == EncodeType::ffv1) {
+        // ffv1 is lossless so has no quality settings, version 3 allows slices to be encoded/decoded in parallel
+        av_dict_set(&opts, "level", "3", 0);
+    } else {
+        int32_t encoderCRF = 255 - quality;
+        encoderCRF = encoderCRF / (255 / 51);
+        // x264 allows crf from 0->51 where 23 is default
+        // x265 allows crf from 0->51 where 28 is default and should correspond to 23 in x264
+        // vp9 allows crf from 0->63 where 31 is default
+        av_dict_set(&opts, "crf", to_string(encoderCRF).c_str(), 0);
+        av_dict_set(&opts, "preset", getPresetString(preset).c_str(), 0);
+    }
 
     if (numThreads != 0) {
         av_dict_set(&opts, "threads", to_string(numThreads).c_str(), 0);
@@ -179,46 +767,313 @@ Encoder::Encoder(const std::string& fileName, const uint32_t width, const uint32
     }
 
     // Open the encoder
-    ret = avcodec_open2(tempCodec.get(), encoder, &opts);
+    const auto ret = avcodec_open2(tempCodec.get(), encoder, &opts);
+    av_dict_free(&opts);
     if (ret < 0) {
         logInternal(LogLevel::Error, "Failed opening video encoder: ", getFfmpegErrorString(ret));
-        return;
+        return CodecContextPtr();
     }
-    ret = avcodec_parameters_from_context(outStream->codecpar, tempCodec.get());
+    return tempCodec;
+}
+
+FormatContextPtr Encoder::openSource(const std::shared_ptr<Stream>& stream) noexcept
+{
+    const string fileName = stream->m_formatContext->url;
+    AVFormatContext* formatPtr = nullptr;
+    auto ret = avformat_open_input(&formatPtr, fileName.c_str(), nullptr, nullptr);
+    FormatContextPtr tempFormat(formatPtr);
     if (ret < 0) {
-        logInternal(LogLevel::Error, "Failed copying parameters to encoder context: ", getFfmpegErrorString(ret));
-        return;
+        logInternal(LogLevel::Error, "Failed to open input stream: ", fileName, ", ", getFfmpegErrorString(ret));
+        return FormatContextPtr();
     }
+    ret = avformat_find_stream_info(tempFormat.get(), nullptr);
+    if (ret < 0) {
+        logInternal(LogLevel::Error, "Failed finding stream information: ", fileName, ", ", getFfmpegErrorString(ret));
+        return FormatContextPtr();
+    }
+    if (stream->m_index >= static_cast<int32_t>(tempFormat->nb_streams)) {
+        logInternal(LogLevel::Error, "Failed to find video stream in file: ", fileName);
+        return FormatContextPtr();
+    }
+    // Allow the demuxer to skip the data of all other streams
+    for (uint32_t i = 0; i < tempFormat->nb_streams; ++i) {
+        if (static_cast<int32_t>(i) != stream->m_index) {
+            tempFormat->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+    return tempFormat;
+}
 
-    // Set the output stream timebase
-    outStream->time_base = tempCodec->time_base;
-    outStream->r_frame_rate = tempCodec->framerate;
-    outStream->avg_frame_rate = tempCodec->framerate;
+OutputFormatContextPtr Encoder::openCopyOutput(const std::string& fileName, const AVStream* const inStream,
+    const bool inBandHeaders, const EncoderOptions& options) noexcept
+{
+    AVFormatContext* formatPtr = nullptr;
+    auto ret = avformat_alloc_output_context2(&formatPtr, nullptr, nullptr, fileName.c_str());
+    OutputFormatContextPtr tempFormat(formatPtr);
+    if (ret < 0) {
+        logInternal(LogLevel::Error, "Failed to open output stream ", getFfmpegErrorString(ret));
+        return OutputFormatContextPtr();
+    }
+    AVStream* const outStream = avformat_new_stream(tempFormat.get(), nullptr);
+    if (outStream == nullptr) {
+        logInternal(LogLevel::Error, "Failed to create an output stream");
+        return OutputFormatContextPtr();
+    }
+    ret = avcodec_parameters_copy(outStream->codecpar, inStream->codecpar);
+    if (ret < 0) {
+        logInternal(LogLevel::Error, "Failed copying stream parameters: ", getFfmpegErrorString(ret));
+        return OutputFormatContextPtr();
+    }
+    // The source codec tag may not be valid in the output container
+    outStream->codecpar->codec_tag = 0;
+    if (inBandHeaders) {
+        // The muxer instead creates any required global header from the first packet
+        av_freep(&outStream->codecpar->extradata);
+        outStream->codecpar->extradata_size = 0;
+        // The codec headers can change within the stream so they must be signalled as in-band where supported
+        const auto codecID = outStream->codecpar->codec_id;
+        uint32_t tag = 0;
+        if (codecID == AV_CODEC_ID_H264) {
+            tag = MKTAG('a', 'v', 'c', '3');
+        } else if (codecID == AV_CODEC_ID_HEVC) {
+            tag = MKTAG('h', 'e', 'v', '1');
+        }
+        if (tag != 0 && av_codec_get_id(tempFormat->oformat->codec_tag, tag) == codecID) {
+            outStream->codecpar->codec_tag = tag;
+        }
+    }
+    outStream->time_base = inStream->time_base;
+    outStream->r_frame_rate = inStream->r_frame_rate;
+    outStream->avg_frame_rate = inStream->avg_frame_rate;
+    outStream->sample_aspect_ratio = inStream->sample_aspect_ratio;
+
+    if (!openOutput(tempFormat, fileName, options)) {
+        return OutputFormatContextPtr();
+    }
+    return tempFormat;
+}
 
-    // Open output file if required
-    if (!(tempFormat->oformat->flags & AVFMT_NOFILE)) {
-        ret = avio_open(&tempFormat->pb, fileName.c_str(), AVIO_FLAG_WRITE);
+bool Encoder::openOutput(
+    const OutputFormatContextPtr& formatContext, const std::string& fileName, const EncoderOptions& options) noexcept
+{
+    int ret;
+    if (options.m_writer != nullptr) {
+        // Output is passed to the writer through a custom IO context that owns a copy of the writer
+        auto* writer = new (nothrow) OutputWriter(options.m_writer);
+        auto* buffer = static_cast<uint8_t*>(av_malloc(s_ioBufferSize));
+        AVIOContext* context = nullptr;
+        if (writer != nullptr && buffer != nullptr) {
+            context = avio_alloc_context(buffer, s_ioBufferSize, 1, writer, nullptr, writeOutput, nullptr);
+        }
+        if (context == nullptr) {
+            logInternal(LogLevel::Error, "Failed to allocate output writer");
+            av_free(buffer);
+            delete writer;
+            return false;
+        }
+        formatContext->pb = context;
+        formatContext->flags |= AVFMT_FLAG_CUSTOM_IO;
+    } else if (!(formatContext->oformat->flags & AVFMT_NOFILE)) {
+        ret = avio_open(&formatContext->pb, fileName.c_str(), AVIO_FLAG_WRITE);
         if (ret < 0) {
             logInternal(LogLevel::Error, "Failed to open output file: ", fileName, ", ", getFfmpegErrorString(ret));
-            return;
+            return false;
         }
     }
 
+    AVDictionary* opts = nullptr;
+    if (options.m_fragmented) {
+        // Each fragment has its own index so it can be used without waiting for the file trailer
+        av_dict_set(&opts, "movflags", "frag_keyframe+empty_moov+default_base_moof", 0);
+    }
+    if (options.m_fragmented || options.m_writer != nullptr) {
+        // Pass on data as soon as it is muxed instead of waiting for the IO buffer to fill
+        formatContext->flags |= AVFMT_FLAG_FLUSH_PACKETS;
+    }
+
     // Init the muxer and write out file header
-    ret = avformat_write_header(tempFormat.get(), nullptr);
+    ret = avformat_write_header(formatContext.get(), &opts);
+    av_dict_free(&opts);
     if (ret < 0) {
         logInternal(
             LogLevel::Error, "Failed writing header to output file: ", fileName, ", ", getFfmpegErrorString(ret));
-        return;
+        return false;
     }
+    return true;
+}
 
-    // Give muxer hint about duration
-    outStream->duration = av_rescale_q(duration, av_make_q(1, AV_TIME_BASE), outStream->time_base);
-    tempFormat->duration = outStream->duration;
+int Encoder::writeOutput(void* opaque, uint8_t* buffer, const int bufferSize) noexcept
+{
+    const auto& writer = *static_cast<OutputWriter*>(opaque);
+    try {
+        if (!writer(buffer, static_cast<size_t>(bufferSize))) {
+            return AVERROR_EXTERNAL;
+        }
+    } catch (...) {
+        return AVERROR_EXTERNAL;
+    }
+    return bufferSize;
+}
 
-    // Make the new encoder
-    m_formatContext = move(tempFormat);
-    m_codecContext = move(tempCodec);
+bool Encoder::copyPictureGroups(const FormatContextPtr& input, const std::shared_ptr<Stream>& stream,
+    const int64_t startTimeStamp, const int64_t endTimeStamp, const int64_t offset) const noexcept
+{
+    const int32_t index = stream->m_index;
+    const AVStream* const inStream = input->streams[index];
+    const AVStream* const outStream = m_formatContext->streams[0];
+
+    // Containers that store codec headers globally must have them inserted before each key frame
+    BitStreamFilterPtr filter;
+    if (inStream->codecpar->extradata_size > 0 && inStream->codecpar->extradata[0] == 1) {
+        const AVBitStreamFilter* const filterType = av_bsf_get_by_name(
+            inStream->codecpar->codec_id == AV_CODEC_ID_H264 ? "h264_mp4toannexb" : "hevc_mp4toannexb");
+        AVBSFContext* filterPtr = nullptr;
+        auto ret = filterType != nullptr ? av_bsf_alloc(filterType, &filterPtr) : AVERROR_BSF_NOT_FOUND;
+        filter.reset(filterPtr);
+        if (ret >= 0) {
+            ret = avcodec_parameters_copy(filter->par_in, inStream->codecpar);
+        }
+        if (ret >= 0) {
+            filter->time_base_in = inStream->time_base;
+            ret = av_bsf_init(filter.get());
+        }
+        if (ret < 0) {
+            logInternal(LogLevel::Error, "Failed to create bitstream filter: ", getFfmpegErrorString(ret));
+            return false;
+        }
+    }
+
+    auto ret = av_seek_frame(input.get(), index, startTimeStamp, AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) {
+        logInternal(LogLevel::Error, "Failed to seek to start of copy: ", getFfmpegErrorString(ret));
+        return false;
+    }
+    PacketPtr packet(av_packet_alloc());
+    if (packet == nullptr) {
+        logInternal(LogLevel::Error, "Failed to allocate packet");
+        return false;
+    }
+    bool started = false;
+    bool written = false;
+    while (true) {
+        ret = av_read_frame(input.get(), packet.get());
+        if (ret == AVERROR_EOF) {
+            break;
+        } else if (ret < 0) {
+            logInternal(LogLevel::Error, "Failed to retrieve new frame: ", getFfmpegErrorString(ret));
+            return false;
+        }
+        const bool keyFrame = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+        if (packet->stream_index != index || packet->pts == AV_NOPTS_VALUE) {
+            av_packet_unref(packet.get());
+            continue;
+        }
+        if (keyFrame && packet->pts >= endTimeStamp) {
+            av_packet_unref(packet.get());
+            break;
+        }
+        started = started || (keyFrame && packet->pts >= startTimeStamp);
+        // Skip any leading pictures that reference frames before the first copied key frame
+        if (!started || packet->pts < startTimeStamp) {
+            av_packet_unref(packet.get());
+            continue;
+        }
+
+        packet->pts -= offset;
+        if (packet->dts != AV_NOPTS_VALUE) {
+            packet->dts -= offset;
+        }
+        av_packet_rescale_ts(packet.get(), inStream->time_base, outStream->time_base);
+        packet->stream_index = 0;
+        packet->pos = -1;
+        if (filter == nullptr) {
+            if (!writePacket(packet.get())) {
+                return false;
+            }
+            continue;
+        }
+        ret = av_bsf_send_packet(filter.get(), packet.get());
+        while (ret >= 0) {
+            ret = av_bsf_receive_packet(filter.get(), packet.get());
+            if (ret == AVERROR(EAGAIN)) {
+                ret = 0;
+                break;
+            }
+            if (ret >= 0 && !written) {
+                // The filter only inserts codec headers before IDR pictures, but the first copied picture must always
+                // carry them as it follows re-encoded pictures using different ones
+                ret = prependHeaders(packet, filter->par_out);
+            }
+            if (ret >= 0) {
+                if (!writePacket(packet.get())) {
+                    return false;
+                }
+                written = true;
+            }
+        }
+        if (ret < 0) {
+            logInternal(LogLevel::Error, "Failed to filter copied frame: ", getFfmpegErrorString(ret));
+            return false;
+        }
+    }
+    if (!started) {
+        logInternal(LogLevel::Error, "Failed to find key frame to copy");
+        return false;
+    }
+    return true;
+}
+
+int Encoder::prependHeaders(PacketPtr& packet, const AVCodecParameters* const parameters) noexcept
+{
+    if (parameters->extradata_size <= 0) {
+        return 0;
+    }
+    PacketPtr newPacket(av_packet_alloc());
+    if (newPacket == nullptr) {
+        return AVERROR(ENOMEM);
+    }
+    auto ret = av_new_packet(newPacket.get(), parameters->extradata_size + packet->size);
+    if (ret >= 0) {
+        ret = av_packet_copy_props(newPacket.get(), packet.get());
+    }
+    if (ret < 0) {
+        return ret;
+    }
+    memcpy(newPacket->data, parameters->extradata, static_cast<size_t>(parameters->extradata_size));
+    memcpy(newPacket->data + parameters->extradata_size, packet->data, static_cast<size_t>(packet->size));
+    packet = move(newPacket);
+    return 0;
+}
+
+bool Encoder::encodeRange(const std::shared_ptr<Stream>& source, const int64_t startTime, const int64_t endTime,
+    const int64_t offset) const noexcept
+{
+    if (!source->seek(startTime)) {
+        return false;
+    }
+    while (true) {
+        const auto frame = source->getNextFrame();
+        if (frame == nullptr) {
+            if (!source->isEndOfFile()) {
+                return false;
+            }
+            break;
+        }
+        const int64_t time = frame->getTimeStamp();
+        if (time >= endTime) {
+            break;
+        }
+        if (time < startTime) {
+            continue;
+        }
+        frame->m_frame->pts = av_rescale_q(time - offset, av_make_q(1, AV_TIME_BASE), m_codecContext->time_base);
+        frame->m_frame->pict_type = AV_PICTURE_TYPE_NONE;
+        if (!sendFrame(*frame->m_frame, nullptr)) {
+            return false;
+        }
+    }
+    // Flush the encoder, the trailer is written once all sections are complete
+    return sendFrame(nullptr, nullptr);
 }
 
 bool Encoder::isEncoderValid() const noexcept
@@ -243,74 +1098,339 @@ bool Encoder::encodeStream(const std::shared_ptr<Stream>& stream) const noexcept
     }
 }
 
-bool Encoder::encodeFrame(const std::shared_ptr<Frame>& frame, const std::shared_ptr<Stream>& stream) const noexcept
+bool Encoder::encodeStreamSegmented(
+    const std::string& fileName, const std::shared_ptr<Stream>& stream, const EncoderOptions& options) noexcept
 {
-    if (frame != nullptr) {
-        // Send frame to encoder
-        frame->m_frame->best_effort_timestamp = av_rescale_q(
-            frame->m_frame->best_effort_timestamp, stream->m_codecContext->time_base, m_codecContext->time_base);
-        frame->m_frame->pts = frame->m_frame->best_effort_timestamp;
-        const auto ret = avcodec_send_frame(m_codecContext.get(), *frame->m_frame);
-        if (ret < 0) {
-            logInternal(LogLevel::Error, "Failed to send packet to encoder: ", getFfmpegErrorString(ret));
-            return false;
+    // Segments start from the streams current position
+    const auto next = stream->peekNextFrame();
+    if (next == nullptr) {
+        logInternal(LogLevel::Error, "No frames remaining in stream to encode");
+        return false;
+    }
+    const int64_t startTime = next->getTimeStamp();
+    const int64_t duration = stream->getDuration() - startTime;
+    const uint32_t cores = std::max(thread::hardware_concurrency(), 1U);
+    const uint32_t segments = options.m_segments != 0 ? options.m_segments : cores;
+
+    // Split at the first key frame after each evenly spaced point so that each segment starts without forward decoding
+    vector<int64_t> splits = {startTime};
+    const auto packets = stream->scanPackets();
+    for (uint32_t i = 1; i < segments; ++i) {
+        const int64_t target = startTime + duration * i / segments;
+        for (const auto& packet : packets) {
+            if (packet.m_keyFrame && packet.m_timeStamp != INT64_MIN && packet.m_timeStamp >= target &&
+                packet.m_timeStamp > splits.back()) {
+                splits.push_back(packet.m_timeStamp);
+                break;
+            }
         }
-        if (!muxFrames()) {
-            return false;
+    }
+    splits.push_back(INT64_MAX);
+    if (splits.size() <= 2) {
+        // No suitable split points so encode normally
+        EncoderOptions newOptions = options;
+        newOptions.m_segments = 1;
+        return encodeStream(fileName, stream, newOptions);
+    }
+    const auto numSegments = static_cast<uint32_t>(splits.size() - 1);
+    // Share the available cores between the concurrent encoders
+    EncoderOptions segmentOptions = options;
+    segmentOptions.m_numThreads =
+        options.m_numThreads != 0 ? options.m_numThreads : std::max(cores / numSegments, 1U);
+    segmentOptions.m_fragmented = false;
+    segmentOptions.m_writer = nullptr;
+
+    // Each segment is encoded into its own file using a separate decoder
+    vector<string> fileNames;
+    for (uint32_t i = 0; i < numSegments; ++i) {
+        fileNames.emplace_back(fileName + ".part" + to_string(i) + ".nut");
+    }
+    vector<uint8_t> results(numSegments, 0);
+    const auto encodeSegment = [&](const uint32_t segment) noexcept {
+        const auto source = Stream::getStream(stream->m_formatContext->url, stream->m_options);
+        if (source == nullptr || (splits[segment] > 0 && !source->seek(splits[segment]))) {
+            return;
+        }
+        const int64_t segmentEnd = std::min(splits[segment + 1], stream->getDuration());
+        const Encoder encoder(fileNames[segment], source->getWidth(), source->getHeight(),
+            getRational(StreamUtils::getSampleAspectRatio(source.get())), source->getPixelFormat(),
+            getRational(StreamUtils::getFrameRate(source.get())), segmentEnd - splits[segment], segmentOptions,
+            ConstructorLock());
+        if (!encoder.isEncoderValid()) {
+            return;
+        }
+        while (true) {
+            const auto frame = source->getNextFrame();
+            if (frame == nullptr) {
+                if (!source->isEndOfFile()) {
+                    return;
+                }
+                break;
+            }
+            if (frame->getTimeStamp() >= splits[segment + 1]) {
+                break;
+            }
+            if (!encoder.encodeFrame(frame, source)) {
+                return;
+            }
+        }
+        results[segment] = encoder.encodeFrame(nullptr, source) ? 1 : 0;
+    };
+
+    vector<thread> threads;
+    try {
+        threads.reserve(numSegments);
+        for (uint32_t i = 0; i < numSegments; ++i) {
+            threads.emplace_back(encodeSegment, i);
         }
+    } catch (...) {
+        logInternal(LogLevel::Error, "Failed to create segment encoding threads");
+    }
+    for (auto& i : threads) {
+        i.join();
+    }
+    bool ret = threads.size() == numSegments &&
+        std::all_of(results.begin(), results.end(), [](const uint8_t result) { return result != 0; });
+    if (ret) {
+        ret = concatenate(fileName, fileNames, options);
     } else {
-        // Send a flush frame
-        auto ret = avcodec_send_frame(m_codecContext.get(), nullptr);
+        logInternal(LogLevel::Error, "Failed to encode all stream segments");
+    }
+    for (const auto& i : fileNames) {
+        std::remove(i.c_str());
+    }
+    if (ret) {
+        // Leave the stream at the end in the same way as a single pass encode
+        ret = stream->seekFrame(stream->getTotalFrames() - 1);
+        while (ret && stream->getNextFrame() != nullptr) {
+        }
+        ret = ret && stream->isEndOfFile();
+    }
+    return ret;
+}
+
+bool Encoder::concatenate(
+    const std::string& fileName, const std::vector<std::string>& fileNames, const EncoderOptions& options) noexcept
+{
+    Encoder output{OutputFormatContextPtr(), CodecContextPtr(), ConstructorLock()};
+    PacketPtr packet(av_packet_alloc());
+    if (packet == nullptr) {
+        logInternal(LogLevel::Error, "Failed to allocate packet");
+        return false;
+    }
+    for (const auto& i : fileNames) {
+        AVFormatContext* formatPtr = nullptr;
+        auto ret = avformat_open_input(&formatPtr, i.c_str(), nullptr, nullptr);
+        FormatContextPtr input(formatPtr);
         if (ret < 0) {
-            logInternal(LogLevel::Error, "Failed to send flush packet to encoder: ", getFfmpegErrorString(ret));
+            logInternal(LogLevel::Error, "Failed to open input stream: ", i, ", ", getFfmpegErrorString(ret));
             return false;
         }
-        if (!muxFrames()) {
+        if (input->nb_streams != 1) {
+            logInternal(LogLevel::Error, "Concatenated files must contain a single stream: ", i);
             return false;
         }
-        av_interleaved_write_frame(m_formatContext.get(), nullptr);
-        ret = av_write_trailer(m_formatContext.get());
-        if (ret < 0) {
-            logInternal(LogLevel::Error, "Failed to write file trailer: ", getFfmpegErrorString(ret));
-            return false;
+        const AVStream* const inStream = input->streams[0];
+        if (output.m_formatContext.get() == nullptr) {
+            // The output uses the parameters of the first file, all segments are encoded with the same settings
+            output.m_formatContext = openCopyOutput(fileName, inStream, false, options);
+            if (output.m_formatContext.get() == nullptr) {
+                return false;
+            }
+        }
+
+        // Segments hold their original time stamps so they only need converting to the output time base
+        while (true) {
+            ret = av_read_frame(input.get(), packet.get());
+            if (ret == AVERROR_EOF) {
+                break;
+            } else if (ret < 0) {
+                logInternal(LogLevel::Error, "Failed to retrieve new frame: ", getFfmpegErrorString(ret));
+                return false;
+            }
+            av_packet_rescale_ts(packet.get(), inStream->time_base, output.m_formatContext->streams[0]->time_base);
+            packet->stream_index = 0;
+            packet->pos = -1;
+            if (!output.writePacket(packet.get())) {
+                return false;
+            }
         }
     }
-    return true;
+    if (output.m_formatContext.get() == nullptr) {
+        return false;
+    }
+    return output.writeTrailer();
+}
+
+bool Encoder::encodeStreamPipelined(const std::shared_ptr<Stream>& stream) const noexcept
+{
+    Queue<shared_ptr<Frame>> frames(s_frameQueueLength);
+    PacketQueue packets(s_packetQueueLength);
+    atomic<bool> abort(false);
+    bool encodeValid = true;
+    bool muxValid = true;
+    const auto stop = [&]() noexcept {
+        // Stop all stages and release any frames/packets that are no longer needed
+        abort = true;
+        frames.close(true);
+        packets.close(true);
+    };
+    const auto encodeStage = [&]() noexcept {
+        shared_ptr<Frame> frame;
+        while (frames.pop(frame)) {
+            if (!encodeFrame(frame, stream, &packets)) {
+                encodeValid = false;
+                stop();
+                return;
+            }
+            frame = nullptr;
+        }
+        // Only flush once all frames have been successfully decoded
+        if (!abort && !encodeFrame(nullptr, stream, &packets)) {
+            encodeValid = false;
+            stop();
+            return;
+        }
+        packets.close();
+    };
+    const auto muxStage = [&]() noexcept {
+        PacketPtr packet;
+        while (packets.pop(packet)) {
+            if (!writePacket(packet.get())) {
+                muxValid = false;
+                stop();
+                return;
+            }
+            packet = nullptr;
+        }
+        if (!abort && !writeTrailer()) {
+            muxValid = false;
+        }
+    };
+
+    thread encodeThread;
+    thread muxThread;
+    try {
+        muxThread = thread(muxStage);
+        encodeThread = thread(encodeStage);
+    } catch (...) {
+        logInternal(LogLevel::Error, "Failed to create encoding threads");
+        stop();
+        if (muxThread.joinable()) {
+            muxThread.join();
+        }
+        return false;
+    }
+
+    // Decode on the calling thread
+    bool decodeValid = true;
+    while (true) {
+        auto frame = stream->getNextFrame();
+        if (frame == nullptr) {
+            decodeValid = stream->isEndOfFile();
+            break;
+        }
+        if (!frames.push(move(frame))) {
+            // A later stage has failed
+            break;
+        }
+    }
+    if (decodeValid) {
+        frames.close();
+    } else {
+        stop();
+    }
+    encodeThread.join();
+    muxThread.join();
+    return decodeValid && encodeValid && muxValid;
+}
+
+bool Encoder::encodeFrame(const std::shared_ptr<Frame>& frame, const std::shared_ptr<Stream>& stream,
+    PacketQueue* const packets) const noexcept
+{
+    if (frame != nullptr) {
+        // Send frame to encoder
+        frame->m_frame->best_effort_timestamp = av_rescale_q(
+            frame->m_frame->best_effort_timestamp, stream->m_codecContext->time_base, m_codecContext->time_base);
+        frame->m_frame->pts = frame->m_frame->best_effort_timestamp;
+        return sendFrame(*frame->m_frame, packets);
+    }
+    // Send a flush frame
+    if (!sendFrame(nullptr, packets)) {
+        return false;
+    }
+    return packets != nullptr || writeTrailer();
 }
 
-bool Encoder::muxFrames() const noexcept
+bool Encoder::sendFrame(AVFrame* const frame, PacketQueue* const packets) const noexcept
+{
+    const auto ret = avcodec_send_frame(m_codecContext.get(), frame);
+    if (ret < 0) {
+        if (frame != nullptr) {
+            logInternal(LogLevel::Error, "Failed to send packet to encoder: ", getFfmpegErrorString(ret));
+        } else {
+            logInternal(LogLevel::Error, "Failed to send flush packet to encoder: ", getFfmpegErrorString(ret));
+        }
+        return false;
+    }
+    return muxFrames(packets);
+}
+
+bool Encoder::muxFrames(PacketQueue* const packets) const noexcept
 {
     // Get all encoder packets
-    AVPacket packet;
     while (true) {
-        packet.data = nullptr;
-        packet.size = 0;
-        av_init_packet(&packet);
-        auto ret = avcodec_receive_packet(m_codecContext.get(), &packet);
+        PacketPtr packet(av_packet_alloc());
+        if (packet == nullptr) {
+            logInternal(LogLevel::Error, "Failed to allocate packet");
+            return false;
+        }
+        auto ret = avcodec_receive_packet(m_codecContext.get(), packet.get());
         if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-            av_packet_unref(&packet);
             break;
         } else if (ret < 0) {
-            av_packet_unref(&packet);
             logInternal(LogLevel::Error, "Failed to receive encoded frame: ", getFfmpegErrorString(ret));
             return false;
         }
 
         // Setup packet for muxing
-        packet.stream_index = 0;
-        packet.duration = av_rescale_q(1, av_inv_q(m_codecContext->framerate), m_codecContext->time_base);
-        av_packet_rescale_ts(&packet, m_codecContext->time_base, m_formatContext->streams[0]->time_base);
-        packet.pos = -1;
+        packet->stream_index = 0;
+        packet->duration = av_rescale_q(1, av_inv_q(m_codecContext->framerate), m_codecContext->time_base);
+        av_packet_rescale_ts(packet.get(), m_codecContext->time_base, m_formatContext->streams[0]->time_base);
+        if (m_decodeDelay != 0) {
+            packet->dts = packet->pts - m_decodeDelay;
+        }
+        packet->pos = -1;
 
         // Mux encoded frame
-        ret = av_interleaved_write_frame(m_formatContext.get(), &packet);
-        if (ret < 0) {
-            av_packet_unref(&packet);
-            logInternal(LogLevel::Error, "Failed to write encoded frame: ", getFfmpegErrorString(ret));
+        if (packets != nullptr) {
+            if (!packets->push(move(packet))) {
+                return false;
+            }
+        } else if (!writePacket(packet.get())) {
             return false;
         }
+    }
+    return true;
+}
+
+bool Encoder::writePacket(AVPacket* const packet) const noexcept
+{
+    const auto ret = av_interleaved_write_frame(m_formatContext.get(), packet);
+    if (ret < 0) {
+        logInternal(LogLevel::Error, "Failed to write encoded frame: ", getFfmpegErrorString(ret));
+        return false;
+    }
+    return true;
+}
 
-        av_packet_unref(&packet);
+bool Encoder::writeTrailer() const noexcept
+{
+    av_interleaved_write_frame(m_formatContext.get(), nullptr);
+    const auto ret = av_write_trailer(m_formatContext.get());
+    if (ret < 0) {
+        logInternal(LogLevel::Error, "Failed to write file trailer: ", getFfmpegErrorString(ret));
+        return false;
     }
     return true;
 }
@@ -17,7 +17,11 @@
 
 #include "FFFRUtility.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <string>
+#include <thread>
 using namespace std;
 
 extern "C" {
@@ -45,8 +49,10 @@ AVFilterGraph* Filter::FilterGraphPtr::operator->() const noexcept
     return m_filterGraph.get();
 }
 
-Filter::Filter(const Resolution scale, const Crop crop, PixelFormat format, const FormatContextPtr& formatContext,
-    const uint32_t streamIndex, const CodecContextPtr& codecContext) noexcept
+Filter::Filter(const Resolution scale, const Crop crop, const Resolution pad, const Resolution padOffset,
+    const uint32_t padColour, const ScaleAlgorithm algorithm, const uint32_t filterThreads, PixelFormat format,
+    const bool lumaOnly, const FormatContextPtr& formatContext, const uint32_t streamIndex,
+    const CodecContextPtr& codecContext) noexcept
 {
     // Make a filter graph to perform any required conversions
     FilterGraphPtr tempGraph(avfilter_graph_alloc());
@@ -58,6 +64,17 @@ Filter::Filter(const Resolution scale, const Crop crop, PixelFormat format, cons
         return;
     }
 
+    // Threading must be set before any filters are added to the graph
+    const uint32_t outWidth = pad.m_width != 0 ?
+        pad.m_width :
+        (scale.m_width != 0 ? scale.m_width : static_cast<uint32_t>(codecContext->width));
+    const uint32_t outHeight = pad.m_height != 0 ?
+        pad.m_height :
+        (scale.m_height != 0 ? scale.m_height : static_cast<uint32_t>(codecContext->height));
+    const uint32_t threads = getFilterThreads(filterThreads, outWidth, outHeight);
+    tempGraph->nb_threads = static_cast<int>(threads);
+    tempGraph->thread_type = threads > 1 ? AVFILTER_THREAD_SLICE : 0;
+
     // Create the input and output buffers
     const auto bufferInContext = avfilter_graph_alloc_filter(tempGraph.get(), bufferIn, "src");
     const auto bufferOutContext = avfilter_graph_alloc_filter(tempGraph.get(), bufferOut, "sink");
@@ -67,9 +84,13 @@ Filter::Filter(const Resolution scale, const Crop crop, PixelFormat format, cons
     }
 
     // Set the input buffer parameters
-    const auto inFormat = codecContext->pix_fmt == AV_PIX_FMT_NONE ?
+    auto inFormat = codecContext->pix_fmt == AV_PIX_FMT_NONE ?
         static_cast<AVPixelFormat>(formatContext->streams[streamIndex]->codecpar->format) :
         codecContext->pix_fmt;
+    if (lumaOnly) {
+        // Chroma planes are removed before filtering so only the luma is processed
+        inFormat = AV_PIX_FMT_GRAY8;
+    }
     const auto inHeight = codecContext->height;
     const auto inWidth = codecContext->width;
     auto inParams = av_buffersrc_parameters_alloc();
@@ -98,6 +119,7 @@ Filter::Filter(const Resolution scale, const Crop crop, PixelFormat format, cons
     // Determine which settings require a filter stage
     const bool cropRequired = (crop.m_top != 0 || crop.m_bottom != 0 || crop.m_left != 0 || crop.m_right != 0);
     const bool scaleRequired = (scale.m_height != 0 || scale.m_width != 0);
+    const bool padRequired = (pad.m_height != 0 || pad.m_width != 0);
     const bool formatRequired =
         (format != PixelFormat::Auto && format != Ffr::getPixelFormat(static_cast<AVPixelFormat>(inFormat)));
 
@@ -176,6 +198,7 @@ Filter::Filter(const Resolution scale, const Crop crop, PixelFormat format, cons
             }
             // av_opt_set(scaleContext, "out_color_matrix", "bt709", AV_OPT_SEARCH_CHILDREN);
             av_opt_set(scaleContext, "out_range", "full", AV_OPT_SEARCH_CHILDREN);
+            av_opt_set(scaleContext, "flags", getScaleFlags(algorithm), AV_OPT_SEARCH_CHILDREN);
 
             // Link the filter into chain
             ret = avfilter_link(nextFilter, 0, scaleContext, 0);
@@ -185,10 +208,45 @@ Filter::Filter(const Resolution scale, const Crop crop, PixelFormat format, cons
             }
             nextFilter = scaleContext;
         }
+        if (padRequired) {
+            const auto padFilter = avfilter_get_by_name("pad");
+            if (padFilter == nullptr) {
+                logInternal(LogLevel::Error, "Unable to create pad filter");
+                return;
+            }
+            const auto padContext = avfilter_graph_alloc_filter(tempGraph.get(), padFilter, "pad");
+            if (padContext == nullptr) {
+                logInternal(LogLevel::Error, "Unable to create pad filter context");
+                return;
+            }
+            try {
+                av_opt_set(padContext, "w", to_string(pad.m_width).c_str(), AV_OPT_SEARCH_CHILDREN);
+                av_opt_set(padContext, "h", to_string(pad.m_height).c_str(), AV_OPT_SEARCH_CHILDREN);
+                av_opt_set(padContext, "x", to_string(padOffset.m_width).c_str(), AV_OPT_SEARCH_CHILDREN);
+                av_opt_set(padContext, "y", to_string(padOffset.m_height).c_str(), AV_OPT_SEARCH_CHILDREN);
+                char colour[9];
+                snprintf(colour, sizeof(colour), "0x%06X", padColour & 0xFFFFFF);
+                av_opt_set(padContext, "color", colour, AV_OPT_SEARCH_CHILDREN);
+            } catch (...) {
+                return;
+            }
+
+            // Link the filter into chain
+            ret = avfilter_link(nextFilter, 0, padContext, 0);
+            if (ret < 0) {
+                logInternal(LogLevel::Error, "Unable to link pad filter");
+                return;
+            }
+            nextFilter = padContext;
+        }
     } else {
         const auto* const deviceContext = reinterpret_cast<AVHWDeviceContext*>(codecContext->hw_device_ctx->data);
         if (deviceContext->type == AV_HWDEVICE_TYPE_CUDA) {
             // Scale and crop are performed by decoder
+            if (padRequired) {
+                logInternal(LogLevel::Error, "Padding is not supported with hardware decoding");
+                return;
+            }
             if (formatRequired) {
                 // TODO: Needs additions to ffmpegs filters for cuda accelerated format conversion
                 logInternal(LogLevel::Error, "Feature not yet implemented for selected decoding type");
@@ -218,12 +276,43 @@ Filter::Filter(const Resolution scale, const Crop crop, PixelFormat format, cons
     m_filterGraph = move(tempGraph);
     m_source = bufferInContext;
     m_sink = bufferOutContext;
+    m_threads = threads;
+    logInternal(LogLevel::Info, "Filter- Using filter threads: ", threads);
+}
+
+const char* Filter::getScaleFlags(const ScaleAlgorithm algorithm) noexcept
+{
+    switch (algorithm) {
+        case ScaleAlgorithm::FastBilinear:
+            return "fast_bilinear";
+        case ScaleAlgorithm::Area:
+            return "area";
+        case ScaleAlgorithm::Bicubic:
+            return "bicubic";
+        case ScaleAlgorithm::Lanczos:
+            return "lanczos";
+        default:
+            return "bilinear";
+    }
 }
 
-bool Filter::sendFrame(FramePtr& frame) const noexcept
+uint32_t Filter::getFilterThreads(const uint32_t threads, const uint32_t width, const uint32_t height) noexcept
+{
+    if (threads != 0) {
+        return threads;
+    }
+    // Slice threading has too much overhead for small frames so use a thread for roughly each quarter of a 1080p frame
+    constexpr uint64_t pixelsPerThread = 960 * 540;
+    const auto required = static_cast<uint32_t>(static_cast<uint64_t>(width) * height / pixelsPerThread);
+    return std::min(std::max(required, 1U), std::max(thread::hardware_concurrency(), 1U));
+}
+
+bool Filter::sendFrame(FramePtr& frame) noexcept
 {
     LOG_DEBUG("sendFrame- Sending frame to filter graph: ", frame->best_effort_timestamp);
+    const auto start = chrono::steady_clock::now();
     const auto err = av_buffersrc_add_frame(m_source, *frame);
+    m_sendTime += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
     if (err < 0) {
         logInternal(LogLevel::Error, "Failed to submit frame to filter graph: ", getFfmpegErrorString(err));
         return false;
@@ -231,10 +320,12 @@ bool Filter::sendFrame(FramePtr& frame) const noexcept
     return true;
 }
 
-bool Filter::receiveFrame(FramePtr& frame) const noexcept
+bool Filter::receiveFrame(FramePtr& frame) noexcept
 {
     // Get the next available frame
+    const auto start = chrono::steady_clock::now();
     const auto err = av_buffersink_get_frame(m_sink, *frame);
+    m_receiveTime += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
     if (err < 0) {
         if ((err == AVERROR(EAGAIN)) || (err == AVERROR_EOF)) {
             return true;
@@ -243,6 +334,7 @@ bool Filter::receiveFrame(FramePtr& frame) const noexcept
         return false;
     }
     LOG_DEBUG("sendFrame- Received frame from filter graph: ", frame->best_effort_timestamp);
+    ++m_frames;
     return true;
 }
 
@@ -280,4 +372,14 @@ uint32_t Filter::getFrameSize() const noexcept
     return av_image_get_buffer_size(
         static_cast<AVPixelFormat>(av_buffersink_get_format(m_sink)), getWidth(), getHeight(), 32);
 }
+
+FilterStatistics Filter::getStatistics() const noexcept
+{
+    FilterStatistics ret;
+    ret.m_threads = m_threads;
+    ret.m_frames = m_frames;
+    ret.m_sendTime = m_sendTime / 1000;
+    ret.m_receiveTime = m_receiveTime / 1000;
+    return ret;
+}
 } // namespace Ffr
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 #include <cstdint>
+#include <cuda_fp16.h>
 
 __device__ __forceinline__ float clamp(const float f, const float a, const float b)
 {
@@ -51,6 +52,12 @@ struct RGBPlanes
     T* m_plane3;
 };
 
+struct Normalise
+{
+    float m_scale[3];
+    float m_offset[3];
+};
+
 __device__ __forceinline__ Pixel2 getNV12ToRGB(
     const uint32_t x, const uint32_t y, const NV12Planes source, const uint32_t sourceStep)
 {
@@ -111,21 +118,25 @@ public:
 };
 
 template<typename T>
-__device__ __forceinline__ T getRGB(const float3 pixel)
+__device__ __forceinline__ T getRGB(const float3 pixel, const Normalise& normalise)
 {
-    // Normalise float values
-    return make_float3(__saturatef(pixel.x / 255.0f), __saturatef(pixel.y / 255.0f), __saturatef(pixel.z / 255.0f));
+    // Normalise float values and apply any additional per channel scale and offset
+    return make_float3(fmaf(__saturatef(pixel.x / 255.0f), normalise.m_scale[0], normalise.m_offset[0]),
+        fmaf(__saturatef(pixel.y / 255.0f), normalise.m_scale[1], normalise.m_offset[1]),
+        fmaf(__saturatef(pixel.z / 255.0f), normalise.m_scale[2], normalise.m_offset[2]));
 }
 
 template<>
-__device__ __forceinline__ uchar3 getRGB(const float3 pixel)
+__device__ __forceinline__ uchar3 getRGB(const float3 pixel, const Normalise&)
 {
-    return make_uchar3(clamp(pixel.x, 0.0f, 255.0f), clamp(pixel.y, 0.0f, 255.0f), clamp(pixel.z, 0.0f, 255.0f));
+    // Round to nearest to match the host conversion
+    return make_uchar3(__float2uint_rn(clamp(pixel.x, 0.0f, 255.0f)), __float2uint_rn(clamp(pixel.y, 0.0f, 255.0f)),
+        __float2uint_rn(clamp(pixel.z, 0.0f, 255.0f)));
 }
 
 template<typename T>
 __device__ __forceinline__ void convertNV12ToRGBP(const NV12Planes source, const uint32_t sourceStep,
-    const uint32_t width, const uint32_t height, RGBPlanes<T> dest, const uint32_t destStep)
+    const uint32_t width, const uint32_t height, RGBPlanes<T> dest, const uint32_t destStep, const Normalise normalise)
 {
     const uint32_t x = blockIdx.x * (blockDim.x << 1) + (threadIdx.x << 1);
     const uint32_t y = blockIdx.y * blockDim.y + threadIdx.y;
@@ -136,8 +147,8 @@ __device__ __forceinline__ void convertNV12ToRGBP(const NV12Planes source, const
 
     Pixel2 pixels = getNV12ToRGB(x, y, source, sourceStep);
 
-    const auto pixel1 = getRGB<typename UpPack<T>::Type>(pixels.m_pixels[0]);
-    const auto pixel2 = getRGB<typename UpPack<T>::Type>(pixels.m_pixels[1]);
+    const auto pixel1 = getRGB<typename UpPack<T>::Type>(pixels.m_pixels[0], normalise);
+    const auto pixel2 = getRGB<typename UpPack<T>::Type>(pixels.m_pixels[1], normalise);
     const uint32_t destOffset = y * destStep + x;
     dest.m_plane1[destOffset] = pixel1.x;
     dest.m_plane1[destOffset + 1] = pixel2.x;
@@ -147,16 +158,60 @@ __device__ __forceinline__ void convertNV12ToRGBP(const NV12Planes source, const
     dest.m_plane3[destOffset + 1] = pixel2.z;
 }
 
+template<bool Planar>
+__device__ __forceinline__ void convertNV12ToRGBHalf(const NV12Planes source, const uint32_t sourceStep,
+    const uint32_t width, const uint32_t height, RGBPlanes<__half> dest, const uint32_t destStep,
+    const Normalise normalise, const bool swapRB)
+{
+    const uint32_t x = blockIdx.x * (blockDim.x << 1) + (threadIdx.x << 1);
+    const uint32_t y = blockIdx.y * blockDim.y + threadIdx.y;
+
+    if (x >= width - 1 || y >= height) {
+        return;
+    }
+
+    Pixel2 pixels = getNV12ToRGB(x, y, source, sourceStep);
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        const float3 pixel = getRGB<float3>(pixels.m_pixels[i], normalise);
+        if (Planar) {
+            // Planar outputs swap channels by swapping the output planes
+            const uint32_t destOffset = y * destStep + x + i;
+            dest.m_plane1[destOffset] = __float2half_rn(pixel.x);
+            dest.m_plane2[destOffset] = __float2half_rn(pixel.y);
+            dest.m_plane3[destOffset] = __float2half_rn(pixel.z);
+        } else {
+            const uint32_t destOffset = y * destStep + (x + i) * 3;
+            dest.m_plane1[destOffset] = __float2half_rn(swapRB ? pixel.z : pixel.x);
+            dest.m_plane1[destOffset + 1] = __float2half_rn(pixel.y);
+            dest.m_plane1[destOffset + 2] = __float2half_rn(swapRB ? pixel.x : pixel.z);
+        }
+    }
+}
+
 extern "C" {
 __global__ void convertNV12ToRGB8P(const NV12Planes source, const uint32_t sourceStep, const uint32_t width,
     const uint32_t height, const RGBPlanes<uint8_t> dest, const uint32_t destStep)
 {
-    convertNV12ToRGBP<uint8_t>(source, sourceStep, width, height, dest, destStep);
+    convertNV12ToRGBP<uint8_t>(source, sourceStep, width, height, dest, destStep, Normalise());
 }
 
 __global__ void convertNV12ToRGB32FP(const NV12Planes source, const uint32_t sourceStep, const uint32_t width,
-    const uint32_t height, const RGBPlanes<float> dest, const uint32_t destStep)
+    const uint32_t height, const RGBPlanes<float> dest, const uint32_t destStep, const Normalise normalise)
+{
+    convertNV12ToRGBP<float>(source, sourceStep, width, height, dest, destStep / sizeof(float), normalise);
+}
+
+__global__ void convertNV12ToRGB16FP(const NV12Planes source, const uint32_t sourceStep, const uint32_t width,
+    const uint32_t height, const RGBPlanes<__half> dest, const uint32_t destStep, const Normalise normalise)
+{
+    convertNV12ToRGBHalf<true>(source, sourceStep, width, height, dest, destStep / sizeof(__half), normalise, false);
+}
+
+__global__ void convertNV12ToRGB16F(const NV12Planes source, const uint32_t sourceStep, const uint32_t width,
+    const uint32_t height, const RGBPlanes<__half> dest, const uint32_t destStep, const Normalise normalise,
+    const bool swapRB)
 {
-    convertNV12ToRGBP<float>(source, sourceStep, width, height, dest, destStep / sizeof(float));
+    convertNV12ToRGBHalf<false>(source, sourceStep, width, height, dest, destStep / sizeof(__half), normalise, swapRB);
 }
 }
\ No newline at end of file
@@ -0,0 +1,260 @@
+/**
+ * Copyright 2019 Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "FFFRFramePool.h"
+
+#include "FFFRUtility.h"
+
+#include <algorithm>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/cpu.h>
+#include <libavutil/frame.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+using namespace std;
+
+namespace Ffr {
+struct AllocatedBuffer
+{
+    shared_ptr<FrameAllocator> m_allocator = nullptr; /**< The allocator that owns the memory. */
+    size_t m_size = 0;                                /**< The size of the allocation in bytes. */
+};
+
+uint8_t* HostAllocator::allocate(const size_t size) noexcept
+{
+    return static_cast<uint8_t*>(av_malloc(size));
+}
+
+void HostAllocator::deallocate(uint8_t* const data, size_t) noexcept
+{
+    av_free(data);
+}
+
+uint32_t HostAllocator::getAlignment() const noexcept
+{
+    return static_cast<uint32_t>(av_cpu_max_align());
+}
+
+FramePool::FramePool(shared_ptr<FrameAllocator> allocator) noexcept
+    : m_allocator(move(allocator))
+{}
+
+FramePool::~FramePool() noexcept
+{
+    // Pools are only freed once all of their buffers have been returned
+    for (auto& i : m_poolSets) {
+        for (auto& j : i.m_pools) {
+            av_buffer_pool_uninit(&j);
+        }
+    }
+}
+
+bool FramePool::getBuffer(AVFrame* frame) noexcept
+{
+    lock_guard<mutex> lock(m_mutex);
+    const auto* pools = getPools(static_cast<AVPixelFormat>(frame->format), frame->width, frame->height, {1, 1, 1, 1});
+    if (pools == nullptr) {
+        return false;
+    }
+    return allocateBuffers(*pools, frame);
+}
+
+bool FramePool::copyFrame(FramePtr& frame) noexcept
+{
+    FramePtr newFrame(av_frame_alloc());
+    if (*newFrame == nullptr) {
+        logInternal(LogLevel::Error, "Failed to allocate new frame");
+        return false;
+    }
+    newFrame->format = frame->format;
+    newFrame->width = frame->width;
+    newFrame->height = frame->height;
+    if (!getBuffer(*newFrame)) {
+        return false;
+    }
+    auto ret = av_frame_copy(*newFrame, *frame);
+    if (ret >= 0) {
+        ret = av_frame_copy_props(*newFrame, *frame);
+    }
+    if (ret < 0) {
+        logInternal(LogLevel::Error, "Failed to copy frame into allocated memory: ", getFfmpegErrorString(ret));
+        return false;
+    }
+    frame = move(newFrame);
+    return true;
+}
+
+int FramePool::getBuffer2(AVCodecContext* context, AVFrame* frame, const int flags) noexcept
+{
+    auto* pool = static_cast<FramePool*>(context->opaque);
+    const auto* const descriptor = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+    // Only direct rendering capable software decoders can use external memory
+    if (pool == nullptr || !(context->codec->capabilities & AV_CODEC_CAP_DR1) || context->hw_frames_ctx != nullptr ||
+        descriptor == nullptr || (descriptor->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))) {
+        return avcodec_default_get_buffer2(context, frame, flags);
+    }
+
+    // Decoders may write past the visible frame dimensions so use the codecs alignment requirements
+    int32_t width = frame->width;
+    int32_t height = frame->height;
+    int32_t lineAlign[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(context, &width, &height, lineAlign);
+
+    lock_guard<mutex> lock(pool->m_mutex);
+    const auto* pools = pool->getPools(static_cast<AVPixelFormat>(frame->format), width, height,
+        {lineAlign[0], lineAlign[1], lineAlign[2], lineAlign[3]});
+    if (pools == nullptr) {
+        return AVERROR(ENOMEM);
+    }
+    if (!allocateBuffers(*pools, frame)) {
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+const FramePool::PoolSet* FramePool::getPools(
+    const AVPixelFormat format, const int32_t width, const int32_t height, const array<int32_t, 4>& lineAlign) noexcept
+{
+    const auto found = find_if(m_poolSets.begin(), m_poolSets.end(), [&](const PoolSet& i) {
+        return i.m_format == format && i.m_width == width && i.m_height == height && i.m_lineAlign == lineAlign;
+    });
+    if (found != m_poolSets.end()) {
+        // Keep the most recently used pools at the front
+        rotate(m_poolSets.begin(), found, found + 1);
+        return &m_poolSets.front();
+    }
+
+    // Determine line sizes that meet both the allocator and decoder alignment requirements
+    const auto alignment = static_cast<int32_t>(std::max(m_allocator->getAlignment(), 1U));
+    int32_t lineSizes[4];
+    auto ret = av_image_fill_linesizes(lineSizes, format, FFALIGN(width, alignment));
+    if (ret < 0) {
+        logInternal(LogLevel::Error, "Failed to determine frame line sizes: ", getFfmpegErrorString(ret));
+        return nullptr;
+    }
+    for (uint32_t i = 0; i < 4; ++i) {
+        const auto align = std::max(alignment, lineAlign[i]);
+        lineSizes[i] = (lineSizes[i] + align - 1) / align * align;
+    }
+
+    // Determine plane sizes
+    uint8_t* data[4];
+    ret = av_image_fill_pointers(data, format, height, nullptr, lineSizes);
+    if (ret < 0) {
+        logInternal(LogLevel::Error, "Failed to determine frame plane sizes: ", getFfmpegErrorString(ret));
+        return nullptr;
+    }
+    const auto totalSize = static_cast<size_t>(ret);
+    array<size_t, 4> planeSizes = {0, 0, 0, 0};
+    uint32_t planes = 0;
+    for (; planes < 3 && data[planes + 1] != nullptr; ++planes) {
+        planeSizes[planes] = static_cast<size_t>(data[planes + 1] - data[planes]);
+    }
+    planeSizes[planes] = totalSize - static_cast<size_t>(data[planes] - data[0]);
+
+    // Create the new pools
+    PoolSet pools;
+    pools.m_lineAlign = lineAlign;
+    pools.m_format = format;
+    pools.m_width = width;
+    pools.m_height = height;
+    for (uint32_t i = 0; i < 4; ++i) {
+        pools.m_lineSizes[i] = lineSizes[i];
+        if (planeSizes[i] == 0) {
+            continue;
+        }
+        // Add padding to allow for SIMD reads past the end of a plane
+        const auto poolSize = planeSizes[i] + 16 + static_cast<size_t>(alignment) - 1 + m_allocator->getPadding();
+        pools.m_pools[i] = av_buffer_pool_init2(static_cast<int>(poolSize), this, allocateBuffer, nullptr);
+        if (pools.m_pools[i] == nullptr) {
+            logInternal(LogLevel::Error, "Failed to create frame buffer pool");
+            for (auto& j : pools.m_pools) {
+                av_buffer_pool_uninit(&j);
+            }
+            return nullptr;
+        }
+    }
+
+    // Remove the least recently used pools, any existing buffers are freed once their frames are released
+    try {
+        if (m_poolSets.size() >= s_maxPoolSets) {
+            for (auto& j : m_poolSets.back().m_pools) {
+                av_buffer_pool_uninit(&j);
+            }
+            m_poolSets.pop_back();
+        }
+        m_poolSets.insert(m_poolSets.begin(), pools);
+    } catch (...) {
+        logInternal(LogLevel::Error, "Failed to store frame buffer pool");
+        for (auto& j : pools.m_pools) {
+            av_buffer_pool_uninit(&j);
+        }
+        return nullptr;
+    }
+    return &m_poolSets.front();
+}
+
+bool FramePool::allocateBuffers(const PoolSet& pools, AVFrame* frame) noexcept
+{
+    for (uint32_t i = 0; i < 4; ++i) {
+        if (pools.m_pools[i] == nullptr) {
+            continue;
+        }
+        frame->buf[i] = av_buffer_pool_get(pools.m_pools[i]);
+        if (frame->buf[i] == nullptr) {
+            logInternal(LogLevel::Error, "Failed to get frame buffer from pool");
+            av_frame_unref(frame);
+            return false;
+        }
+        frame->data[i] = frame->buf[i]->data;
+        frame->linesize[i] = pools.m_lineSizes[i];
+    }
+    frame->extended_data = frame->data;
+    return true;
+}
+
+AVBufferRef* FramePool::allocateBuffer(void* opaque, const int size) noexcept
+{
+    auto* pool = static_cast<FramePool*>(opaque);
+    uint8_t* data = pool->m_allocator->allocate(static_cast<size_t>(size));
+    if (data == nullptr) {
+        logInternal(LogLevel::Error, "Frame allocator failed to allocate memory: ", size);
+        return nullptr;
+    }
+    // Each buffer holds a reference to the allocator so that it can be freed after the pool has been destroyed
+    auto* holder = new (nothrow) AllocatedBuffer{pool->m_allocator, static_cast<size_t>(size)};
+    if (holder == nullptr) {
+        pool->m_allocator->deallocate(data, static_cast<size_t>(size));
+        return nullptr;
+    }
+    AVBufferRef* buffer = av_buffer_create(
+        data, size,
+        [](void* opaque2, uint8_t* data2) noexcept {
+            auto* holder2 = static_cast<AllocatedBuffer*>(opaque2);
+            holder2->m_allocator->deallocate(data2, holder2->m_size);
+            delete holder2;
+        },
+        holder, 0);
+    if (buffer == nullptr) {
+        pool->m_allocator->deallocate(data, static_cast<size_t>(size));
+        delete holder;
+    }
+    return buffer;
+}
+} // namespace Ffr
@@ -0,0 +1,122 @@
+/**
+ * Copyright 2019 Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "FFFRMemory.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+using namespace std;
+
+namespace Ffr {
+static atomic<uint64_t> g_memoryBudget{0}; /**< The global memory budget in bytes (0 if unlimited) */
+static atomic<uint32_t> g_memoryWait{0};   /**< The time in milliseconds to wait for memory once over budget */
+static atomic<uint64_t> g_memoryUsage{0};  /**< The current global memory usage in bytes */
+static atomic<uint64_t> g_memoryPeak{0};   /**< The peak global memory usage in bytes */
+static mutex g_memoryMutex;
+static condition_variable g_memoryCondition; /**< Signalled whenever memory is released */
+
+void setMemoryBudget(const uint64_t budget, const uint32_t waitTime) noexcept
+{
+    g_memoryBudget = budget;
+    g_memoryWait = waitTime;
+    // Wake any waiting streams so that they use the new budget
+    lock_guard<mutex> lock(g_memoryMutex);
+    g_memoryCondition.notify_all();
+}
+
+uint64_t getMemoryBudget() noexcept
+{
+    return g_memoryBudget;
+}
+
+uint64_t getMemoryUsage() noexcept
+{
+    return g_memoryUsage;
+}
+
+uint64_t getPeakMemoryUsage() noexcept
+{
+    return g_memoryPeak;
+}
+
+void resetPeakMemoryUsage() noexcept
+{
+    g_memoryPeak = g_memoryUsage.load();
+}
+
+void MemoryTracker::allocate(const uint64_t size) noexcept
+{
+    if (size == 0) {
+        return;
+    }
+    m_usage += size;
+    const uint64_t usage = g_memoryUsage += size;
+    uint64_t peak = g_memoryPeak;
+    while (usage > peak && !g_memoryPeak.compare_exchange_weak(peak, usage)) {
+    }
+}
+
+void MemoryTracker::release(const uint64_t size) noexcept
+{
+    if (size == 0) {
+        return;
+    }
+    m_usage -= size;
+    g_memoryUsage -= size;
+    if (g_memoryBudget != 0 && g_memoryWait != 0) {
+        lock_guard<mutex> lock(g_memoryMutex);
+        g_memoryCondition.notify_all();
+    }
+}
+
+uint64_t MemoryTracker::getUsage() const noexcept
+{
+    return m_usage;
+}
+
+bool MemoryTracker::waitForBudget() noexcept
+{
+    const auto available = []() noexcept { return g_memoryBudget == 0 || g_memoryUsage < g_memoryBudget; };
+    if (available()) {
+        return true;
+    }
+    const uint32_t waitTime = g_memoryWait;
+    if (waitTime == 0) {
+        return false;
+    }
+    unique_lock<mutex> lock(g_memoryMutex);
+    return g_memoryCondition.wait_for(lock, chrono::milliseconds(waitTime), available);
+}
+
+uint64_t MemoryTracker::getFrameMemory(const AVFrame* const frame) noexcept
+{
+    if (frame == nullptr || frame->hw_frames_ctx != nullptr) {
+        return 0;
+    }
+    uint64_t size = 0;
+    for (const auto* buffer : frame->buf) {
+        if (buffer != nullptr) {
+            size += static_cast<uint64_t>(buffer->size);
+        }
+    }
+    return size;
+}
+} // namespace Ffr
@@ -0,0 +1,161 @@
+/**
+ * Copyright 2019 Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "FFFRScaler.h"
+
+#include "FFFRUtility.h"
+
+using namespace std;
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+namespace Ffr {
+Scaler::Scaler(const uint32_t inWidth, const uint32_t inHeight, const AVPixelFormat inFormat, const Resolution scale,
+    const PixelFormat format, const ScaleAlgorithm algorithm, const shared_ptr<FrameAllocator>& allocator) noexcept
+    : m_inWidth(inWidth)
+    , m_inHeight(inHeight)
+    , m_width(scale.m_width != 0 ? scale.m_width : inWidth)
+    , m_height(scale.m_height != 0 ? scale.m_height : inHeight)
+{
+    switch (algorithm) {
+        case ScaleAlgorithm::FastBilinear:
+            m_flags = SWS_FAST_BILINEAR;
+            break;
+        case ScaleAlgorithm::Area:
+            m_flags = SWS_AREA;
+            break;
+        case ScaleAlgorithm::Bicubic:
+            m_flags = SWS_BICUBIC;
+            break;
+        case ScaleAlgorithm::Lanczos:
+            m_flags = SWS_LANCZOS;
+            break;
+        default:
+            m_flags = SWS_BILINEAR;
+            break;
+    }
+    const auto outFormat = format != PixelFormat::Auto ? static_cast<AVPixelFormat>(format) : inFormat;
+
+    // Create an initial context to validate that the conversion is supported
+    SwsContext* context = sws_getCachedContext(nullptr, static_cast<int>(inWidth), static_cast<int>(inHeight),
+        inFormat, static_cast<int>(m_width), static_cast<int>(m_height), outFormat, m_flags, nullptr, nullptr, nullptr);
+    if (context == nullptr) {
+        logInternal(LogLevel::Info, "Direct scaling not supported for format: ", inFormat, " to ", outFormat);
+        return;
+    }
+    try {
+        m_contexts.push_back(context);
+        m_framePool = make_shared<FramePool>(allocator != nullptr ? allocator : make_shared<HostAllocator>());
+    } catch (...) {
+        logInternal(LogLevel::Error, "Failed to allocate scaler");
+        return;
+    }
+    m_format = outFormat;
+}
+
+Scaler::~Scaler() noexcept
+{
+    for (auto& i : m_contexts) {
+        sws_freeContext(i);
+    }
+}
+
+bool Scaler::scaleFrame(FramePtr& frame) noexcept
+{
+    // Each thread requires its own context so reuse any that are not currently in use
+    SwsContext* context = nullptr;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        if (!m_contexts.empty()) {
+            context = m_contexts.back();
+            m_contexts.pop_back();
+        }
+    }
+    // The cached context is only recreated if the input parameters have changed
+    context = sws_getCachedContext(context, frame->width, frame->height, static_cast<AVPixelFormat>(frame->format),
+        static_cast<int>(m_width), static_cast<int>(m_height), m_format, m_flags, nullptr, nullptr, nullptr);
+    if (context == nullptr) {
+        logInternal(LogLevel::Error, "Failed to create scaling context");
+        return false;
+    }
+
+    // Output the same full range as used by the filter graph
+    const int* coefficients = sws_getCoefficients(frame->colorspace);
+    sws_setColorspaceDetails(
+        context, coefficients, frame->color_range == AVCOL_RANGE_JPEG, coefficients, 1, 0, 1 << 16, 1 << 16);
+
+    FramePtr newFrame(av_frame_alloc());
+    bool ret = *newFrame != nullptr;
+    if (ret) {
+        newFrame->format = m_format;
+        newFrame->width = static_cast<int>(m_width);
+        newFrame->height = static_cast<int>(m_height);
+        ret = m_framePool->getBuffer(*newFrame);
+    } else {
+        logInternal(LogLevel::Error, "Failed to allocate new frame");
+    }
+    if (ret) {
+        sws_scale(context, frame->data, frame->linesize, 0, frame->height, newFrame->data, newFrame->linesize);
+        const auto ret2 = av_frame_copy_props(*newFrame, *frame);
+        if (ret2 < 0) {
+            logInternal(LogLevel::Error, "Failed to copy frame properties: ", getFfmpegErrorString(ret2));
+            ret = false;
+        }
+    }
+    {
+        lock_guard<mutex> lock(m_mutex);
+        try {
+            m_contexts.push_back(context);
+        } catch (...) {
+            sws_freeContext(context);
+        }
+    }
+    if (!ret) {
+        return false;
+    }
+    newFrame->color_range = AVCOL_RANGE_JPEG;
+    newFrame->sample_aspect_ratio = getSampleAspectRatio(frame->sample_aspect_ratio);
+    frame = move(newFrame);
+    return true;
+}
+
+uint32_t Scaler::getWidth() const noexcept
+{
+    return m_width;
+}
+
+uint32_t Scaler::getHeight() const noexcept
+{
+    return m_height;
+}
+
+AVPixelFormat Scaler::getPixelFormat() const noexcept
+{
+    return m_format;
+}
+
+AVRational Scaler::getSampleAspectRatio(const AVRational sampleAspectRatio) const noexcept
+{
+    if (sampleAspectRatio.num == 0) {
+        return sampleAspectRatio;
+    }
+    // Keep the same display aspect ratio in the same way as the scale filter
+    return av_mul_q(sampleAspectRatio,
+        av_make_q(static_cast<int>(m_height * m_inWidth), static_cast<int>(m_width * m_inHeight)));
+}
+} // namespace Ffr
@@ -15,29 +15,43 @@
  */
 #include "FFFRStream.h"
 
+#include "FFFRConvert.h"
 #include "FFFRDecoderContext.h"
 #include "FFFRFilter.h"
+#include "FFFRFramePool.h"
+#include "FFFRMemory.h"
+#include "FFFRScaler.h"
 #include "FFFRStreamUtils.h"
+#include "FFFRThreadPool.h"
 #include "FFFRUtility.h"
 #include "FFFrameReader.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <deque>
 #include <string>
+#include <thread>
 using namespace std;
 
 extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavfilter/buffersink.h>
 #include <libavformat/avformat.h>
+#include <libavutil/hwcontext.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/log.h>
 #include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
 }
 
 namespace Ffr {
-Stream::Stream(const std::string& fileName, uint32_t bufferLength, const uint32_t seekThreshold, bool noBufferFlush,
+Stream::Stream(const std::string& fileName, uint32_t bufferLength, const bool adaptiveBuffer, uint32_t minBufferLength,
+    uint32_t maxBufferLength, const uint32_t seekThreshold, bool noBufferFlush,
     const std::shared_ptr<DecoderContext>& decoderContext, const bool outputHost, Crop crop, const Resolution scale,
-    const PixelFormat format, ConstructorLock) noexcept
+    const ScaleMode scaleMode, const uint32_t padColour, const ScaleAlgorithm scaleAlgorithm,
+    const uint32_t filterThreads, const PixelFormat format, const std::shared_ptr<FrameAllocator>& allocator,
+    ConstructorLock) noexcept
 {
     // Open the input file
     AVFormatContext* formatPtr = nullptr;
@@ -68,6 +82,11 @@ Stream::Stream(const std::string& fileName, uint32_t bufferLength, const uint32_
     const auto inHeight = stream->codecpar->height;
     const auto inWidth = stream->codecpar->width;
     bufferLength = std::max(bufferLength, 1u);
+    minBufferLength = std::max(minBufferLength, 1u);
+    maxBufferLength = std::max(maxBufferLength, minBufferLength);
+    if (adaptiveBuffer) {
+        bufferLength = std::min(std::max(bufferLength, minBufferLength), maxBufferLength);
+    }
 
     // Check if any scaling/cropping is needed
     Resolution postScale = scale;
@@ -75,9 +94,37 @@ Stream::Stream(const std::string& fileName, uint32_t bufferLength, const uint32_
     if (cropRequired) {
         crop.m_left = std::min(crop.m_left, inWidth - crop.m_right - 1);
         crop.m_top = std::min(crop.m_top, inHeight - crop.m_bottom - 1);
+    }
+    uint32_t cropWidth = inWidth - crop.m_left - crop.m_right;
+    uint32_t cropHeight = inHeight - crop.m_top - crop.m_bottom;
+
+    // Letterboxing scales to fit within the requested resolution and then pads the remainder
+    Resolution pad = {0, 0};
+    Resolution padOffset = {0, 0};
+    Resolution fitted = {0, 0};
+    if (scaleMode == ScaleMode::Letterbox) {
+        if (scale.m_width == 0 || scale.m_height == 0) {
+            logInternal(LogLevel::Error, "Letterbox scaling requires both an output width and height: ", fileName);
+            return;
+        }
+        const double ratio = std::min(static_cast<double>(scale.m_width) / static_cast<double>(cropWidth),
+            static_cast<double>(scale.m_height) / static_cast<double>(cropHeight));
+        // Keep dimensions and offsets even so that chroma subsampled formats are correctly aligned
+        fitted.m_width = std::min(static_cast<uint32_t>(std::lround(cropWidth * ratio)) & ~1U, scale.m_width);
+        fitted.m_height = std::min(static_cast<uint32_t>(std::lround(cropHeight * ratio)) & ~1U, scale.m_height);
+        postScale = fitted;
+        if (fitted.m_width != scale.m_width || fitted.m_height != scale.m_height) {
+            pad = scale;
+            padOffset.m_width = ((scale.m_width - fitted.m_width) / 2) & ~1U;
+            padOffset.m_height = ((scale.m_height - fitted.m_height) / 2) & ~1U;
+        }
+    }
+    const bool padRequired = (pad.m_width != 0 || pad.m_height != 0);
+
+    if (cropRequired) {
         // Check if scale is actually required after the crop
-        const uint32_t width = inWidth - crop.m_left - crop.m_right;
-        const uint32_t height = inHeight - crop.m_top - crop.m_bottom;
+        const uint32_t width = cropWidth;
+        const uint32_t height = cropHeight;
         if (width == postScale.m_width) {
             postScale.m_width = 0;
         }
@@ -94,6 +141,10 @@ Stream::Stream(const std::string& fileName, uint32_t bufferLength, const uint32_
     bool scaleRequired = (postScale.m_height != 0 || postScale.m_width != 0);
 
     if (decoderContext.get() != nullptr) {
+        if (padRequired) {
+            logInternal(LogLevel::Error, "Letterbox scaling is not supported with hardware decoding: ", fileName);
+            return;
+        }
         if (decoderContext->getType() == DecodeType::Cuda && (cropRequired || scaleRequired)) {
             // Use cuvid decoder instead of nvdec hardware accel
             string cuvidName = decoder->name;
@@ -124,7 +175,8 @@ Stream::Stream(const std::string& fileName, uint32_t bufferLength, const uint32_
     }
 
     // Create a decoder context
-    CodecContextPtr tempCodec(avcodec_alloc_context3(decoder));
+    shared_ptr<FramePool> framePool = allocator != nullptr ? make_shared<FramePool>(allocator) : nullptr;
+    CodecContextPtr tempCodec(avcodec_alloc_context3(decoder), framePool);
     if (tempCodec.get() == nullptr) {
         logInternal(LogLevel::Error, "Failed allocating decoder context: ", fileName);
         return;
@@ -153,7 +205,7 @@ Stream::Stream(const std::string& fileName, uint32_t bufferLength, const uint32_
             return;
         }
         // Enable extra hardware frames to ensure we don't run out of buffers
-        tempCodec->extra_hw_frames = static_cast<int32_t>(bufferLength + 1);
+        tempCodec->extra_hw_frames = static_cast<int32_t>((adaptiveBuffer ? maxBufferLength : bufferLength) + 1);
         if (decoderContext->getType() == DecodeType::Cuda && (cropRequired || scaleRequired)) {
             // Use internal cuvid filtering capabilities
             if (scaleRequired) {
@@ -173,6 +225,13 @@ Stream::Stream(const std::string& fileName, uint32_t bufferLength, const uint32_
         }
     } else {
         av_dict_set(&opts, "threads", "auto", 0);
+        if (framePool != nullptr) {
+            // Decode directly into the user provided memory
+            tempCodec->opaque = framePool.get();
+            tempCodec->get_buffer2 = FramePool::getBuffer2;
+            // The callback locks the pool internally so frame threads can call it concurrently
+            tempCodec->thread_safe_callbacks = 1;
+        }
     }
     ret = avcodec_open2(tempCodec.get(), decoder, &opts);
     if (ret < 0) {
@@ -184,8 +243,12 @@ Stream::Stream(const std::string& fileName, uint32_t bufferLength, const uint32_
     const AVPixelFormat inFormat = tempCodec->sw_pix_fmt == AV_PIX_FMT_NONE ?
         static_cast<AVPixelFormat>(tempFormat->streams[index]->codecpar->format) :
         tempCodec->sw_pix_fmt;
-    const bool formatRequired =
-        (format != PixelFormat::Auto && format != Ffr::getPixelFormat(static_cast<AVPixelFormat>(inFormat)));
+    // Luma only output from host YUV frames can use the luma plane directly and only needs filtering for any
+    // remaining conversions
+    const bool lumaOnly = (format == PixelFormat::GRAY8 || format == PixelFormat::GRAY32F) &&
+        (decoderContext.get() == nullptr || outputHost) && StreamUtils::hasLumaPlane(inFormat);
+    bool formatRequired = (format != PixelFormat::Auto &&
+        format != (lumaOnly ? PixelFormat::GRAY8 : Ffr::getPixelFormat(static_cast<AVPixelFormat>(inFormat))));
 
     // Check if the pixel format is a known format
     if (Ffr::getPixelFormat(static_cast<AVPixelFormat>(inFormat)) == PixelFormat::Auto) {
@@ -193,10 +256,57 @@ Stream::Stream(const std::string& fileName, uint32_t bufferLength, const uint32_
         return;
     }
 
+    // Cropping can be performed by offsetting into the decoded frames without any copy (unless the output must be
+    // allocated by a user provided allocator)
+    Crop alignedCrop = crop;
+    bool nativeCropSupported = false;
+    if (cropRequired && !padRequired && decoderContext.get() == nullptr) {
+        const auto* const descriptor = av_pix_fmt_desc_get(lumaOnly ? AV_PIX_FMT_GRAY8 : inFormat);
+        if (descriptor != nullptr && !(descriptor->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))) {
+            // Align to the chroma subsampling in the same way as the crop filter
+            const uint32_t maskX = (1U << descriptor->log2_chroma_w) - 1;
+            const uint32_t maskY = (1U << descriptor->log2_chroma_h) - 1;
+            alignedCrop.m_left &= ~maskX;
+            alignedCrop.m_top &= ~maskY;
+            alignedCrop.m_right = inWidth - alignedCrop.m_left - (cropWidth & ~maskX);
+            alignedCrop.m_bottom = inHeight - alignedCrop.m_top - (cropHeight & ~maskY);
+            nativeCropSupported = true;
+        }
+    }
+
+    // Scaling and format conversion of host frames can be performed directly without a filter graph
+    shared_ptr<Scaler> scaler = nullptr;
+    if ((scaleRequired || formatRequired) && !padRequired && decoderContext.get() == nullptr &&
+        (!cropRequired || nativeCropSupported)) {
+        const Crop& scalerCrop = cropRequired ? alignedCrop : crop;
+        scaler = make_shared<Scaler>(inWidth - scalerCrop.m_left - scalerCrop.m_right,
+            inHeight - scalerCrop.m_top - scalerCrop.m_bottom, lumaOnly ? AV_PIX_FMT_GRAY8 : inFormat, postScale,
+            format, scaleAlgorithm, allocator);
+        if (scaler->getPixelFormat() != AV_PIX_FMT_NONE) {
+            scaleRequired = false;
+            formatRequired = false;
+            logInternal(
+                LogLevel::Info, "Stream- Using direct scaling: ", scaler->getWidth(), ", ", scaler->getHeight());
+        } else {
+            scaler = nullptr;
+        }
+    }
+
+    bool nativeCrop = false;
+    if (nativeCropSupported && !scaleRequired && !formatRequired) {
+        crop = alignedCrop;
+        cropWidth = inWidth - crop.m_left - crop.m_right;
+        cropHeight = inHeight - crop.m_top - crop.m_bottom;
+        cropRequired = false;
+        nativeCrop = true;
+        logInternal(LogLevel::Info, "Stream- Using native cropping: ", crop.m_top, ", ", crop.m_left);
+    }
+
     // Add any required filter stages
-    if (scaleRequired || cropRequired || formatRequired) {
+    if (scaleRequired || cropRequired || padRequired || formatRequired) {
         // Create a new filter object
-        shared_ptr<Filter> filter = make_shared<Filter>(postScale, crop, format, tempFormat, index, tempCodec);
+        shared_ptr<Filter> filter = make_shared<Filter>(postScale, crop, pad, padOffset, padColour, scaleAlgorithm,
+            filterThreads, format, lumaOnly, tempFormat, index, tempCodec);
         if (filter->m_filterGraph.get() == nullptr) {
             // filter creation failed
             return;
@@ -206,6 +316,9 @@ Stream::Stream(const std::string& fileName, uint32_t bufferLength, const uint32_
 
     // Make the new stream
     m_bufferLength = bufferLength;
+    m_adaptiveBuffer = adaptiveBuffer;
+    m_minBufferLength = minBufferLength;
+    m_maxBufferLength = maxBufferLength;
     m_outputHost = outputHost && (decoderContext.get() != nullptr);
     m_formatContext = move(tempFormat);
     m_index = index;
@@ -213,20 +326,37 @@ Stream::Stream(const std::string& fileName, uint32_t bufferLength, const uint32_
     m_seekThreshold = seekThreshold;
     m_noBufferFlush = noBufferFlush && (decoderContext.get() != nullptr);
     m_frameSeekSupported = m_formatContext->iformat->read_seek2 != nullptr;
+    m_memoryTracker = make_shared<MemoryTracker>();
+    m_framePool = move(framePool);
+    m_lumaOnly = lumaOnly;
+    m_scaler = move(scaler);
+    if (nativeCrop) {
+        m_crop = crop;
+    }
+
+    // Determine the mapping from source frame coordinates to output coordinates
+    const double scaledWidth = padRequired ? fitted.m_width : getWidth();
+    const double scaledHeight = padRequired ? fitted.m_height : getHeight();
+    m_outputTransform.m_scaleX = scaledWidth / static_cast<double>(cropWidth);
+    m_outputTransform.m_scaleY = scaledHeight / static_cast<double>(cropHeight);
+    m_outputTransform.m_offsetX = padOffset.m_width - crop.m_left * m_outputTransform.m_scaleX;
+    m_outputTransform.m_offsetY = padOffset.m_height - crop.m_top * m_outputTransform.m_scaleY;
 
     // Ensure ping/pong buffers are long enough to handle the maximum number of frames a video may require
-    const uint32_t minFrames = std::max(static_cast<uint32_t>(m_seekThreshold), m_bufferLength);
+    const uint32_t minFrames =
+        std::max(static_cast<uint32_t>(m_seekThreshold), m_adaptiveBuffer ? m_maxBufferLength : m_bufferLength);
 
     // Allocate ping and pong buffers
     m_bufferPing.reserve(static_cast<size_t>(minFrames) * 2);
     m_bufferPong.reserve(static_cast<size_t>(minFrames) * 2);
 
     // Determine actual stream start time
-    m_startTimeStamp = getStreamStartTime();
+    avcodec_flush_buffers(m_codecContext.get());
+    m_startTimeStamp = GetStreamStartTime(m_formatContext, m_index, getCodecDelay());
     m_startTimeStamp2 = timeStampToTimeStamp2(m_startTimeStamp);
 
     // Set stream start time and numbers of frames (done here to ensure correct start timestamp)
-    const auto params = getStreamFramesDuration();
+    const auto params = GetStreamFramesDuration(m_formatContext, m_index, m_startTimeStamp);
     m_totalFrames = params.first;
     m_totalDuration = params.second;
 
@@ -234,24 +364,30 @@ Stream::Stream(const std::string& fileName, uint32_t bufferLength, const uint32_
     av_seek_frame(m_formatContext.get(), m_index, m_startTimeStamp, AVSEEK_FLAG_BACKWARD);
 
     logInternal(LogLevel::Info, "Stream- Stream created with parameters: bufferLength=", m_bufferLength,
-        ", seekThreshold=", m_seekThreshold, ", noBufferFlush=", m_noBufferFlush);
+        ", adaptiveBuffer=", m_adaptiveBuffer, ", seekThreshold=", m_seekThreshold, ", noBufferFlush=",
+        m_noBufferFlush);
 }
 
 bool Stream::initialise() noexcept
 {
     // Decode the first frame (must be done to ensure codec parameters are properly filled)
-    const auto backup = m_bufferLength;
+    m_savedBufferLength = m_bufferLength;
     m_bufferLength = 1;
-    if (peekNextFrame() == nullptr) {
-        m_bufferLength = backup;
+    const bool valid = peekNextFrame() != nullptr;
+    m_bufferLength = m_savedBufferLength;
+    m_savedBufferLength = 0;
+    if (!valid) {
         return false;
     }
-    m_bufferLength = backup;
     // Check if the first element in the buffer does not match our start time
-    const auto startTime = m_bufferPing.front()->m_frame->best_effort_timestamp;
+    const auto startTime = m_bufferPing.at(m_bufferPingHead)->m_frame->best_effort_timestamp;
     if (startTime != 0) {
         // Loop through all current frames and fix the time stamps
         for (auto& i : m_bufferPing) {
+            if (i == nullptr) {
+                // Skip any invalid frames that were dropped during processing
+                continue;
+            }
             i->m_frame->best_effort_timestamp -= startTime;
             i->m_frame->pts -= startTime;
             i->m_timeStamp = timeStampToTime2(i->m_frame->best_effort_timestamp);
@@ -269,7 +405,12 @@ bool Stream::initialise() noexcept
     m_totalFrames -= timeStampToFrameNoOffset(m_startTimeStamp);
     m_totalDuration -= timeStampToTimeNoOffset(m_startTimeStamp);
 
-    m_seekThreshold = frameToTimeStamp2(m_seekThreshold == 0 ? getSeekThreshold() : m_seekThreshold);
+    // Intra-only streams can seek directly to any frame so only the next frame is forward decoded
+    m_intraOnly = DetectIntraOnly(m_formatContext, m_index);
+    if (m_seekThreshold == 0) {
+        m_seekThreshold = m_intraOnly ? 1 : getSeekThreshold();
+    }
+    m_seekThreshold = frameToTimeStamp2(m_seekThreshold);
     logInternal(LogLevel::Info, "initialise - Using final seek threshold: ", m_seekThreshold);
     return true;
 }
@@ -288,13 +429,16 @@ shared_ptr<Stream> Stream::getStream(const string& fileName, const DecoderOption
 
     // Create the new stream
     const bool outputHost = options.m_outputHost && (options.m_type != DecodeType::Software);
-    shared_ptr<Stream> stream =
-        make_shared<Stream>(fileName, options.m_bufferLength, options.m_seekThreshold, options.m_noBufferFlush,
-            deviceContext, outputHost, options.m_crop, options.m_scale, options.m_format, ConstructorLock());
+    shared_ptr<Stream> stream = make_shared<Stream>(fileName, options.m_bufferLength, options.m_adaptiveBuffer,
+        options.m_minBufferLength, options.m_maxBufferLength, options.m_seekThreshold, options.m_noBufferFlush,
+        deviceContext, outputHost, options.m_crop, options.m_scale, options.m_scaleMode, options.m_padColour,
+        options.m_scaleAlgorithm, options.m_filterThreads, options.m_format,
+        options.m_allocator, ConstructorLock());
     if (stream->m_codecContext.get() == nullptr) {
         // Stream creation failed
         return nullptr;
     }
+    stream->m_options = options;
 
     // Initialise stream data
     if (!stream->initialise()) {
@@ -309,7 +453,10 @@ uint32_t Stream::getWidth() const noexcept
     if (m_filterGraph.get() != nullptr) {
         return m_filterGraph->getWidth();
     }
-    return m_codecContext->width;
+    if (m_scaler.get() != nullptr) {
+        return m_scaler->getWidth();
+    }
+    return m_codecContext->width - m_crop.m_left - m_crop.m_right;
 }
 
 uint32_t Stream::getHeight() const noexcept
@@ -317,7 +464,10 @@ uint32_t Stream::getHeight() const noexcept
     if (m_filterGraph.get() != nullptr) {
         return m_filterGraph->getHeight();
     }
-    return m_codecContext->height;
+    if (m_scaler.get() != nullptr) {
+        return m_scaler->getHeight();
+    }
+    return m_codecContext->height - m_crop.m_top - m_crop.m_bottom;
 }
 
 double Stream::getAspectRatio() const noexcept
@@ -354,6 +504,19 @@ uint32_t Stream::getFrameSize() const noexcept
     return av_image_get_buffer_size(StreamUtils::getPixelFormat(this), getWidth(), getHeight(), 32);
 }
 
+OutputTransform Stream::getOutputTransform() const noexcept
+{
+    return m_outputTransform;
+}
+
+FilterStatistics Stream::getFilterStatistics() const noexcept
+{
+    if (m_filterGraph.get() == nullptr) {
+        return FilterStatistics();
+    }
+    return m_filterGraph->getStatistics();
+}
+
 DecodeType Stream::getDecodeType() const noexcept
 {
     if (m_codecContext->pix_fmt == AV_PIX_FMT_CUDA) {
@@ -362,24 +525,66 @@ DecodeType Stream::getDecodeType() const noexcept
     return DecodeType::Software;
 }
 
+uint64_t Stream::getMemoryUsage() const noexcept
+{
+    lock_guard<recursive_mutex> lock(m_mutex);
+    // Frames held by any additional decoder instances belong to this stream
+    uint64_t usage = m_memoryTracker->getUsage();
+    for (const auto& i : m_decoders) {
+        if (i != nullptr) {
+            usage += i->getMemoryUsage();
+        }
+    }
+    return usage;
+}
+
 shared_ptr<Frame> Stream::peekNextFrame() noexcept
 {
     lock_guard<recursive_mutex> lock(m_mutex);
-    // Check if we actually have any frames in the current buffer
-    if (m_bufferPingHead >= m_bufferPing.size()) {
-        // TODO: Async decode of next block, should start once reached the last couple of frames in a buffer
-        // The swap buffer only should occur when ping buffer is exhausted and pong decode has completed
-        if (!decodeNextBlock()) {
-            return nullptr;
+    while (true) {
+        // Check if we actually have any frames in the current buffer
+        if (m_bufferPingHead >= m_bufferPing.size()) {
+            // TODO: Async decode of next block, should start once reached the last couple of frames in a buffer
+            // The swap buffer only should occur when ping buffer is exhausted and pong decode has completed
+            const bool sequential = !m_bufferPing.empty();
+            if (sequential) {
+                // The previous block was consumed sequentially
+                adaptBufferLength(true);
+            }
+            if (!decodeNextBlock()) {
+                return nullptr;
+            }
+            // Check if there are any new frames or we reached EOF
+            if (m_bufferPing.size() == 0) {
+                logInternal(LogLevel::Warning, "Cannot get a new frame, End of file has been reached");
+                return nullptr;
+            }
+            // The new block is likely to also be fully consumed so it can be processed up front
+            if (sequential && m_scaler != nullptr && m_filterGraph == nullptr && !processFramesParallel()) {
+                return nullptr;
+            }
+        }
+        // Get frame from ping buffer
+        auto ret = m_bufferPing.at(m_bufferPingHead);
+        if (!ret->m_pending) {
+            return ret;
         }
-        // Check if there are any new frames or we reached EOF
-        if (m_bufferPing.size() == 0) {
-            logInternal(LogLevel::Warning, "Cannot get a new frame, End of file has been reached");
+
+        // Perform any required filtering now that the frame is actually needed
+        if (!processFrame(ret->m_frame)) {
+            popFrame();
             return nullptr;
         }
+        ret->m_pending = false;
+        if (ret->m_frame->height != 0) {
+            // Filtering may have changed the frames memory requirements
+            ret->m_memory.update(MemoryTracker::getFrameMemory(*ret->m_frame));
+            return ret;
+        }
+        LOG_DEBUG("peekNextFrame- Dropping invalid frame: ", ret->m_frame->best_effort_timestamp, ", ",
+            ret->getTimeStamp());
+        popFrame();
     }
-    // Get frame from ping buffer
-    return m_bufferPing.at(m_bufferPingHead);
 }
 
 shared_ptr<Frame> Stream::getNextFrame() noexcept
@@ -428,80 +633,54 @@ vector<std::shared_ptr<Frame>> Stream::getFrames(const vector<int64_t>& frameSeq
 {
     lock_guard<recursive_mutex> lock(m_mutex);
     vector<shared_ptr<Frame>> ret;
-    const auto bufferBackup = m_bufferLength;
-    for (auto i = frameSequence.cbegin(); i < frameSequence.cend(); ++i) {
-        // Max number of frames that can be reliably held at any point in time is equal to buffer length
-        if (ret.size() >= bufferBackup) {
-            break;
-        }
-        if (m_bufferPingHead >= m_bufferPing.size()) {
-            // Set buffer length based on remaining frames
-            int64_t maxFound = *i;
-            for (auto j = i + 1; j < frameSequence.cend(); ++j) {
-                const auto range = timeToFrame(*j - *i);
-                if (range < m_seekThreshold &&
-                    range < static_cast<int64_t>(bufferBackup) - static_cast<int64_t>(ret.size())) {
-                    maxFound = *j;
-                } else {
-                    break;
-                }
-            }
-            m_bufferLength = std::max(static_cast<uint32_t>(timeToFrame(maxFound - *i)), uint32_t{1});
-            logInternal(LogLevel::Info, "getFrames- Temporarily increasing buffer length: ", m_bufferLength);
-        }
-        // Use seek function as that will determine if seek or just a forward decode is needed
-        if (!seek(*i)) {
-            break;
-        }
-        auto frame = getNextFrame();
-        if (frame == nullptr) {
-            break;
-        }
+    // Max number of frames that can be reliably held at any point in time is equal to buffer length
+    getFramesInternal(frameSequence, false, m_bufferLength, [&ret](shared_ptr<Frame>& frame) {
         ret.emplace_back(move(frame));
-    }
-    m_bufferLength = bufferBackup;
+        return true;
+    });
     return ret;
 }
 
 vector<std::shared_ptr<Frame>> Stream::getFramesByIndex(const vector<int64_t>& frameSequence) noexcept
 {
     lock_guard<recursive_mutex> lock(m_mutex);
-    vector<shared_ptr<Frame>> ret;
-    const auto bufferBackup = m_bufferLength;
-    for (auto i = frameSequence.cbegin(); i < frameSequence.cend(); ++i) {
-        // Max number of frames that can be reliable held at any point in time is equal to buffer length
-        if (ret.size() >= bufferBackup) {
-            break;
+    if (m_intraOnly) {
+        // Every frame is independent so the sequence can be split across multiple decoders
+        auto instances = m_options.m_decodeInstances;
+        if (instances == 0) {
+            instances = std::min(thread::hardware_concurrency(), s_maxDecodeInstances);
         }
-        if (m_bufferPingHead >= m_bufferPing.size()) {
-            // Set buffer length based on remaining frames
-            int64_t maxFound = *i;
-            for (auto j = i + 1; j < frameSequence.cend(); ++j) {
-                const auto range = *j - *i;
-                if (range < m_seekThreshold &&
-                    range < static_cast<int64_t>(bufferBackup) - static_cast<int64_t>(ret.size())) {
-                    maxFound = *j;
-                } else {
-                    break;
-                }
-            }
-            m_bufferLength = std::max(static_cast<uint32_t>(timeToFrame(maxFound - *i)), uint32_t{1});
-            LOG_DEBUG("getFramesByIndex- Temporarily increasing buffer length: ", m_bufferLength);
-        }
-        // Use seek function as that will determine if seek or just a forward decode is needed
-        if (!seekFrame(*i)) {
-            break;
-        }
-        auto frame = getNextFrame();
-        if (frame == nullptr) {
-            break;
+        instances = static_cast<uint32_t>(std::min({static_cast<size_t>(instances), frameSequence.size(),
+            static_cast<size_t>(m_bufferLength)}));
+        if (instances > 1) {
+            return getFramesByIndexConcurrent(frameSequence, instances);
         }
-        ret.emplace_back(move(frame));
     }
-    m_bufferLength = bufferBackup;
+    vector<shared_ptr<Frame>> ret;
+    getFramesInternal(frameSequence, true, m_bufferLength, [&ret](shared_ptr<Frame>& frame) {
+        ret.emplace_back(move(frame));
+        return true;
+    });
     return ret;
 }
 
+uint32_t Stream::getFramesTensor(const vector<int64_t>& frameSequence, uint8_t* outMem, const PixelFormat format,
+    const TensorLayout layout, const TensorType type, const ConvertOptions& options) noexcept
+{
+    return getFramesTensorInternal(frameSequence, false, outMem, format, layout, type, options);
+}
+
+uint32_t Stream::getFramesByIndexTensor(const vector<int64_t>& frameSequence, uint8_t* outMem,
+    const PixelFormat format, const TensorLayout layout, const TensorType type, const ConvertOptions& options) noexcept
+{
+    return getFramesTensorInternal(frameSequence, true, outMem, format, layout, type, options);
+}
+
+bool Stream::isIntraOnly() const noexcept
+{
+    return m_intraOnly;
+}
+
 bool Stream::isEndOfFile() const noexcept
 {
     return timeStampToFrame2(m_lastDecodedTimeStamp) + 1 >= getTotalFrames();
@@ -565,6 +744,7 @@ bool Stream::seek(const int64_t timeStamp) noexcept
         logInternal(LogLevel::Error, "Failed seeking to specified time stamp ", timeStamp, getFfmpegErrorString(err));
         return false;
     }
+    adaptBufferLength(false);
 
     // Decode the next block of frames
     return decodeNextBlock(timeStamp2, true);
@@ -632,6 +812,7 @@ bool Stream::seekFrame(const int64_t frame) noexcept
         logInternal(LogLevel::Error, "Failed to seek to specified frame ", frame, ": ", getFfmpegErrorString(err));
         return false;
     }
+    adaptBufferLength(false);
 
     // Decode the next block of frames
     return decodeNextBlock(timeStamp2, true);
@@ -647,6 +828,108 @@ int64_t Stream::timeToFrame(const int64_t time) const noexcept
     return av_rescale_q(time, av_make_q(1, AV_TIME_BASE), av_inv_q(m_formatContext->streams[m_index]->r_frame_rate));
 }
 
+vector<PacketInfo> Stream::scanPackets() const noexcept
+{
+    return scanStreamPackets(m_formatContext->url, m_startTimeStamp);
+}
+
+vector<PacketInfo> Stream::scanPackets(const string& fileName) noexcept
+{
+    return scanStreamPackets(fileName, INT64_MIN);
+}
+
+StreamInfo Stream::probe(const string& fileName, const int64_t probeSize, const int64_t analyzeDuration) noexcept
+{
+    StreamInfo ret;
+    // Only the demuxer is opened, stream properties are taken from the container and codec parameters
+    AVDictionary* options = nullptr;
+    if (probeSize > 0) {
+        av_dict_set_int(&options, "probesize", probeSize, 0);
+    }
+    if (analyzeDuration > 0) {
+        av_dict_set_int(&options, "analyzeduration", analyzeDuration, 0);
+    }
+    AVFormatContext* formatPtr = nullptr;
+    auto err = avformat_open_input(&formatPtr, fileName.c_str(), nullptr, &options);
+    av_dict_free(&options);
+    FormatContextPtr formatContext(formatPtr);
+    if (err < 0) {
+        logInternal(LogLevel::Error, "Failed to open input stream: ", fileName, ", ", getFfmpegErrorString(err));
+        return ret;
+    }
+    err = avformat_find_stream_info(formatContext.get(), nullptr);
+    if (err < 0) {
+        logInternal(LogLevel::Error, "Failed finding stream information: ", fileName, ", ", getFfmpegErrorString(err));
+        return ret;
+    }
+    err = av_find_best_stream(formatContext.get(), AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (err < 0) {
+        logInternal(
+            LogLevel::Error, "Failed to find video stream in file: ", fileName, ", ", getFfmpegErrorString(err));
+        return ret;
+    }
+    const int32_t index = err;
+    const AVStream* const stream = formatContext->streams[index];
+    const AVCodecParameters* const parameters = stream->codecpar;
+
+    ret.m_width = static_cast<uint32_t>(parameters->width);
+    ret.m_height = static_cast<uint32_t>(parameters->height);
+    if (parameters->sample_aspect_ratio.num != 0) {
+        ret.m_aspectRatio =
+            av_q2d(av_mul_q(av_make_q(parameters->width, parameters->height), parameters->sample_aspect_ratio));
+    } else if (parameters->height != 0) {
+        ret.m_aspectRatio = static_cast<double>(parameters->width) / static_cast<double>(parameters->height);
+    }
+    ret.m_format = Ffr::getPixelFormat(StreamUtils::getPixelFormat(static_cast<AVPixelFormat>(parameters->format)));
+    ret.m_frameRate = av_q2d(stream->r_frame_rate);
+    ret.m_codec = avcodec_get_name(parameters->codec_id);
+    ret.m_intraOnly = DetectIntraOnly(formatContext, index);
+
+    // Determine frames and duration using the same methods as a full stream. Without a decoder the delay is
+    // estimated from the codec parameters.
+    for (uint32_t i = 0; i < formatContext->nb_streams; ++i) {
+        if (static_cast<int32_t>(i) != index) {
+            formatContext->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+    const int64_t startTimeStamp = GetStreamStartTime(formatContext, index, std::max(parameters->video_delay, 1));
+    const auto params = GetStreamFramesDuration(formatContext, index, startTimeStamp);
+    if (params.first == INT64_MIN || params.second == INT64_MIN) {
+        logInternal(LogLevel::Error, "Failed to determine number of frames in stream: ", fileName);
+        return ret;
+    }
+    // Correct for the start time in the same way as a stream
+    ret.m_totalFrames =
+        params.first - av_rescale_q(startTimeStamp, stream->time_base, av_inv_q(stream->r_frame_rate));
+    ret.m_duration = params.second - av_rescale_q(startTimeStamp, stream->time_base, av_make_q(1, AV_TIME_BASE));
+    ret.m_valid = true;
+    return ret;
+}
+
+vector<StreamInfo> Stream::probe(
+    const vector<string>& fileNames, const int64_t probeSize, const int64_t analyzeDuration) noexcept
+{
+    // Each file is independent so they can all be probed at once
+    vector<StreamInfo> ret(fileNames.size());
+    auto pool = ThreadPool::getThreadPool();
+    vector<future<bool>> tasks;
+    for (size_t i = 0; i < fileNames.size(); ++i) {
+        try {
+            tasks.emplace_back(pool->push([&ret, &fileNames, i, probeSize, analyzeDuration]() {
+                ret[i] = probe(fileNames[i], probeSize, analyzeDuration);
+                return ret[i].m_valid;
+            }));
+        } catch (...) {
+            // Probe on the calling thread if the task could not be queued
+            ret[i] = probe(fileNames[i], probeSize, analyzeDuration);
+        }
+    }
+    for (auto& i : tasks) {
+        i.wait();
+    }
+    return ret;
+}
+
 int64_t Stream::timeToTimeStamp(const int64_t time) const noexcept
 {
     static_assert(AV_TIME_BASE == 1000000, "FFmpeg internal time_base does not match expected value");
@@ -740,6 +1023,7 @@ bool Stream::decodeNextBlock(int64_t flushTillTime, bool seeking) noexcept
     // Clean out current buffer and release any frames it may still hold
     m_bufferPing.resize(0);
     m_bufferPingHead = 0;
+    m_memoryLimited = false;
 
     // Decode the next buffer sequence
     AVPacket packet;
@@ -828,12 +1112,16 @@ bool Stream::decodeNextBlock(int64_t flushTillTime, bool seeking) noexcept
 
         // TODO: The maximum number of frames that are needed to get a valid frame is calculated using getCodecDelay().
         // If more than that are passed without a returned frame then an error has occured (ignoring flushTillTime).
-    } while ((m_bufferPong.size() < m_bufferLength || flushTillTime >= 0) && !eof);
+    } while ((!isBufferFull() || flushTillTime >= 0) && !eof);
 
     if (!processFrames()) {
         return false;
     }
 
+    if (m_memoryLimited) {
+        adaptBufferLength(false);
+    }
+
     if (eof) {
         // Check if we got more frames than we should have. This occurs when there are missing frames that are
         // padded in resulting in more output frames than expected.
@@ -977,13 +1265,244 @@ bool Stream::decodeNextFrames(int64_t& flushTillTime) noexcept
         }
 
         // Add the new frame to the pong buffer
-        m_bufferPong.emplace_back(
-            make_shared<Frame>(m_tempFrame, timeStamp, frameNum, m_formatContext, m_codecContext));
-    } while (m_bufferPong.size() < m_bufferLength || flushAllFrames);
+        addFrame(m_tempFrame, timeStamp, frameNum, m_bufferPong.end());
+    } while (!isBufferFull() || flushAllFrames);
 
     return true;
 }
 
+void Stream::adaptBufferLength(const bool grow) noexcept
+{
+    if (!m_adaptiveBuffer) {
+        return;
+    }
+    // Don't modify a temporary override as it will be restored anyway
+    auto& bufferLength = m_savedBufferLength != 0 ? m_savedBufferLength : m_bufferLength;
+    const auto newLength =
+        grow ? std::min(bufferLength * 2, m_maxBufferLength) : std::max(bufferLength / 2, m_minBufferLength);
+    if (newLength != bufferLength) {
+        LOG_DEBUG("adaptBufferLength- Changing buffer length: ", bufferLength, " to ", newLength);
+        bufferLength = newLength;
+    }
+}
+
+bool Stream::isBufferFull() noexcept
+{
+    if (m_bufferPong.size() >= m_bufferLength || m_memoryLimited) {
+        return true;
+    }
+    // Stop decoding ahead if the memory budget is exhausted, as long as there is at least one frame to return
+    if (!m_bufferPong.empty() && !MemoryTracker::waitForBudget()) {
+        LOG_DEBUG("isBufferFull- Memory budget exceeded, limiting decode block: ", m_bufferPong.size());
+        m_memoryLimited = true;
+        return true;
+    }
+    return false;
+}
+
+uint32_t Stream::getFramesInternal(const vector<int64_t>& frameSequence, const bool byIndex, const uint32_t maxFrames,
+    const function<bool(shared_ptr<Frame>&)>& callback) noexcept
+{
+    lock_guard<recursive_mutex> lock(m_mutex);
+    uint32_t found = 0;
+    const auto bufferBackup = m_bufferLength;
+    m_savedBufferLength = m_bufferLength;
+    for (auto i = frameSequence.cbegin(); i < frameSequence.cend(); ++i) {
+        if (found >= maxFrames) {
+            break;
+        }
+        if (m_bufferPingHead >= m_bufferPing.size()) {
+            // Set buffer length based on remaining frames
+            int64_t maxFound = *i;
+            const auto remaining = static_cast<int64_t>(std::min(bufferBackup, maxFrames - found));
+            for (auto j = i + 1; j < frameSequence.cend(); ++j) {
+                const auto range = byIndex ? *j - *i : timeToFrame(*j - *i);
+                if (range < m_seekThreshold && range < remaining) {
+                    maxFound = *j;
+                } else {
+                    break;
+                }
+            }
+            const auto range = byIndex ? maxFound - *i : timeToFrame(maxFound - *i);
+            m_bufferLength = std::max(static_cast<uint32_t>(range), uint32_t{1});
+            LOG_DEBUG("getFramesInternal- Temporarily increasing buffer length: ", m_bufferLength);
+        }
+        // Use seek function as that will determine if seek or just a forward decode is needed
+        if (!(byIndex ? seekFrame(*i) : seek(*i))) {
+            break;
+        }
+        auto frame = getNextFrame();
+        if (frame == nullptr) {
+            break;
+        }
+        ++found;
+        if (!callback(frame)) {
+            break;
+        }
+    }
+    m_bufferLength = m_savedBufferLength;
+    m_savedBufferLength = 0;
+    return found;
+}
+
+vector<shared_ptr<Frame>> Stream::getFramesByIndexConcurrent(
+    const vector<int64_t>& frameSequence, uint32_t instances) noexcept
+{
+    // Max number of frames that can be reliably held at any point in time is equal to buffer length
+    const auto count = std::min(frameSequence.size(), static_cast<size_t>(m_bufferLength));
+    const auto chunkSize = (count + instances - 1) / instances;
+    instances = static_cast<uint32_t>((count + chunkSize - 1) / chunkSize);
+    if (m_decoders.size() < instances - 1) {
+        m_decoders.resize(instances - 1);
+    }
+    LOG_DEBUG("getFramesByIndexConcurrent- Using decoder instances: ", instances);
+
+    // Each chunk of the sequence is decoded in order by a single decoder
+    vector<vector<shared_ptr<Frame>>> results(instances);
+    const auto decodeChunk = [&](const uint32_t chunk) {
+        const auto first = frameSequence.cbegin() + static_cast<ptrdiff_t>(chunk * chunkSize);
+        const auto last = frameSequence.cbegin() + static_cast<ptrdiff_t>(std::min((chunk + 1) * chunkSize, count));
+        const vector<int64_t> sequence(first, last);
+        if (chunk == 0) {
+            getFramesInternal(sequence, true, m_bufferLength, [&results](shared_ptr<Frame>& frame) {
+                results[0].emplace_back(move(frame));
+                return true;
+            });
+            return;
+        }
+        auto& decoder = m_decoders[chunk - 1];
+        if (decoder == nullptr) {
+            // Additional decoders are created on first use and then kept for subsequent calls
+            auto options = m_options;
+            options.m_decodeInstances = 1;
+            decoder = getStream(m_formatContext->url, options);
+            if (decoder == nullptr) {
+                logInternal(LogLevel::Error, "Failed to create additional decoder instance");
+                return;
+            }
+        }
+        results[chunk] = decoder->getFramesByIndex(sequence);
+    };
+
+    vector<thread> threads;
+    uint32_t started = 1;
+    try {
+        threads.reserve(instances - 1);
+        for (; started < instances; ++started) {
+            threads.emplace_back(decodeChunk, started);
+        }
+    } catch (...) {
+        logInternal(LogLevel::Warning, "Failed to create decoder threads, decoding remaining frames sequentially");
+    }
+    decodeChunk(0);
+    for (auto i = started; i < instances; ++i) {
+        decodeChunk(i);
+    }
+    for (auto& i : threads) {
+        i.join();
+    }
+
+    // Only frames before the first failed chunk are returned
+    vector<shared_ptr<Frame>> ret;
+    ret.reserve(count);
+    for (uint32_t i = 0; i < instances; ++i) {
+        const auto expected = std::min((i + 1) * chunkSize, count) - i * chunkSize;
+        move(results[i].begin(), results[i].end(), back_inserter(ret));
+        if (results[i].size() < expected) {
+            break;
+        }
+    }
+
+    // Only the first chunk was decoded by this stream, so move it to just after the last returned frame in the same
+    // way as a sequential retrieval
+    if (ret.size() > results[0].size() && seekFrame(ret.back()->getFrameNumber())) {
+        popFrame();
+    }
+    return ret;
+}
+
+uint32_t Stream::getFramesTensorInternal(const vector<int64_t>& frameSequence, const bool byIndex,
+    uint8_t* const outMem, const PixelFormat format, const TensorLayout layout, const TensorType type,
+    const ConvertOptions& options) noexcept
+{
+    if (outMem == nullptr) {
+        logInternal(LogLevel::Error, "Invalid tensor memory");
+        return 0;
+    }
+    // Frames in device memory are converted using cuda which only supports half precision tensors
+    const bool device = getDecodeType() != DecodeType::Software && !m_outputHost;
+    if (device && type != TensorType::Float16) {
+        logInternal(LogLevel::Error, "Tensor output of frames in device memory requires the Float16 tensor type");
+        return 0;
+    }
+    const auto frameSize = getTensorSize(format, getWidth(), getHeight(), 1, type);
+    if (frameSize < 0) {
+        logInternal(LogLevel::Error, "Pixel format not supported for tensor output: ", static_cast<int32_t>(format));
+        return 0;
+    }
+
+    // Frames are released as soon as they are converted so the sequence is not limited by the buffer length. The
+    // number of conversions in flight is bounded so that decoded frames can not accumulate faster than they are used.
+    auto pool = ThreadPool::getThreadPool();
+    const size_t maxTasks = static_cast<size_t>(std::max(pool->getNumThreads(), 1U)) * 2;
+    deque<pair<uint32_t, future<bool>>> tasks;
+    uint32_t queued = 0;
+    uint32_t failed = UINT32_MAX; // Index of the first frame that failed conversion
+    const auto waitOldest = [&tasks, &failed]() {
+        if (!tasks.front().second.get()) {
+            failed = std::min(failed, tasks.front().first);
+        }
+        tasks.pop_front();
+    };
+    uint32_t found = getFramesInternal(frameSequence, byIndex, UINT32_MAX, [&](shared_ptr<Frame>& frame) {
+        if (tasks.size() >= maxTasks) {
+            waitOldest();
+        }
+        if (failed != UINT32_MAX) {
+            // Stop decoding as no later frames will be reported
+            return false;
+        }
+        uint8_t* const frameMem = outMem + static_cast<size_t>(frameSize) * queued;
+        if (device) {
+            // Device conversions are queued on the decoders cuda stream so are launched from the calling thread
+            if (!Convert::convertToTensorCuda(*frame, frameMem, format, layout, type, options)) {
+                failed = std::min(failed, queued);
+            }
+            ++queued;
+            return true;
+        }
+        try {
+            tasks.emplace_back(queued, pool->push([frame2 = frame, frameMem, format, layout, type, options]() {
+                return Convert::convertToTensor(*frame2, frameMem, format, layout, type, options);
+            }));
+        } catch (...) {
+            // Convert on the calling thread if the task could not be queued
+            if (!Convert::convertToTensor(*frame, frameMem, format, layout, type, options)) {
+                failed = std::min(failed, queued);
+            }
+        }
+        ++queued;
+        return true;
+    });
+
+    // Wait for all conversions to complete, only frames before the first failure are reported
+    while (!tasks.empty()) {
+        waitOldest();
+    }
+    return std::min(found, failed);
+}
+
+void Stream::addFrame(FramePtr& frame, const int64_t timeStamp, const int64_t frameNum,
+    const vector<shared_ptr<Frame>>::iterator position) noexcept
+{
+    const auto memory = MemoryTracker::getFrameMemory(*frame);
+    auto newFrame = make_shared<Frame>(frame, timeStamp, frameNum, m_formatContext, m_codecContext);
+    newFrame->m_memory = MemoryReservation(m_memoryTracker, memory);
+    // Processing is deferred so that frames that are never retrieved are kept in their compact decoded format
+    newFrame->m_pending = true;
+    m_bufferPong.insert(position, move(newFrame));
+}
+
 bool Stream::processFrames() noexcept
 {
     // Sort the output frames buffer to ensure correct ordering
@@ -1020,8 +1539,7 @@ bool Stream::processFrames() noexcept
                     frameClone->pts = frameClone->best_effort_timestamp;
                     previousTimeStamp = frameClone->best_effort_timestamp;
                     LOG_DEBUG("decodeNextFrames- Adding missing frame: ", fillTimeStamp);
-                    m_bufferPong.insert(m_bufferPong.begin() + j++,
-                        make_shared<Frame>(frameClone, fillTimeStamp, i, m_formatContext, m_codecContext));
+                    addFrame(frameClone, fillTimeStamp, i, m_bufferPong.begin() + j++);
                 }
                 --j;
             }
@@ -1030,25 +1548,48 @@ bool Stream::processFrames() noexcept
         }
     }
 
-    auto it = m_bufferPong.begin();
-    while (it < m_bufferPong.end()) {
-        // Perform any required filtering
-        if (!processFrame(it->get()->m_frame)) {
-            return false;
-        }
-        if (it->get()->m_frame->height != 0) {
-            m_lastValidTimeStamp = it->get()->m_frame->best_effort_timestamp;
-            ++it;
-        } else {
-            LOG_DEBUG("decodeNextFrames- Dropping invalid frame: ", it->get()->m_frame->best_effort_timestamp, ", ",
-                it->get()->getTimeStamp());
-            m_bufferPong.erase(it);
-        }
+    if (!m_bufferPong.empty()) {
+        m_lastValidTimeStamp = m_bufferPong.back()->m_frame->best_effort_timestamp;
     }
-
     return true;
 }
 
+bool Stream::processFramesParallel() noexcept
+{
+    // Directly scaled frames are independent of each other so can be converted in parallel
+    auto pool = ThreadPool::getThreadPool();
+    vector<future<bool>> tasks;
+    try {
+        tasks.reserve(m_bufferPing.size());
+    } catch (...) {
+        logInternal(LogLevel::Error, "Failed to allocate frame processing tasks");
+        return false;
+    }
+    bool valid = true;
+    for (auto& i : m_bufferPing) {
+        if (i->m_pending) {
+            try {
+                tasks.emplace_back(pool->push([this, frame = i]() {
+                    if (!processFrame(frame->m_frame)) {
+                        return false;
+                    }
+                    frame->m_pending = false;
+                    frame->m_memory.update(MemoryTracker::getFrameMemory(*frame->m_frame));
+                    return true;
+                }));
+            } catch (...) {
+                logInternal(LogLevel::Error, "Failed to queue frame processing task");
+                valid = false;
+                break;
+            }
+        }
+    }
+    for (auto& i : tasks) {
+        valid = i.get() && valid;
+    }
+    return valid;
+}
+
 bool Stream::processFrame(FramePtr& frame) const noexcept
 {
     // Check type of memory pointer requested and perform a memory move
@@ -1062,6 +1603,16 @@ bool Stream::processFrame(FramePtr& frame) const noexcept
             logInternal(LogLevel::Error, "Failed to allocate new host frame");
             return false;
         }
+        if (m_framePool != nullptr && frame->hw_frames_ctx != nullptr) {
+            // Transfer directly into the user provided memory
+            frame2->format = reinterpret_cast<AVHWFramesContext*>(frame->hw_frames_ctx->data)->sw_format;
+            frame2->width = frame->width;
+            frame2->height = frame->height;
+            if (!m_framePool->getBuffer(*frame2)) {
+                av_frame_unref(*frame);
+                return false;
+            }
+        }
         const auto ret2 = av_hwframe_transfer_data(*frame2, *frame, 0);
         av_frame_unref(*frame);
         if (ret2 < 0) {
@@ -1075,6 +1626,40 @@ bool Stream::processFrame(FramePtr& frame) const noexcept
         frame->pts = timeStamp;
     }
 
+    if (m_lumaOnly) {
+        StreamUtils::removeChroma(frame);
+    }
+
+    bool copied = false;
+    if (m_crop.m_top != 0 || m_crop.m_bottom != 0 || m_crop.m_left != 0 || m_crop.m_right != 0) {
+        // Crop by offsetting the data pointers, the underlying buffers remain shared
+        frame->crop_top = m_crop.m_top;
+        frame->crop_bottom = m_crop.m_bottom;
+        frame->crop_left = m_crop.m_left;
+        frame->crop_right = m_crop.m_right;
+        const auto ret = av_frame_apply_cropping(*frame, AV_FRAME_CROP_UNALIGNED);
+        if (ret < 0) {
+            av_frame_unref(*frame);
+            logInternal(LogLevel::Error, "Failed to crop frame: ", getFfmpegErrorString(ret));
+            return false;
+        }
+        // The offset pointers bypass the user allocator (and its alignment) so must be copied into its memory
+        if (m_framePool != nullptr) {
+            if (!m_framePool->copyFrame(frame)) {
+                av_frame_unref(*frame);
+                return false;
+            }
+            copied = true;
+        }
+    }
+
+    if (m_scaler != nullptr) {
+        if (!m_scaler->scaleFrame(frame)) {
+            av_frame_unref(*frame);
+            return false;
+        }
+    }
+
     if (m_filterGraph != nullptr) {
         StreamUtils::rescale(frame, m_codecContext->time_base, av_buffersink_get_time_base(m_filterGraph->m_sink));
         if (!m_filterGraph->sendFrame(frame)) {
@@ -1090,6 +1675,17 @@ bool Stream::processFrame(FramePtr& frame) const noexcept
             return true;
         }
     }
+
+    // Filter output and decoders that don't support direct rendering must be copied into the user provided memory
+    // (scaler output is already allocated from it)
+    if (m_framePool != nullptr && !copied && frame->hw_frames_ctx == nullptr &&
+        (m_filterGraph != nullptr ||
+            (m_scaler == nullptr && !m_outputHost && !(m_codecContext->codec->capabilities & AV_CODEC_CAP_DR1)))) {
+        if (!m_framePool->copyFrame(frame)) {
+            av_frame_unref(*frame);
+            return false;
+        }
+    }
     return true;
 }
 
@@ -1126,25 +1722,35 @@ int32_t Stream::getSeekThreshold() const noexcept
     return static_cast<int32_t>(frames);
 }
 
+bool Stream::DetectIntraOnly(const FormatContextPtr& format, const int32_t index) noexcept
+{
+    const auto* const descriptor = avcodec_descriptor_get(format->streams[index]->codecpar->codec_id);
+    if (descriptor != nullptr && (descriptor->props & AV_CODEC_PROP_INTRA_ONLY)) {
+        return true;
+    }
+    // Image sequences store each frame as a separate file
+    return format->iformat != nullptr && strcmp(format->iformat->name, "image2") == 0;
+}
+
 int32_t Stream::GetCodecDelay(const CodecContextPtr& codec) noexcept
 {
     return std::max((codec->codec->capabilities & AV_CODEC_CAP_DELAY ? codec->delay : 0) + codec->has_b_frames, 1);
 }
 
-int64_t Stream::getStreamStartTime() const noexcept
+int64_t Stream::GetStreamStartTime(
+    const FormatContextPtr& format, const int32_t index, const int32_t maxPackets) noexcept
 {
     // First check if the stream has a start timeStamp
-    const AVStream* const stream = m_formatContext->streams[m_index];
+    const AVStream* const stream = format->streams[index];
     if (stream->start_time != int64_t(AV_NOPTS_VALUE)) {
         return stream->start_time;
     }
     // Seek to the first frame in the video to get information directly from it
-    avcodec_flush_buffers(m_codecContext.get());
     if (stream->first_dts != int64_t(AV_NOPTS_VALUE) && stream->codecpar->codec_id != AV_CODEC_ID_HEVC &&
         stream->codecpar->codec_id != AV_CODEC_ID_H264 && stream->codecpar->codec_id != AV_CODEC_ID_MPEG4) {
         return stream->first_dts;
     }
-    if (av_seek_frame(m_formatContext.get(), m_index, INT64_MIN, AVSEEK_FLAG_BACKWARD) < 0) {
+    if (av_seek_frame(format.get(), index, INT64_MIN, AVSEEK_FLAG_BACKWARD) < 0) {
         logInternal(LogLevel::Error, "Failed to determine stream start time");
         return 0;
     }
@@ -1152,13 +1758,12 @@ int64_t Stream::getStreamStartTime() const noexcept
     av_init_packet(&packet);
     // Read frames until we get one for the video stream that contains a valid PTS or DTS.
     auto startTimeStamp = int64_t(AV_NOPTS_VALUE);
-    const auto maxPackets = getCodecDelay();
     // Loop through multiple packets to take into account b-frame reordering issues
     for (int32_t i = 0; i < maxPackets;) {
-        if (av_read_frame(m_formatContext.get(), &packet) < 0) {
+        if (av_read_frame(format.get(), &packet) < 0) {
             return 0;
         }
-        if (packet.stream_index == m_index) {
+        if (packet.stream_index == index) {
             const auto pts = (packet.pts != AV_NOPTS_VALUE) ? packet.pts : packet.dts;
             if ((pts != int64_t(AV_NOPTS_VALUE)) &&
                 ((pts < startTimeStamp) || (startTimeStamp == int64_t(AV_NOPTS_VALUE)))) {
@@ -1169,13 +1774,20 @@ int64_t Stream::getStreamStartTime() const noexcept
         av_packet_unref(&packet);
     }
     // Seek back to start of file so future reads continue back at start
-    av_seek_frame(m_formatContext.get(), m_index, INT64_MIN, AVSEEK_FLAG_BACKWARD);
+    av_seek_frame(format.get(), index, INT64_MIN, AVSEEK_FLAG_BACKWARD);
     return (startTimeStamp != int64_t(AV_NOPTS_VALUE)) ? startTimeStamp : 0;
 }
 
-std::pair<int64_t, int64_t> Stream::getStreamFramesDuration() const noexcept
+std::pair<int64_t, int64_t> Stream::GetStreamFramesDuration(
+    const FormatContextPtr& format, const int32_t index, const int64_t startTimeStamp) noexcept
 {
-    const AVStream* const stream = m_formatContext->streams[m_index];
+    const AVStream* const stream = format->streams[index];
+    const auto timeStampToFrame = [stream, startTimeStamp](const int64_t timeStamp) noexcept {
+        return av_rescale_q(timeStamp - startTimeStamp, stream->time_base, av_inv_q(stream->r_frame_rate));
+    };
+    const auto timeStampToTime = [stream, startTimeStamp](const int64_t timeStamp) noexcept {
+        return av_rescale_q(timeStamp - startTimeStamp, stream->time_base, av_make_q(1, AV_TIME_BASE));
+    };
     int64_t frames = INT64_MIN;
     // Check if the number of frames is specified in the stream
     if (stream->nb_frames > 0) {
@@ -1190,8 +1802,8 @@ std::pair<int64_t, int64_t> Stream::getStreamFramesDuration() const noexcept
     // First try and get the format duration if specified. For some formats this duration can override the duration
     // specified within each stream which is why it should be checked first.
     int64_t duration = INT64_MIN;
-    if (m_formatContext->duration > 0) {
-        duration = m_formatContext->duration;
+    if (format->duration > 0) {
+        duration = format->duration;
     } else {
         // Check if the duration is specified in the stream
         if (stream->duration > 0) {
@@ -1201,12 +1813,11 @@ std::pair<int64_t, int64_t> Stream::getStreamFramesDuration() const noexcept
 
     if (frames == INT64_MIN || duration == INT64_MIN) {
         // If we are at this point then the only option is to scan the entire file and check the DTS/PTS.
-        int64_t foundTimeStamp = m_startTimeStamp;
+        int64_t foundTimeStamp = startTimeStamp;
 
         // Seek last key-frame.
-        avcodec_flush_buffers(m_codecContext.get());
-        const auto maxSeek = frameToTimeStampNoOffset(1UL << 29UL);
-        if (avformat_seek_file(m_formatContext.get(), m_index, INT64_MIN, maxSeek, maxSeek, 0) < 0) {
+        const auto maxSeek = av_rescale_q(1LL << 29LL, av_inv_q(stream->r_frame_rate), stream->time_base);
+        if (avformat_seek_file(format.get(), index, INT64_MIN, maxSeek, maxSeek, 0) < 0) {
             logInternal(LogLevel::Error, "Failed to determine number of frames in stream");
             return std::make_pair(frames, duration);
         }
@@ -1214,8 +1825,8 @@ std::pair<int64_t, int64_t> Stream::getStreamFramesDuration() const noexcept
         // Read up to last frame, extending max PTS for every valid PTS value found for the video stream.
         AVPacket packet;
         av_init_packet(&packet);
-        while (av_read_frame(m_formatContext.get(), &packet) >= 0) {
-            if (packet.stream_index == m_index) {
+        while (av_read_frame(format.get(), &packet) >= 0) {
+            if (packet.stream_index == index) {
                 const auto found = (packet.pts != AV_NOPTS_VALUE) ? packet.pts : packet.dts;
                 if (found > foundTimeStamp) {
                     foundTimeStamp = found;
@@ -1229,27 +1840,78 @@ std::pair<int64_t, int64_t> Stream::getStreamFramesDuration() const noexcept
         if (stream->first_dts != int64_t(AV_NOPTS_VALUE)) {
             start = std::min(start, stream->first_dts);
         }
-        const int64_t seek = (m_lastPacketTimeStamp != INT64_MIN) ? m_lastPacketTimeStamp : start;
-        av_seek_frame(m_formatContext.get(), m_index, seek, AVSEEK_FLAG_BACKWARD);
-        if (m_lastPacketTimeStamp != INT64_MIN) {
-            // Need to discard packets until correct timestamp is reached
-            bool found = false;
-            while (!found && av_read_frame(m_formatContext.get(), &packet) >= 0) {
-                if (packet.stream_index == m_index) {
-                    const auto timestamp = (packet.pts != AV_NOPTS_VALUE) ? packet.pts : packet.dts;
-                    if (timestamp == m_lastPacketTimeStamp) {
-                        found = true;
-                    }
-                }
-                av_packet_unref(&packet);
-            }
-        }
+        av_seek_frame(format.get(), index, start, AVSEEK_FLAG_BACKWARD);
 
         // The detected value is the index of the last frame plus one
         frames = timeStampToFrame(foundTimeStamp) + 1;
-        duration = timeStampToTime(foundTimeStamp) + frameToTime(1);
+        duration =
+            timeStampToTime(foundTimeStamp) + av_rescale_q(1, av_make_q(AV_TIME_BASE, 1), stream->r_frame_rate);
     }
 
     return std::make_pair(frames, duration);
 }
+
+vector<PacketInfo> Stream::scanStreamPackets(const string& fileName, int64_t startTimeStamp) noexcept
+{
+    vector<PacketInfo> ret;
+    // Open a separate demuxer so that the scan does not affect any existing decode position
+    AVFormatContext* formatPtr = nullptr;
+    auto err = avformat_open_input(&formatPtr, fileName.c_str(), nullptr, nullptr);
+    FormatContextPtr formatContext(formatPtr);
+    if (err < 0) {
+        logInternal(LogLevel::Error, "Failed to open input stream: ", fileName, ", ", getFfmpegErrorString(err));
+        return ret;
+    }
+    err = avformat_find_stream_info(formatContext.get(), nullptr);
+    if (err < 0) {
+        logInternal(LogLevel::Error, "Failed finding stream information: ", fileName, ", ", getFfmpegErrorString(err));
+        return ret;
+    }
+    err = av_find_best_stream(formatContext.get(), AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (err < 0) {
+        logInternal(
+            LogLevel::Error, "Failed to find video stream in file: ", fileName, ", ", getFfmpegErrorString(err));
+        return ret;
+    }
+    const int32_t index = err;
+    const AVStream* const stream = formatContext->streams[index];
+
+    // Allow the demuxer to skip the data of all other streams
+    for (uint32_t i = 0; i < formatContext->nb_streams; ++i) {
+        if (static_cast<int32_t>(i) != index) {
+            formatContext->streams[i]->discard = AVDISCARD_ALL;
+        }
+    }
+
+    if (startTimeStamp == INT64_MIN) {
+        startTimeStamp = stream->start_time != int64_t(AV_NOPTS_VALUE) ? stream->start_time : 0;
+    }
+    if (stream->nb_frames > 0) {
+        ret.reserve(static_cast<size_t>(stream->nb_frames));
+    }
+    const auto toTime = [&](const int64_t timeStamp) noexcept {
+        return timeStamp != int64_t(AV_NOPTS_VALUE) ?
+            av_rescale_q(timeStamp - startTimeStamp, stream->time_base, av_make_q(1, AV_TIME_BASE)) :
+            INT64_MIN;
+    };
+
+    AVPacket packet;
+    av_init_packet(&packet);
+    while (true) {
+        err = av_read_frame(formatContext.get(), &packet);
+        if (err < 0) {
+            if (err != AVERROR_EOF) {
+                logInternal(LogLevel::Error, "Failed to retrieve new packet: ", getFfmpegErrorString(err));
+            }
+            break;
+        }
+        if (packet.stream_index == index) {
+            ret.push_back({toTime(packet.pts), toTime(packet.dts),
+                av_rescale_q(packet.duration, stream->time_base, av_make_q(1, AV_TIME_BASE)), packet.pos,
+                static_cast<uint32_t>(packet.size), (packet.flags & AV_PKT_FLAG_KEY) != 0});
+        }
+        av_packet_unref(&packet);
+    }
+    return ret;
+}
 } // namespace Ffr
@@ -16,6 +16,7 @@
 #include "FFFRStreamUtils.h"
 
 #include "FFFRFilter.h"
+#include "FFFRScaler.h"
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -26,8 +27,13 @@ extern "C" {
 namespace Ffr {
 AVRational StreamUtils::getSampleAspectRatio(const Stream* const stream) noexcept
 {
-    return stream->m_filterGraph == nullptr ? stream->m_codecContext->sample_aspect_ratio :
-                                              av_buffersink_get_sample_aspect_ratio(stream->m_filterGraph->m_sink);
+    if (stream->m_filterGraph != nullptr) {
+        return av_buffersink_get_sample_aspect_ratio(stream->m_filterGraph->m_sink);
+    }
+    if (stream->m_scaler != nullptr) {
+        return stream->m_scaler->getSampleAspectRatio(stream->m_codecContext->sample_aspect_ratio);
+    }
+    return stream->m_codecContext->sample_aspect_ratio;
 }
 
 AVPixelFormat StreamUtils::getPixelFormat(const Stream* const stream) noexcept
@@ -35,25 +41,36 @@ AVPixelFormat StreamUtils::getPixelFormat(const Stream* const stream) noexcept
     AVPixelFormat ret;
     if (stream->m_filterGraph.get() != nullptr) {
         ret = static_cast<AVPixelFormat>(av_buffersink_get_format(stream->m_filterGraph->m_sink));
+    } else if (stream->m_scaler.get() != nullptr) {
+        ret = stream->m_scaler->getPixelFormat();
+    } else if (stream->m_lumaOnly) {
+        return AV_PIX_FMT_GRAY8;
+    } else {
+        ret = stream->m_codecContext->sw_pix_fmt != AV_PIX_FMT_NONE ? stream->m_codecContext->sw_pix_fmt :
+                                                                      stream->m_codecContext->pix_fmt;
     }
-    ret = stream->m_codecContext->sw_pix_fmt;
+    return getPixelFormat(ret);
+}
+
+AVPixelFormat StreamUtils::getPixelFormat(const AVPixelFormat format) noexcept
+{
     // Remove old deprecated jpeg formats
-    if (ret == AV_PIX_FMT_YUVJ411P) {
+    if (format == AV_PIX_FMT_YUVJ411P) {
         return AV_PIX_FMT_YUV411P;
     }
-    if (ret == AV_PIX_FMT_YUVJ420P) {
+    if (format == AV_PIX_FMT_YUVJ420P) {
         return AV_PIX_FMT_YUV420P;
     }
-    if (ret == AV_PIX_FMT_YUVJ422P) {
+    if (format == AV_PIX_FMT_YUVJ422P) {
         return AV_PIX_FMT_YUV422P;
     }
-    if (ret == AV_PIX_FMT_YUVJ440P) {
+    if (format == AV_PIX_FMT_YUVJ440P) {
         return AV_PIX_FMT_YUV440P;
     }
-    if (ret == AV_PIX_FMT_YUVJ444P) {
+    if (format == AV_PIX_FMT_YUVJ444P) {
         return AV_PIX_FMT_YUV444P;
     }
-    return ret;
+    return format;
 }
 
 AVRational StreamUtils::getFrameRate(const Stream* stream) noexcept
@@ -78,4 +95,35 @@ void StreamUtils::rescale(FramePtr& frame, const AVRational& sourceTimeBase, con
 {
     frame->pts = av_rescale_q(frame->pts, sourceTimeBase, destTimeBase);
 }
+
+bool StreamUtils::hasLumaPlane(const AVPixelFormat format) noexcept
+{
+    switch (format) {
+        case AV_PIX_FMT_YUV420P:
+        case AV_PIX_FMT_YUVJ420P:
+        case AV_PIX_FMT_YUV422P:
+        case AV_PIX_FMT_YUVJ422P:
+        case AV_PIX_FMT_YUV444P:
+        case AV_PIX_FMT_YUVJ444P:
+        case AV_PIX_FMT_NV12:
+        case AV_PIX_FMT_GRAY8:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void StreamUtils::removeChroma(FramePtr& frame) noexcept
+{
+    for (uint32_t i = 1; i < AV_NUM_DATA_POINTERS; ++i) {
+        // Only release buffers that do not also hold the luma plane
+        AVBufferRef*& buffer = frame->buf[i];
+        if (buffer != nullptr && (frame->data[0] < buffer->data || frame->data[0] >= buffer->data + buffer->size)) {
+            av_buffer_unref(&buffer);
+        }
+        frame->data[i] = nullptr;
+        frame->linesize[i] = 0;
+    }
+    frame->format = AV_PIX_FMT_GRAY8;
+}
 } // namespace Ffr
\ No newline at end of file
@@ -0,0 +1,102 @@
+/**
+ * Copyright 2019 Matthew Oliver
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "FFFRThreadPool.h"
+
+#include "FFFRUtility.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace Ffr {
+ThreadPool::ThreadPool(uint32_t numThreads) noexcept
+{
+    if (numThreads == 0) {
+        numThreads = std::max(thread::hardware_concurrency(), 1U);
+    }
+    try {
+        m_threads.reserve(numThreads);
+        for (uint32_t i = 0; i < numThreads; ++i) {
+            m_threads.emplace_back(&ThreadPool::run, this);
+        }
+    } catch (...) {
+        // Any tasks will run on the calling thread if no workers could be created
+        logInternal(LogLevel::Warning, "Failed to create all thread pool threads: ", m_threads.size());
+    }
+}
+
+ThreadPool::~ThreadPool() noexcept
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    for (auto& i : m_threads) {
+        i.join();
+    }
+}
+
+future<bool> ThreadPool::push(function<bool()> task)
+{
+    packaged_task<bool()> newTask(move(task));
+    auto ret = newTask.get_future();
+    if (m_threads.empty()) {
+        newTask();
+        return ret;
+    }
+    try {
+        lock_guard<mutex> lock(m_mutex);
+        m_tasks.emplace_back(move(newTask));
+    } catch (...) {
+        // The task is left untouched if it could not be added to the queue
+        logInternal(LogLevel::Warning, "Failed to queue thread pool task, running on calling thread");
+        newTask();
+        return ret;
+    }
+    m_condition.notify_one();
+    return ret;
+}
+
+uint32_t ThreadPool::getNumThreads() const noexcept
+{
+    return static_cast<uint32_t>(m_threads.size());
+}
+
+shared_ptr<ThreadPool> ThreadPool::getThreadPool() noexcept
+{
+    static shared_ptr<ThreadPool> s_pool = make_shared<ThreadPool>(0);
+    return s_pool;
+}
+
+void ThreadPool::run() noexcept
+{
+    while (true) {
+        packaged_task<bool()> task;
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+            if (m_tasks.empty()) {
+                // Only exit once all pending tasks have completed
+                return;
+            }
+            task = move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+} // namespace Ffr
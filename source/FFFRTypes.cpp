@@ -15,6 +15,8 @@
  */
 #include "FFFRTypes.h"
 
+#include "FFFRMemory.h"
+
 extern "C" {
 #include <libavformat/avformat.h>
 }
@@ -55,7 +57,8 @@ bool DecoderOptions::operator!=(const DecoderOptions& other) const noexcept
 bool EncoderOptions::operator==(const EncoderOptions& other) const noexcept
 {
     return m_type == other.m_type && m_quality == other.m_quality && m_preset == other.m_preset &&
-        m_gopSize == other.m_gopSize;
+        m_gopSize == other.m_gopSize && m_pipelined == other.m_pipelined && m_segments == other.m_segments &&
+        m_fragmented == other.m_fragmented;
 }
 
 bool EncoderOptions::operator!=(const EncoderOptions& other) const noexcept
@@ -81,6 +84,13 @@ CodecContextPtr::CodecContextPtr(AVCodecContext* codecContext) noexcept
     : m_codecContext(codecContext, [](AVCodecContext* p) noexcept { avcodec_free_context(&p); })
 {}
 
+CodecContextPtr::CodecContextPtr(AVCodecContext* codecContext, std::shared_ptr<void> owned) noexcept
+    : m_codecContext(codecContext, [owned](AVCodecContext* p) noexcept {
+        // The owned object must outlive the codec as it may be referenced by the codecs callbacks
+        avcodec_free_context(&p);
+    })
+{}
+
 AVCodecContext* CodecContextPtr::operator->() const noexcept
 {
     return m_codecContext.get();
@@ -150,8 +160,67 @@ const AVFrame* FramePtr::operator->() const noexcept
     return m_frame;
 }
 
+MemoryReservation::MemoryReservation(std::shared_ptr<MemoryTracker> tracker, const uint64_t size) noexcept
+    : m_tracker(move(tracker))
+    , m_size(size)
+{
+    if (m_tracker != nullptr) {
+        m_tracker->allocate(m_size);
+    }
+}
+
+MemoryReservation::~MemoryReservation() noexcept
+{
+    if (m_tracker != nullptr) {
+        m_tracker->release(m_size);
+    }
+}
+
+MemoryReservation::MemoryReservation(MemoryReservation&& other) noexcept
+    : m_tracker(move(other.m_tracker))
+    , m_size(other.m_size)
+{
+    other.m_tracker = nullptr;
+    other.m_size = 0;
+}
+
+MemoryReservation& MemoryReservation::operator=(MemoryReservation&& other) noexcept
+{
+    if (this != &other) {
+        if (m_tracker != nullptr) {
+            m_tracker->release(m_size);
+        }
+        m_tracker = move(other.m_tracker);
+        m_size = other.m_size;
+        other.m_tracker = nullptr;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+void MemoryReservation::update(const uint64_t size) noexcept
+{
+    if (m_tracker != nullptr) {
+        if (size > m_size) {
+            m_tracker->allocate(size - m_size);
+        } else {
+            m_tracker->release(m_size - size);
+        }
+    }
+    m_size = size;
+}
+
 OutputFormatContextPtr::OutputFormatContextPtr(AVFormatContext* formatContext) noexcept
-    : m_formatContext(formatContext, [](AVFormatContext* p) noexcept { avformat_free_context(p); })
+    : m_formatContext(formatContext, [](AVFormatContext* p) noexcept {
+        if (p != nullptr && (p->flags & AVFMT_FLAG_CUSTOM_IO) && p->pb != nullptr) {
+            delete static_cast<OutputWriter*>(p->pb->opaque);
+            av_freep(&p->pb->buffer);
+            avio_context_free(&p->pb);
+        } else if (p != nullptr && p->oformat != nullptr && !(p->oformat->flags & AVFMT_NOFILE)) {
+            avio_closep(&p->pb);
+        }
+        avformat_free_context(p);
+    })
 {}
 
 AVFormatContext* OutputFormatContextPtr::get() const noexcept
@@ -49,8 +49,22 @@ PixelFormat getPixelFormat(const AVPixelFormat format) noexcept
             return PixelFormat::RGB8;
         case AV_PIX_FMT_NV12:
             return PixelFormat::NV12;
+        case AV_PIX_FMT_YUV420P10LE:
+            return PixelFormat::YUV420P10;
+        case AV_PIX_FMT_YUV422P10LE:
+            return PixelFormat::YUV422P10;
+        case AV_PIX_FMT_YUV444P16LE:
+            return PixelFormat::YUV444P16;
+        case AV_PIX_FMT_P010LE:
+            return PixelFormat::P010;
+        case AV_PIX_FMT_RGB48LE:
+            return PixelFormat::RGB48;
         case AV_PIX_FMT_GBRPF32LE:
             return PixelFormat::RGB32FP;
+        case AV_PIX_FMT_GRAY8:
+            return PixelFormat::GRAY8;
+        case AV_PIX_FMT_GRAYF32LE:
+            return PixelFormat::GRAY32F;
         default:
             try {
                 logInternal(LogLevel::Error, "Unsupported pixel format detected: ", to_string(format));
@@ -69,6 +83,13 @@ AVPixelFormat getPixelFormat(PixelFormat format) noexcept
     static_assert(static_cast<int>(PixelFormat::RGB8P) == AV_PIX_FMT_GBRP, "Pixel format mismatch detected");
     static_assert(static_cast<int>(PixelFormat::RGB8) == AV_PIX_FMT_RGB24, "Pixel format mismatch detected");
     static_assert(static_cast<int>(PixelFormat::RGB32FP) == AV_PIX_FMT_GBRPF32LE, "Pixel format mismatch detected");
+    static_assert(static_cast<int>(PixelFormat::YUV420P10) == AV_PIX_FMT_YUV420P10LE, "Pixel format mismatch detected");
+    static_assert(static_cast<int>(PixelFormat::YUV422P10) == AV_PIX_FMT_YUV422P10LE, "Pixel format mismatch detected");
+    static_assert(static_cast<int>(PixelFormat::YUV444P16) == AV_PIX_FMT_YUV444P16LE, "Pixel format mismatch detected");
+    static_assert(static_cast<int>(PixelFormat::P010) == AV_PIX_FMT_P010LE, "Pixel format mismatch detected");
+    static_assert(static_cast<int>(PixelFormat::RGB48) == AV_PIX_FMT_RGB48LE, "Pixel format mismatch detected");
+    static_assert(static_cast<int>(PixelFormat::GRAY8) == AV_PIX_FMT_GRAY8, "Pixel format mismatch detected");
+    static_assert(static_cast<int>(PixelFormat::GRAY32F) == AV_PIX_FMT_GRAYF32LE, "Pixel format mismatch detected");
     // Can just do a direct cast
     return static_cast<AVPixelFormat>(format);
 }
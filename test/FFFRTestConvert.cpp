@@ -19,6 +19,7 @@
 #    include "FFFRUtility.h"
 #    include "FFFrameReader.h"
 
+#    include <cmath>
 #    include <cuda.h>
 #    include <fstream>
 #    include <gtest/gtest.h>
@@ -181,5 +182,105 @@ TEST_P(ConvertTest1, convert)
     }
 }
 
+TEST_P(ConvertTest1, normalise)
+{
+    if (GetParam().m_format != PixelFormat::RGB32FP) {
+        return;
+    }
+    const auto frame1 = m_decoder.m_stream->getNextFrame();
+    ASSERT_NE(frame1, nullptr);
+    const auto width = frame1->getWidth();
+    const auto height = frame1->getHeight();
+    const auto imageSize = getImageSize(GetParam().m_format, width, height);
+    std::vector<uint8_t> plain(imageSize);
+    std::vector<uint8_t> normalised(imageSize);
+
+    // Convert without and then with normalisation
+    ConvertOptions options;
+    options.m_scale = {2.0f, 3.0f, 4.0f};
+    options.m_offset = {-1.0f, -0.5f, 0.25f};
+    options.m_swapRB = true;
+    ASSERT_TRUE(convertFormat(frame1, reinterpret_cast<uint8_t*>(m_decoder.m_cudaBuffer), GetParam().m_format));
+    ASSERT_EQ(cuCtxPushCurrent(m_decoder.m_context.get()), CUDA_SUCCESS);
+    ASSERT_EQ(cuMemcpyDtoH(plain.data(), m_decoder.m_cudaBuffer, imageSize), CUDA_SUCCESS);
+    CUcontext dummy;
+    ASSERT_EQ(cuCtxPopCurrent(&dummy), CUDA_SUCCESS);
+    ASSERT_TRUE(
+        convertFormat(frame1, reinterpret_cast<uint8_t*>(m_decoder.m_cudaBuffer), GetParam().m_format, options));
+    ASSERT_EQ(cuCtxPushCurrent(m_decoder.m_context.get()), CUDA_SUCCESS);
+    ASSERT_EQ(cuMemcpyDtoH(normalised.data(), m_decoder.m_cudaBuffer, imageSize), CUDA_SUCCESS);
+    ASSERT_EQ(cuCtxPopCurrent(&dummy), CUDA_SUCCESS);
+
+    uint8_t* plainPlanes[4];
+    uint8_t* normalisedPlanes[4];
+    int32_t outStep[4];
+    av_image_fill_arrays(plainPlanes, outStep, plain.data(), getPixelFormat(GetParam().m_format), width, height, 32);
+    av_image_fill_arrays(
+        normalisedPlanes, outStep, normalised.data(), getPixelFormat(GetParam().m_format), width, height, 32);
+    for (uint32_t y = 0; y < height; y += 7) {
+        for (uint32_t x = 0; x < width; x += 13) {
+            const auto offset = y * outStep[0] + x * sizeof(float);
+            for (uint32_t c = 0; c < 3; ++c) {
+                const float value = *reinterpret_cast<float*>(&plainPlanes[c][offset]);
+                const float result = *reinterpret_cast<float*>(&normalisedPlanes[2 - c][offset]);
+                ASSERT_NEAR(result, value * options.m_scale[c] + options.m_offset[c], 0.0001f);
+            }
+        }
+    }
+}
+
+static float halfToFloat(const uint16_t value)
+{
+    // Test data is normalised to [0, 1] so only normal and zero values need to be handled
+    const uint32_t exponent = (value >> 10) & 0x1FU;
+    if (exponent == 0) {
+        return 0.0f;
+    }
+    return std::ldexp(1.0f + static_cast<float>(value & 0x3FFU) / 1024.0f, static_cast<int>(exponent) - 15);
+}
+
+TEST_P(ConvertTest1, tensorHalf)
+{
+    if (GetParam().m_format != PixelFormat::RGB32FP) {
+        return;
+    }
+    const auto width = m_decoder.m_stream->getWidth();
+    const auto height = m_decoder.m_stream->getHeight();
+    const auto tensorSize = getTensorSize(GetParam().m_format, width, height, 1, TensorType::Float16);
+    const auto imageSize = getImageSize(GetParam().m_format, width, height);
+    std::vector<uint16_t> half(tensorSize / sizeof(uint16_t));
+    std::vector<uint8_t> single(imageSize);
+
+    // Convert the same frame to a half precision tensor and to a single precision image
+    const std::vector<int64_t> frameSequence = {0};
+    ASSERT_EQ(m_decoder.m_stream->getFramesByIndexTensor(frameSequence,
+                  reinterpret_cast<uint8_t*>(m_decoder.m_cudaBuffer), GetParam().m_format, TensorLayout::NCHW,
+                  TensorType::Float16),
+        1);
+    ASSERT_EQ(cuCtxPushCurrent(m_decoder.m_context.get()), CUDA_SUCCESS);
+    ASSERT_EQ(cuMemcpyDtoH(half.data(), m_decoder.m_cudaBuffer, tensorSize), CUDA_SUCCESS);
+    CUcontext dummy;
+    ASSERT_EQ(cuCtxPopCurrent(&dummy), CUDA_SUCCESS);
+    const auto frames = m_decoder.m_stream->getFramesByIndex(frameSequence);
+    ASSERT_EQ(frames.size(), 1);
+    ASSERT_TRUE(convertFormat(frames[0], reinterpret_cast<uint8_t*>(m_decoder.m_cudaBuffer), GetParam().m_format));
+    ASSERT_EQ(cuCtxPushCurrent(m_decoder.m_context.get()), CUDA_SUCCESS);
+    ASSERT_EQ(cuMemcpyDtoH(single.data(), m_decoder.m_cudaBuffer, imageSize), CUDA_SUCCESS);
+    ASSERT_EQ(cuCtxPopCurrent(&dummy), CUDA_SUCCESS);
+
+    uint8_t* singlePlanes[4];
+    int32_t outStep[4];
+    av_image_fill_arrays(singlePlanes, outStep, single.data(), getPixelFormat(GetParam().m_format), width, height, 32);
+    for (uint32_t y = 0; y < height; y += 7) {
+        for (uint32_t x = 0; x < width; x += 13) {
+            for (uint32_t c = 0; c < 3; ++c) {
+                const float value = *reinterpret_cast<float*>(&singlePlanes[c][y * outStep[0] + x * sizeof(float)]);
+                const float result = halfToFloat(half[(static_cast<size_t>(c) * height + y) * width + x]);
+                ASSERT_NEAR(result, value, 0.001f);
+            }
+        }
+    }
+}
+
 INSTANTIATE_TEST_SUITE_P(ConvertTestData, ConvertTest1, ::testing::ValuesIn(g_testDataConvert));
 #endif
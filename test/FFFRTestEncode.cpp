@@ -17,7 +17,12 @@
 #include "FFFRTestData.h"
 #include "FFFrameReader.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <gtest/gtest.h>
+#include <vector>
 
 using namespace Ffr;
 
@@ -117,4 +122,414 @@ TEST_P(EncodeTest1, encodeStream)
     ASSERT_EQ(stream->getDuration(), g_testData[GetParam().m_testDataIndex].m_duration);
 }
 
+TEST_P(EncodeTest1, encodeStreamSequential)
+{
+    if (GetParam().m_preset != EncoderOptions::Preset::Ultrafast) {
+        return;
+    }
+    EncoderOptions options2;
+    options2.m_type = GetParam().m_encodeType;
+    options2.m_quality = GetParam().m_quality;
+    options2.m_preset = GetParam().m_preset;
+    options2.m_pipelined = false;
+
+    // The sequential path must produce the same output stream as the pipelined one (encoders are deterministic)
+    const std::string fileName = "seq_" + GetParam().m_fileName;
+    ASSERT_TRUE(Encoder::encodeStream(fileName, m_decoder.m_stream, options2));
+    auto stream = Stream::getStream(fileName);
+    ASSERT_NE(stream, nullptr);
+    ASSERT_EQ(stream->getWidth(), g_testData[GetParam().m_testDataIndex].m_width);
+    ASSERT_EQ(stream->getHeight(), g_testData[GetParam().m_testDataIndex].m_height);
+    ASSERT_EQ(stream->getTotalFrames(), g_testData[GetParam().m_testDataIndex].m_totalFrames);
+    ASSERT_EQ(stream->getDuration(), g_testData[GetParam().m_testDataIndex].m_duration);
+
+    // Encode the same source using the pipelined path and compare each output frame
+    auto source = Stream::getStream(g_testData[GetParam().m_testDataIndex].m_fileName);
+    ASSERT_NE(source, nullptr);
+    options2.m_pipelined = true;
+    const std::string pipelinedName = "pipe_" + GetParam().m_fileName;
+    ASSERT_TRUE(Encoder::encodeStream(pipelinedName, source, options2));
+    auto pipelined = Stream::getStream(pipelinedName);
+    ASSERT_NE(pipelined, nullptr);
+    ASSERT_EQ(stream->getTotalFrames(), pipelined->getTotalFrames());
+    for (int64_t i = 0; i < stream->getTotalFrames(); ++i) {
+        const auto frame1 = stream->getNextFrame();
+        const auto frame2 = pipelined->getNextFrame();
+        ASSERT_NE(frame1, nullptr);
+        ASSERT_NE(frame2, nullptr);
+        ASSERT_EQ(frame1->getTimeStamp(), frame2->getTimeStamp());
+        const auto data1 = frame1->getFrameData(0);
+        const auto data2 = frame2->getFrameData(0);
+        for (uint32_t y = 0; y < frame1->getHeight(); ++y) {
+            ASSERT_EQ(memcmp(data1.first + static_cast<size_t>(y) * data1.second,
+                          data2.first + static_cast<size_t>(y) * data2.second, frame1->getWidth()),
+                0)
+                << "frame " << i << " line " << y;
+        }
+    }
+    ASSERT_EQ(stream->getNextFrame(), nullptr);
+    ASSERT_EQ(pipelined->getNextFrame(), nullptr);
+}
+
+TEST_P(EncodeTest1, encodeStreamSegmented)
+{
+    if (GetParam().m_preset != EncoderOptions::Preset::Ultrafast) {
+        return;
+    }
+    EncoderOptions options2;
+    options2.m_type = GetParam().m_encodeType;
+    options2.m_quality = GetParam().m_quality;
+    options2.m_preset = GetParam().m_preset;
+    options2.m_segments = 3;
+
+    // Concatenated segments must produce a single continuous stream
+    const std::string fileName = "seg_" + GetParam().m_fileName;
+    ASSERT_TRUE(Encoder::encodeStream(fileName, m_decoder.m_stream, options2));
+    auto stream = Stream::getStream(fileName);
+    ASSERT_NE(stream, nullptr);
+    ASSERT_EQ(stream->getWidth(), g_testData[GetParam().m_testDataIndex].m_width);
+    ASSERT_EQ(stream->getHeight(), g_testData[GetParam().m_testDataIndex].m_height);
+    ASSERT_EQ(stream->getTotalFrames(), g_testData[GetParam().m_testDataIndex].m_totalFrames);
+    ASSERT_EQ(stream->getDuration(), g_testData[GetParam().m_testDataIndex].m_duration);
+    // The source stream is consumed in the same way as a single pass encode
+    ASSERT_EQ(m_decoder.m_stream->getNextFrame(), nullptr);
+    ASSERT_TRUE(m_decoder.m_stream->isEndOfFile());
+
+    // The frames must match those of a single pass encode
+    auto source = Stream::getStream(g_testData[GetParam().m_testDataIndex].m_fileName);
+    ASSERT_NE(source, nullptr);
+    options2.m_segments = 1;
+    const std::string singleName = "single_" + GetParam().m_fileName;
+    ASSERT_TRUE(Encoder::encodeStream(singleName, source, options2));
+    auto single = Stream::getStream(singleName);
+    ASSERT_NE(single, nullptr);
+    ASSERT_EQ(stream->getTotalFrames(), single->getTotalFrames());
+    for (int64_t i = 0; i < stream->getTotalFrames(); ++i) {
+        const auto frame = stream->getNextFrame();
+        const auto singleFrame = single->getNextFrame();
+        ASSERT_NE(frame, nullptr);
+        ASSERT_NE(singleFrame, nullptr);
+        ASSERT_EQ(frame->getFrameNumber(), i);
+        ASSERT_EQ(frame->getTimeStamp(), singleFrame->getTimeStamp());
+    }
+    ASSERT_EQ(stream->getNextFrame(), nullptr);
+    ASSERT_EQ(single->getNextFrame(), nullptr);
+}
+
+TEST_P(EncodeTest1, pushFrame)
+{
+    if (GetParam().m_preset != EncoderOptions::Preset::Ultrafast) {
+        return;
+    }
+    EncoderOptions options2;
+    options2.m_type = GetParam().m_encodeType;
+    options2.m_preset = GetParam().m_preset;
+    const auto& testData = g_testData[GetParam().m_testDataIndex];
+    const Rational frameRate = {static_cast<int32_t>(std::lround(testData.m_frameRate * 1000.0)), 1000};
+    const std::string fileName = "push_" + GetParam().m_fileName;
+    auto encoder = Encoder::getEncoder(fileName, m_decoder.m_stream->getWidth(), m_decoder.m_stream->getHeight(),
+        m_decoder.m_stream->getPixelFormat(), frameRate, options2);
+    ASSERT_NE(encoder, nullptr);
+    int64_t frames = 0;
+    while (true) {
+        const auto frame = m_decoder.m_stream->getNextFrame();
+        if (frame == nullptr) {
+            break;
+        }
+        ASSERT_TRUE(encoder->pushFrame(*frame));
+        ++frames;
+    }
+    ASSERT_TRUE(encoder->finish());
+
+    auto stream = Stream::getStream(fileName);
+    ASSERT_NE(stream, nullptr);
+    ASSERT_EQ(stream->getWidth(), testData.m_width);
+    ASSERT_EQ(stream->getHeight(), testData.m_height);
+    ASSERT_EQ(stream->getTotalFrames(), frames);
+}
+
+TEST_P(EncodeTest1, copyStream)
+{
+    if (GetParam().m_encodeType != EncodeType::h264 || GetParam().m_preset != EncoderOptions::Preset::Ultrafast ||
+        GetParam().m_useFiltering) {
+        return;
+    }
+    const auto& testData = g_testData[GetParam().m_testDataIndex];
+    // Copying the entire stream must keep every frame
+    const std::string fileName = "copy_" + GetParam().m_fileName;
+    ASSERT_TRUE(Encoder::copyStream(fileName, m_decoder.m_stream));
+    auto stream = Stream::getStream(fileName);
+    ASSERT_NE(stream, nullptr);
+    ASSERT_EQ(stream->getWidth(), testData.m_width);
+    ASSERT_EQ(stream->getHeight(), testData.m_height);
+    ASSERT_EQ(stream->getTotalFrames(), testData.m_totalFrames);
+
+    // A trimmed copy starts at or before the requested frame and contains at least the requested range
+    const int64_t startFrame = testData.m_totalFrames / 3;
+    const int64_t endFrame = startFrame + testData.m_totalFrames / 3;
+    const std::string trimName = "trim_" + GetParam().m_fileName;
+    ASSERT_TRUE(Encoder::copyStreamFrames(trimName, m_decoder.m_stream, startFrame, endFrame));
+    auto trimmed = Stream::getStream(trimName);
+    ASSERT_NE(trimmed, nullptr);
+    ASSERT_GE(trimmed->getTotalFrames(), endFrame - startFrame);
+    ASSERT_LT(trimmed->getTotalFrames(), testData.m_totalFrames);
+    ASSERT_NE(trimmed->getNextFrame(), nullptr);
+
+    // Copies can be written to a fragmented in memory output
+    std::vector<uint8_t> output;
+    EncoderOptions options;
+    options.m_fragmented = true;
+    options.m_writer = [&](const uint8_t* data, const size_t size) {
+        output.insert(output.end(), data, data + size);
+        return true;
+    };
+    ASSERT_TRUE(Encoder::copyStreamFrames("memory_copy.mp4", m_decoder.m_stream, startFrame, endFrame, options));
+    ASSERT_GT(output.size(), 8U);
+    ASSERT_EQ(std::string(reinterpret_cast<const char*>(&output[4]), 4), "ftyp");
+    const std::string data(output.begin(), output.end());
+    ASSERT_NE(data.find("moof"), std::string::npos);
+
+    // The source stream position is unaffected
+    const auto frame = m_decoder.m_stream->getNextFrame();
+    ASSERT_NE(frame, nullptr);
+    ASSERT_EQ(frame->getFrameNumber(), 0);
+}
+
+TEST(EncodeTest2, pushRaw)
+{
+    const std::string fileName = "push_raw.mp4";
+    auto encoder = Encoder::getEncoder(fileName, 64, 64, PixelFormat::YUV420P, {25, 1});
+    ASSERT_NE(encoder, nullptr);
+    std::vector<uint8_t> luma(64 * 64);
+    std::vector<uint8_t> chroma(32 * 32, 128);
+    for (int64_t i = 0; i < 10; ++i) {
+        std::fill(luma.begin(), luma.end(), static_cast<uint8_t>(i * 20));
+        const uint8_t* const planes[3] = {luma.data(), chroma.data(), chroma.data()};
+        const int32_t strides[3] = {64, 32, 32};
+        ASSERT_TRUE(encoder->pushRaw(planes, strides, 3, i * 40000));
+    }
+    // Plane data must match the encoders format
+    {
+        const uint8_t* const planes[3] = {luma.data(), chroma.data(), nullptr};
+        const int32_t strides[3] = {64, 32, 32};
+        ASSERT_FALSE(encoder->pushRaw(planes, strides, 2, 400000));
+        ASSERT_FALSE(encoder->pushRaw(planes, strides, 3, 400000));
+        const uint8_t* const planes2[3] = {luma.data(), chroma.data(), chroma.data()};
+        const int32_t strides2[3] = {32, 32, 32};
+        ASSERT_FALSE(encoder->pushRaw(planes2, strides2, 3, 400000));
+    }
+    ASSERT_TRUE(encoder->finish());
+    // No more frames can be added once finished
+    const uint8_t* const planes[3] = {luma.data(), chroma.data(), chroma.data()};
+    const int32_t strides[3] = {64, 32, 32};
+    ASSERT_FALSE(encoder->pushRaw(planes, strides, 3, 400000));
+
+    auto stream = Stream::getStream(fileName);
+    ASSERT_NE(stream, nullptr);
+    ASSERT_EQ(stream->getWidth(), 64);
+    ASSERT_EQ(stream->getHeight(), 64);
+    ASSERT_EQ(stream->getTotalFrames(), 10);
+}
+
+TEST(EncodeTest2, encodeStreamMultiple)
+{
+    const auto& testData = g_testData[1];
+    auto source = Stream::getStream(testData.m_fileName);
+    ASSERT_NE(source, nullptr);
+    std::vector<EncoderOutput> outputs(3);
+    outputs[0].m_fileName = "multi_full.mp4";
+    outputs[1].m_fileName = "multi_640.mp4";
+    outputs[1].m_scale = {640, 360};
+    outputs[2].m_fileName = "multi_320.mp4";
+    outputs[2].m_scale = {320, 180};
+    outputs[2].m_options.m_type = EncodeType::h265;
+    for (auto& i : outputs) {
+        i.m_options.m_preset = EncoderOptions::Preset::Ultrafast;
+    }
+    ASSERT_TRUE(Encoder::encodeStream(outputs, source));
+    ASSERT_TRUE(source->isEndOfFile());
+
+    for (const auto& i : outputs) {
+        auto stream = Stream::getStream(i.m_fileName);
+        ASSERT_NE(stream, nullptr);
+        ASSERT_EQ(stream->getWidth(), i.m_scale.m_width != 0 ? i.m_scale.m_width : testData.m_width);
+        ASSERT_EQ(stream->getHeight(), i.m_scale.m_height != 0 ? i.m_scale.m_height : testData.m_height);
+        ASSERT_DOUBLE_EQ(stream->getAspectRatio(), testData.m_aspectRatio);
+        ASSERT_EQ(stream->getTotalFrames(), testData.m_totalFrames);
+        ASSERT_EQ(stream->getDuration(), testData.m_duration);
+    }
+}
+
+static void checkCut(const std::string& fileName, const std::string& sourceName, const int64_t startFrame,
+    const int64_t endFrame)
+{
+    auto stream = Stream::getStream(fileName);
+    ASSERT_NE(stream, nullptr);
+    auto source = Stream::getStream(sourceName);
+    ASSERT_NE(source, nullptr);
+    ASSERT_EQ(stream->getWidth(), source->getWidth());
+    ASSERT_EQ(stream->getHeight(), source->getHeight());
+    ASSERT_EQ(stream->getTotalFrames(), endFrame - startFrame);
+    ASSERT_TRUE(source->seekFrame(startFrame));
+    // Every frame (including those either side of each re-encoded boundary) must match the source frame
+    for (int64_t i = 0; i < endFrame - startFrame; ++i) {
+        const auto frame = stream->getNextFrame();
+        const auto sourceFrame = source->getNextFrame();
+        ASSERT_NE(frame, nullptr);
+        ASSERT_NE(sourceFrame, nullptr);
+        ASSERT_EQ(frame->getTimeStamp(), stream->frameToTime(i));
+        ASSERT_EQ(sourceFrame->getFrameNumber(), startFrame + i);
+        const auto data = frame->getFrameData(0);
+        const auto sourceData = sourceFrame->getFrameData(0);
+        uint64_t difference = 0;
+        for (uint32_t y = 0; y < frame->getHeight(); ++y) {
+            const uint8_t* line = data.first + static_cast<size_t>(y) * data.second;
+            const uint8_t* sourceLine = sourceData.first + static_cast<size_t>(y) * sourceData.second;
+            for (uint32_t x = 0; x < frame->getWidth(); ++x) {
+                difference += static_cast<uint64_t>(std::abs(line[x] - sourceLine[x]));
+            }
+        }
+        const double meanDifference =
+            static_cast<double>(difference) / (static_cast<double>(frame->getWidth()) * frame->getHeight());
+        ASSERT_LT(meanDifference, 6.0) << "frame " << i;
+    }
+    ASSERT_EQ(stream->getNextFrame(), nullptr);
+}
+
+TEST(EncodeTest2, cutStream)
+{
+    const auto& testData = g_testData[1];
+    auto source = Stream::getStream(testData.m_fileName);
+    ASSERT_NE(source, nullptr);
+    EncoderOptions options;
+    options.m_preset = EncoderOptions::Preset::Ultrafast;
+    // Cut points that are not on key frames must still produce exactly the requested frames
+    const std::string fileName = "cut.mp4";
+    ASSERT_TRUE(Encoder::cutStreamFrames(fileName, source, 7, 41, options));
+    checkCut(fileName, testData.m_fileName, 7, 41);
+
+    // A cut through to the end of the stream
+    const std::string endName = "cut_end.mp4";
+    ASSERT_TRUE(Encoder::cutStreamFrames(endName, source, 13, testData.m_totalFrames, options));
+    checkCut(endName, testData.m_fileName, 13, testData.m_totalFrames);
+}
+
+TEST(EncodeTest2, cutStreamOpenGOP)
+{
+    const auto& testData = g_testData[1];
+    // Create a source with open groups of pictures where leading pictures follow each key frame in decode order
+    const std::string sourceName = "cut_source_open_gop.mp4";
+    {
+        auto source = Stream::getStream(testData.m_fileName);
+        ASSERT_NE(source, nullptr);
+        EncoderOptions options;
+        options.m_type = EncodeType::h265;
+        options.m_gopSize = 10;
+        ASSERT_TRUE(Encoder::encodeStream(sourceName, source, options));
+    }
+    auto source = Stream::getStream(sourceName);
+    ASSERT_NE(source, nullptr);
+    const auto packets = source->scanPackets();
+    bool leading = false;
+    for (size_t i = 1; i < packets.size(); ++i) {
+        leading = leading || (packets[i - 1].m_keyFrame && packets[i].m_timeStamp < packets[i - 1].m_timeStamp);
+    }
+    ASSERT_TRUE(leading);
+
+    EncoderOptions options;
+    options.m_preset = EncoderOptions::Preset::Ultrafast;
+    const std::string fileName = "cut_open_gop.mp4";
+    ASSERT_TRUE(Encoder::cutStreamFrames(fileName, source, 7, 41, options));
+    checkCut(fileName, sourceName, 7, 41);
+}
+
+TEST(EncodeTest2, fragmentedWriter)
+{
+    const auto& testData = g_testData[1];
+    auto source = Stream::getStream(testData.m_fileName);
+    ASSERT_NE(source, nullptr);
+    std::vector<uint8_t> output;
+    uint32_t writes = 0;
+    EncoderOptions options;
+    options.m_preset = EncoderOptions::Preset::Ultrafast;
+    options.m_gopSize = 10;
+    options.m_fragmented = true;
+    options.m_writer = [&](const uint8_t* data, const size_t size) {
+        output.insert(output.end(), data, data + size);
+        ++writes;
+        return true;
+    };
+    // The file name is only used to select the container
+    ASSERT_TRUE(Encoder::encodeStream("memory.mp4", source, options));
+    ASSERT_GT(writes, 1U);
+    ASSERT_GT(output.size(), 8U);
+    ASSERT_EQ(std::string(reinterpret_cast<const char*>(&output[4]), 4), "ftyp");
+    // Each group of pictures is output in its own fragment
+    const std::string data(output.begin(), output.end());
+    size_t fragments = 0;
+    for (auto pos = data.find("moof"); pos != std::string::npos; pos = data.find("moof", pos + 4)) {
+        ++fragments;
+    }
+    ASSERT_GE(fragments, static_cast<size_t>(testData.m_totalFrames / 10));
+
+    // The in memory output must be a valid stream
+    const std::string fileName = "memory.mp4";
+    FILE* file = fopen(fileName.c_str(), "wb");
+    ASSERT_NE(file, nullptr);
+    ASSERT_EQ(fwrite(output.data(), 1, output.size(), file), output.size());
+    fclose(file);
+    auto stream = Stream::getStream(fileName);
+    ASSERT_NE(stream, nullptr);
+    ASSERT_EQ(stream->getWidth(), testData.m_width);
+    ASSERT_EQ(stream->getHeight(), testData.m_height);
+    ASSERT_EQ(stream->getTotalFrames(), testData.m_totalFrames);
+
+    // A writer failure stops encoding
+    auto source2 = Stream::getStream(testData.m_fileName);
+    ASSERT_NE(source2, nullptr);
+    options.m_writer = [](const uint8_t*, size_t) { return false; };
+    ASSERT_FALSE(Encoder::encodeStream("memory_fail.mp4", source2, options));
+}
+
+TEST(EncodeTest2, cacheStream)
+{
+    const auto& testData = g_testData[1];
+    DecoderOptions options;
+    options.m_scale = {640, 360};
+    auto source = Stream::getStream(testData.m_fileName, options);
+    ASSERT_NE(source, nullptr);
+    const std::string fileName = "cache.mkv";
+    ASSERT_TRUE(Encoder::cacheStream(fileName, source));
+
+    auto cache = Stream::getStream(fileName);
+    ASSERT_NE(cache, nullptr);
+    ASSERT_EQ(cache->getWidth(), 640);
+    ASSERT_EQ(cache->getHeight(), 360);
+    ASSERT_EQ(cache->getPixelFormat(), source->getPixelFormat());
+    ASSERT_EQ(cache->getTotalFrames(), testData.m_totalFrames);
+
+    // Cached frames must exactly match the processed source frames
+    auto source2 = Stream::getStream(testData.m_fileName, options);
+    ASSERT_NE(source2, nullptr);
+    const std::vector<int64_t> frames = {37, 3, 49, 0, 21};
+    const auto cached = cache->getFramesByIndex(frames);
+    const auto decoded = source2->getFramesByIndex(frames);
+    ASSERT_EQ(cached.size(), frames.size());
+    ASSERT_EQ(decoded.size(), frames.size());
+    for (size_t i = 0; i < frames.size(); ++i) {
+        ASSERT_EQ(cached[i]->getFrameNumber(), frames[i]);
+        for (int32_t plane = 0; plane < cached[i]->getNumberPlanes(); ++plane) {
+            const auto cachedData = cached[i]->getFrameData(plane);
+            const auto decodedData = decoded[i]->getFrameData(plane);
+            const uint32_t height = plane == 0 ? 360 : 180;
+            const uint32_t width = plane == 0 ? 640 : 320;
+            for (uint32_t y = 0; y < height; ++y) {
+                ASSERT_EQ(memcmp(cachedData.first + y * cachedData.second,
+                              decodedData.first + y * decodedData.second, width),
+                    0);
+            }
+        }
+    }
+}
+
 INSTANTIATE_TEST_SUITE_P(EncodeTestData, EncodeTest1, ::testing::ValuesIn(g_testDataEncode));
@@ -16,6 +16,9 @@
 #include "FFFRTestData.h"
 #include "FFFrameReader.h"
 
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <gtest/gtest.h>
 
 using namespace Ffr;
@@ -40,6 +43,12 @@ static std::vector<TestParamsFilter> g_testDataFilter = {
     {0, DecodeType::Software, {1920, 1080}, {0, 0, 0, 0}, PixelFormat::YUV422P, "test-filter-4"},
     {0, DecodeType::Software, {1920, 1080}, {0, 0, 0, 0}, PixelFormat::RGB8, "test-filter-5"},
     {0, DecodeType::Software, {1920, 1080}, {0, 0, 0, 0}, PixelFormat::RGB8P, "test-filter-6"},
+    {0, DecodeType::Software, {1920, 1080}, {0, 0, 0, 0}, PixelFormat::GRAY8, "test-filter-15"},
+    {0, DecodeType::Software, {1280, 720}, {180, 180, 320, 320}, PixelFormat::GRAY8, "test-filter-16"},
+    {0, DecodeType::Software, {1920, 1080}, {0, 0, 0, 0}, PixelFormat::GRAY32F, "test-filter-17"},
+    {0, DecodeType::Software, {1920, 1080}, {0, 0, 0, 0}, PixelFormat::YUV420P10, "test-filter-18"},
+    {0, DecodeType::Software, {1280, 720}, {0, 0, 0, 0}, PixelFormat::P010, "test-filter-19"},
+    {0, DecodeType::Software, {1920, 1080}, {0, 0, 0, 0}, PixelFormat::YUV444P16, "test-filter-20"},
     //{0, DecodeType::Software, {1920, 1080}, {0, 0, 0, 0}, PixelFormat::RGB32FP, "test-filter-7"},
     {0, DecodeType::Cuda, {1280, 720}, {0, 0, 0, 0}, PixelFormat::Auto, "test-filter-8"},
     {0, DecodeType::Cuda, {1280, 720}, {0, 360, 0, 640}, PixelFormat::Auto, "test-filter-9"},
@@ -50,6 +59,36 @@ static std::vector<TestParamsFilter> g_testDataFilter = {
     //{0, DecodeType::Software, {1920, 1080}, {0, 0, 0, 0}, PixelFormat::RGB32FP, "test-filter-14"},
 };
 
+class TestAllocator : public FrameAllocator
+{
+public:
+    explicit TestAllocator(std::atomic<bool>& called) noexcept
+        : m_called(called)
+    {}
+
+    uint8_t* allocate(const size_t size) noexcept override
+    {
+        m_called = true;
+        ++m_allocations;
+        const size_t alignedSize = (size + getAlignment() - 1) & ~(static_cast<size_t>(getAlignment()) - 1);
+        return static_cast<uint8_t*>(aligned_alloc(getAlignment(), alignedSize));
+    }
+
+    void deallocate(uint8_t* data, size_t) noexcept override
+    {
+        free(data);
+    }
+
+    uint32_t getAllocations() const noexcept
+    {
+        return m_allocations;
+    }
+
+private:
+    std::atomic<bool>& m_called;
+    std::atomic<uint32_t> m_allocations{0};
+};
+
 class FilterTest1 : public ::testing::TestWithParam<TestParamsFilter>
 {
 protected:
@@ -74,7 +113,7 @@ protected:
     }
 
     std::shared_ptr<Stream> m_stream = nullptr;
-    bool m_allocatorCalled = false;
+    std::atomic<bool> m_allocatorCalled{false};
 };
 
 TEST_P(FilterTest1, getWidth)
@@ -119,6 +158,88 @@ TEST_P(FilterTest1, getFormat)
     ASSERT_EQ(frame->getPixelFormat(), format);
 }
 
+TEST_P(FilterTest1, crop)
+{
+    const auto& crop = GetParam().m_crop;
+    if (GetParam().m_type != DecodeType::Software || GetParam().m_format != PixelFormat::Auto ||
+        (crop.m_top == 0 && crop.m_bottom == 0 && crop.m_left == 0 && crop.m_right == 0)) {
+        return;
+    }
+    // Compare against the same region of the uncropped frame
+    auto stream = Stream::getStream(g_testData[GetParam().m_testDataIndex].m_fileName);
+    ASSERT_NE(stream, nullptr);
+    const auto full = stream->getNextFrame();
+    const auto frame1 = m_stream->getNextFrame();
+    ASSERT_NE(full, nullptr);
+    ASSERT_NE(frame1, nullptr);
+    const auto cropData = frame1->getFrameData(0);
+    const auto fullData = full->getFrameData(0);
+    for (uint32_t y = 0; y < frame1->getHeight(); y += 7) {
+        ASSERT_EQ(memcmp(cropData.first + static_cast<size_t>(y) * cropData.second,
+                      fullData.first + static_cast<size_t>(y + crop.m_top) * fullData.second + crop.m_left,
+                      frame1->getWidth()),
+            0);
+    }
+}
+
+TEST_P(FilterTest1, lumaOnly)
+{
+    if (GetParam().m_format != PixelFormat::GRAY8 && GetParam().m_format != PixelFormat::GRAY32F) {
+        return;
+    }
+    ASSERT_EQ(m_stream->getPixelFormat(), GetParam().m_format);
+    const auto frame = m_stream->getNextFrame();
+    ASSERT_NE(frame, nullptr);
+    ASSERT_EQ(frame->getNumberPlanes(), 1);
+    ASSERT_GE(frame->getFrameData(0).second,
+        static_cast<int32_t>(frame->getWidth() * (GetParam().m_format == PixelFormat::GRAY8 ? 1 : sizeof(float))));
+}
+
+TEST_P(FilterTest1, highBitDepth)
+{
+    if (GetParam().m_format != PixelFormat::YUV420P10 && GetParam().m_format != PixelFormat::P010 &&
+        GetParam().m_format != PixelFormat::YUV444P16) {
+        return;
+    }
+    const auto frame = m_stream->getNextFrame();
+    ASSERT_NE(frame, nullptr);
+    // Check that high bit depth frames can be converted to 8-bit output
+    const auto size = getImageSize(PixelFormat::RGB8, frame->getWidth(), frame->getHeight());
+    ASSERT_GT(size, 0);
+    std::vector<uint8_t> image(static_cast<size_t>(size));
+    ASSERT_TRUE(convertFormat(frame, image.data(), PixelFormat::RGB8));
+
+    // Compare against an 8-bit decode of the same frame
+    DecoderOptions options;
+    options.m_scale = GetParam().m_scale;
+    options.m_format = PixelFormat::YUV420P;
+    auto stream = Stream::getStream(g_testData[GetParam().m_testDataIndex].m_fileName, options);
+    ASSERT_NE(stream, nullptr);
+    const auto reference = stream->getNextFrame();
+    ASSERT_NE(reference, nullptr);
+    ASSERT_EQ(reference->getWidth(), frame->getWidth());
+    ASSERT_EQ(reference->getHeight(), frame->getHeight());
+    std::vector<uint8_t> referenceImage(static_cast<size_t>(size));
+    ASSERT_TRUE(convertFormat(reference, referenceImage.data(), PixelFormat::RGB8));
+
+    // Luma values are scaled up from 8-bit so the top 8 bits must match the reference
+    const uint32_t shift = GetParam().m_format == PixelFormat::YUV420P10 ? 2 : 8;
+    const auto lumaData = frame->getFrameData(0);
+    const auto referenceData = reference->getFrameData(0);
+    for (uint32_t y = 0; y < frame->getHeight(); y += 37) {
+        const auto* luma16 =
+            reinterpret_cast<const uint16_t*>(lumaData.first + static_cast<size_t>(y) * lumaData.second);
+        const uint8_t* luma8 = referenceData.first + static_cast<size_t>(y) * referenceData.second;
+        for (uint32_t x = 0; x < frame->getWidth(); x += 41) {
+            ASSERT_NEAR(luma16[x] >> shift, luma8[x], 1) << "x=" << x << " y=" << y;
+        }
+    }
+    // Converted output must match the 8-bit conversion to within rounding
+    for (size_t i = 0; i < image.size(); i += 997) {
+        ASSERT_NEAR(image[i], referenceImage[i], 3) << "i=" << i;
+    }
+}
+
 TEST_P(FilterTest1, getLoop25)
 {
     // Ensure that all frames can be read
@@ -165,4 +286,104 @@ TEST_P(FilterTest1, output)
     }
 }
 
+TEST_P(FilterTest1, allocator)
+{
+    if (GetParam().m_type != DecodeType::Software) {
+        return;
+    }
+    DecoderOptions options;
+    options.m_scale = GetParam().m_scale;
+    options.m_crop = GetParam().m_crop;
+    options.m_format = GetParam().m_format;
+    options.m_allocator = std::make_shared<TestAllocator>(m_allocatorCalled);
+    auto stream = Stream::getStream(g_testData[GetParam().m_testDataIndex].m_fileName, options);
+    ASSERT_NE(stream, nullptr);
+    const auto frame1 = stream->getNextFrame();
+    ASSERT_NE(frame1, nullptr);
+    ASSERT_TRUE(m_allocatorCalled);
+    ASSERT_EQ(frame1->getWidth(), GetParam().m_scale.m_width);
+    // Check that output memory meets the allocators alignment
+    const auto alignment = options.m_allocator->getAlignment();
+    for (int32_t i = 0; i < getPixelFormatPlanes(frame1->getPixelFormat()); i++) {
+        ASSERT_EQ(reinterpret_cast<uintptr_t>(frame1->getFrameData(i).first) % alignment, 0);
+        ASSERT_EQ(static_cast<uint32_t>(frame1->getFrameData(i).second) % alignment, 0);
+    }
+
+    // Decoder and output frames must both reuse pooled memory once it has been released
+    const auto allocator = std::static_pointer_cast<TestAllocator>(options.m_allocator);
+    for (int64_t i = 1; i < 20; ++i) {
+        ASSERT_NE(stream->getNextFrame(), nullptr);
+    }
+    const auto allocations = allocator->getAllocations();
+    ASSERT_TRUE(stream->seekFrame(0));
+    for (int64_t i = 0; i < 20; ++i) {
+        ASSERT_NE(stream->getNextFrame(), nullptr);
+    }
+    ASSERT_LT(allocator->getAllocations() - allocations, 20U);
+}
+
+TEST_P(FilterTest1, letterbox)
+{
+    if (GetParam().m_type != DecodeType::Software) {
+        return;
+    }
+    DecoderOptions options;
+    options.m_scale = {640, 640};
+    options.m_scaleMode = ScaleMode::Letterbox;
+    options.m_crop = GetParam().m_crop;
+    options.m_format = GetParam().m_format;
+    auto stream = Stream::getStream(g_testData[GetParam().m_testDataIndex].m_fileName, options);
+    ASSERT_NE(stream, nullptr);
+    ASSERT_EQ(stream->getWidth(), 640);
+    ASSERT_EQ(stream->getHeight(), 640);
+    const auto frame1 = stream->getNextFrame();
+    ASSERT_NE(frame1, nullptr);
+    ASSERT_EQ(frame1->getWidth(), 640);
+    ASSERT_EQ(frame1->getHeight(), 640);
+
+    // The aspect ratio should be preserved and the cropped source should fit centred within the output
+    const auto transform = stream->getOutputTransform();
+    ASSERT_NEAR(transform.m_scaleX, transform.m_scaleY, 0.01);
+    const auto& crop = GetParam().m_crop;
+    const double left = crop.m_left * transform.m_scaleX + transform.m_offsetX;
+    const double top = crop.m_top * transform.m_scaleY + transform.m_offsetY;
+    const double right =
+        (g_testData[GetParam().m_testDataIndex].m_width - crop.m_right) * transform.m_scaleX + transform.m_offsetX;
+    const double bottom =
+        (g_testData[GetParam().m_testDataIndex].m_height - crop.m_bottom) * transform.m_scaleY + transform.m_offsetY;
+    ASSERT_GE(left, 0.0);
+    ASSERT_GE(top, 0.0);
+    ASSERT_LE(right, 640.5);
+    ASSERT_LE(bottom, 640.5);
+    ASSERT_NEAR(left, 640.0 - right, 2.0);
+    ASSERT_NEAR(top, 640.0 - bottom, 2.0);
+}
+
+TEST_P(FilterTest1, filterStatistics)
+{
+    if (GetParam().m_type != DecodeType::Software) {
+        return;
+    }
+    // Letterboxing always requires a filter graph
+    DecoderOptions options;
+    options.m_scale = {640, 640};
+    options.m_scaleMode = ScaleMode::Letterbox;
+    options.m_format = GetParam().m_format;
+    options.m_filterThreads = 2;
+    auto stream = Stream::getStream(g_testData[GetParam().m_testDataIndex].m_fileName, options);
+    ASSERT_NE(stream, nullptr);
+    for (uint32_t i = 0; i < 5; ++i) {
+        ASSERT_NE(stream->getNextFrame(), nullptr);
+    }
+    const auto statistics = stream->getFilterStatistics();
+    ASSERT_EQ(statistics.m_threads, 2);
+    ASSERT_GE(statistics.m_frames, 5);
+    ASSERT_GT(statistics.m_sendTime + statistics.m_receiveTime, 0);
+
+    // Streams without any filtering should not report statistics
+    auto stream2 = Stream::getStream(g_testData[GetParam().m_testDataIndex].m_fileName, DecoderOptions());
+    ASSERT_NE(stream2, nullptr);
+    ASSERT_EQ(stream2->getFilterStatistics().m_threads, 0);
+}
+
 INSTANTIATE_TEST_SUITE_P(FilterTestData, FilterTest1, ::testing::ValuesIn(g_testDataFilter));
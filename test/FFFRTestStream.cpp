@@ -13,9 +13,13 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include "FFFREncoder.h"
 #include "FFFRTestData.h"
 #include "FFFrameReader.h"
 
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <gtest/gtest.h>
 
 using namespace Ffr;
@@ -35,6 +39,8 @@ protected:
     void TearDown() override
     {
         m_stream.reset();
+        // The memory budget is global so must not be left set by a failed test
+        setMemoryBudget(0);
     }
 
     std::shared_ptr<Stream> m_stream = nullptr;
@@ -75,4 +81,321 @@ TEST_P(StreamTest1, getPixelFormat)
     ASSERT_EQ(m_stream->getPixelFormat(), GetParam().m_format);
 }
 
+TEST_P(StreamTest1, scanPackets)
+{
+    const auto packets = m_stream->scanPackets();
+    ASSERT_FALSE(packets.empty());
+    ASSERT_TRUE(packets.front().m_keyFrame);
+    for (const auto& i : packets) {
+        ASSERT_GT(i.m_size, 0U);
+        if (i.m_timeStamp != INT64_MIN) {
+            ASSERT_LT(i.m_timeStamp, m_stream->getDuration());
+        }
+    }
+    // The stream position must be unaffected by the scan
+    const auto frame = m_stream->getNextFrame();
+    ASSERT_NE(frame, nullptr);
+    ASSERT_EQ(frame->getFrameNumber(), 0);
+}
+
+TEST_P(StreamTest1, probe)
+{
+    const auto info = Stream::probe(GetParam().m_fileName);
+    ASSERT_TRUE(info.m_valid);
+    ASSERT_EQ(info.m_width, GetParam().m_width);
+    ASSERT_EQ(info.m_height, GetParam().m_height);
+    ASSERT_DOUBLE_EQ(info.m_aspectRatio, GetParam().m_aspectRatio);
+    ASSERT_EQ(info.m_totalFrames, GetParam().m_totalFrames);
+    ASSERT_EQ(info.m_duration, GetParam().m_duration);
+    ASSERT_DOUBLE_EQ(info.m_frameRate, GetParam().m_frameRate);
+    ASSERT_EQ(info.m_format, GetParam().m_format);
+    ASSERT_FALSE(info.m_codec.empty());
+    ASSERT_EQ(info.m_intraOnly, m_stream->isIntraOnly());
+}
+
+TEST(StreamTest2, probeMultiple)
+{
+    std::vector<std::string> fileNames;
+    for (const auto& i : g_testData) {
+        fileNames.emplace_back(i.m_fileName);
+    }
+    fileNames.emplace_back("missing.mp4");
+    const auto infos = Stream::probe(fileNames, 1 << 20, 1000000);
+    ASSERT_EQ(infos.size(), fileNames.size());
+    for (size_t i = 0; i < g_testData.size(); ++i) {
+        ASSERT_TRUE(infos[i].m_valid);
+        ASSERT_EQ(infos[i].m_width, g_testData[i].m_width);
+        ASSERT_EQ(infos[i].m_height, g_testData[i].m_height);
+        ASSERT_EQ(infos[i].m_totalFrames, g_testData[i].m_totalFrames);
+        ASSERT_EQ(infos[i].m_duration, g_testData[i].m_duration);
+    }
+    ASSERT_FALSE(infos.back().m_valid);
+}
+
+TEST(StreamTest2, probeMatchesStream)
+{
+    // Containers without stored durations or start times must give the same results as a full stream
+    const auto& testData = g_testData[1];
+    const std::vector<std::string> fileNames = {"probe_raw.h264", "probe_ts.ts", "probe_hevc.mkv"};
+    for (const auto& fileName : fileNames) {
+        auto source = Stream::getStream(testData.m_fileName);
+        ASSERT_NE(source, nullptr);
+        EncoderOptions options;
+        options.m_type = fileName == "probe_hevc.mkv" ? EncodeType::h265 : EncodeType::h264;
+        options.m_preset = EncoderOptions::Preset::Ultrafast;
+        ASSERT_TRUE(Encoder::encodeStream(fileName, source, options));
+
+        const auto info = Stream::probe(fileName);
+        auto stream = Stream::getStream(fileName);
+        ASSERT_TRUE(info.m_valid) << fileName;
+        ASSERT_NE(stream, nullptr) << fileName;
+        ASSERT_EQ(info.m_width, stream->getWidth()) << fileName;
+        ASSERT_EQ(info.m_height, stream->getHeight()) << fileName;
+        ASSERT_EQ(info.m_totalFrames, stream->getTotalFrames()) << fileName;
+        ASSERT_EQ(info.m_duration, stream->getDuration()) << fileName;
+    }
+}
+
+TEST_P(StreamTest1, getMemoryUsage)
+{
+    const auto frame = m_stream->getNextFrame();
+    ASSERT_NE(frame, nullptr);
+    ASSERT_GT(m_stream->getMemoryUsage(), 0U);
+    ASSERT_GE(getMemoryUsage(), m_stream->getMemoryUsage());
+    ASSERT_GE(getPeakMemoryUsage(), getMemoryUsage());
+}
+
+TEST_P(StreamTest1, memoryBudget)
+{
+    DecoderOptions options;
+    options.m_bufferLength = 10;
+    const auto unlimited = Stream::getStream(GetParam().m_fileName, options);
+    ASSERT_NE(unlimited, nullptr);
+    ASSERT_TRUE(unlimited->seekFrame(20));
+
+    // A budget smaller than a single frame must limit each decode block to a single frame
+    setMemoryBudget(1);
+    const auto limited = Stream::getStream(GetParam().m_fileName, options);
+    ASSERT_NE(limited, nullptr);
+    ASSERT_TRUE(limited->seekFrame(20));
+    ASSERT_LT(limited->getMemoryUsage(), unlimited->getMemoryUsage());
+    for (int64_t i = 20; i < 25; ++i) {
+        const auto frame = limited->getNextFrame();
+        ASSERT_NE(frame, nullptr);
+        ASSERT_EQ(frame->getFrameNumber(), i);
+    }
+
+    // Streams block for the wait time before decoding past the budget
+    setMemoryBudget(1, 100);
+    const auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(limited->seekFrame(40));
+    const auto frame = limited->getNextFrame();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    ASSERT_NE(frame, nullptr);
+    ASSERT_EQ(frame->getFrameNumber(), 40);
+    ASSERT_GE(elapsed, std::chrono::milliseconds(100));
+}
+
+TEST_P(StreamTest1, lazyProcessing)
+{
+    DecoderOptions options;
+    options.m_bufferLength = 10;
+    options.m_format = PixelFormat::RGB32FP;
+    const auto stream = Stream::getStream(GetParam().m_fileName, options);
+    ASSERT_NE(stream, nullptr);
+    ASSERT_TRUE(stream->seekFrame(5));
+    const auto frame = stream->getNextFrame();
+    ASSERT_NE(frame, nullptr);
+    ASSERT_EQ(frame->getPixelFormat(), PixelFormat::RGB32FP);
+    ASSERT_EQ(frame->getWidth(), stream->getWidth());
+    // Only the retrieved frame should have been converted, the remaining frames stay in their decoded format
+    const uint64_t convertedSize = static_cast<uint64_t>(stream->getFrameSize()) * options.m_bufferLength;
+    ASSERT_LT(stream->getMemoryUsage(), convertedSize / 2);
+}
+
+TEST_P(StreamTest1, adaptiveBuffer)
+{
+    DecoderOptions options;
+    options.m_bufferLength = 2;
+    options.m_adaptiveBuffer = true;
+    options.m_minBufferLength = 2;
+    options.m_maxBufferLength = 8;
+    const auto stream = Stream::getStream(GetParam().m_fileName, options);
+    ASSERT_NE(stream, nullptr);
+    ASSERT_EQ(stream->getMaxFrames(), 2U);
+    // Sequential reads should grow the buffer up to the maximum
+    for (int64_t i = 0; i < 7; ++i) {
+        const auto frame = stream->getNextFrame();
+        ASSERT_NE(frame, nullptr);
+        ASSERT_EQ(frame->getFrameNumber(), i);
+    }
+    ASSERT_EQ(stream->getMaxFrames(), 8U);
+    // A backward seek should shrink the buffer
+    ASSERT_TRUE(stream->seekFrame(0));
+    ASSERT_LT(stream->getMaxFrames(), 8U);
+    ASSERT_GE(stream->getMaxFrames(), 2U);
+}
+
+TEST_P(StreamTest1, getFramesTensor)
+{
+    const std::vector<int64_t> frameSequence = {0, 1, 2};
+    const auto frames = static_cast<uint32_t>(frameSequence.size());
+    const auto size =
+        getTensorSize(PixelFormat::RGB8P, m_stream->getWidth(), m_stream->getHeight(), frames, TensorType::UInt8);
+    ASSERT_GT(size, 0);
+    std::vector<uint8_t> planar(static_cast<size_t>(size));
+    std::vector<uint8_t> interleaved(static_cast<size_t>(size));
+    ASSERT_EQ(m_stream->getFramesByIndexTensor(
+                  frameSequence, planar.data(), PixelFormat::RGB8P, TensorLayout::NCHW, TensorType::UInt8),
+        frames);
+    ASSERT_EQ(m_stream->getFramesByIndexTensor(
+                  frameSequence, interleaved.data(), PixelFormat::RGB8P, TensorLayout::NHWC, TensorType::UInt8),
+        frames);
+    // Both layouts should hold the same values
+    const size_t planeSize = static_cast<size_t>(m_stream->getWidth()) * m_stream->getHeight();
+    for (size_t frame = 0; frame < frames; ++frame) {
+        for (size_t pixel = 0; pixel < planeSize; pixel += 997) {
+            for (size_t channel = 0; channel < 3; ++channel) {
+                ASSERT_EQ(planar[(frame * 3 + channel) * planeSize + pixel],
+                    interleaved[(frame * planeSize + pixel) * 3 + channel]);
+            }
+        }
+    }
+}
+
+TEST_P(StreamTest1, getFramesTensorNormalise)
+{
+    const std::vector<int64_t> frameSequence = {0};
+    const auto size =
+        getTensorSize(PixelFormat::RGB32FP, m_stream->getWidth(), m_stream->getHeight(), 1, TensorType::Float32);
+    ASSERT_GT(size, 0);
+    std::vector<float> plain(static_cast<size_t>(size) / sizeof(float));
+    std::vector<float> normalised(static_cast<size_t>(size) / sizeof(float));
+    ASSERT_EQ(m_stream->getFramesByIndexTensor(frameSequence, reinterpret_cast<uint8_t*>(plain.data()),
+                  PixelFormat::RGB32FP, TensorLayout::NCHW, TensorType::Float32),
+        1U);
+    ConvertOptions options;
+    options.m_scale = {1.0f / 0.229f, 1.0f / 0.224f, 1.0f / 0.225f};
+    options.m_offset = {-0.485f / 0.229f, -0.456f / 0.224f, -0.406f / 0.225f};
+    options.m_swapRB = true;
+    ASSERT_EQ(m_stream->getFramesByIndexTensor(frameSequence, reinterpret_cast<uint8_t*>(normalised.data()),
+                  PixelFormat::RGB32FP, TensorLayout::NCHW, TensorType::Float32, options),
+        1U);
+    // Normalised values should match a separate normalisation pass with swapped channels
+    const size_t planeSize = static_cast<size_t>(m_stream->getWidth()) * m_stream->getHeight();
+    for (size_t pixel = 0; pixel < planeSize; pixel += 997) {
+        for (size_t channel = 0; channel < 3; ++channel) {
+            ASSERT_NEAR(normalised[(2 - channel) * planeSize + pixel],
+                plain[channel * planeSize + pixel] * options.m_scale[channel] + options.m_offset[channel], 0.0001f);
+        }
+    }
+}
+
+TEST_P(StreamTest1, getFramesTensorHalf)
+{
+    const std::vector<int64_t> frameSequence = {0};
+    const auto sizeFloat =
+        getTensorSize(PixelFormat::RGB32FP, m_stream->getWidth(), m_stream->getHeight(), 1, TensorType::Float32);
+    const auto sizeHalf =
+        getTensorSize(PixelFormat::RGB32FP, m_stream->getWidth(), m_stream->getHeight(), 1, TensorType::Float16);
+    ASSERT_EQ(sizeHalf * 2, sizeFloat);
+    std::vector<float> single(static_cast<size_t>(sizeFloat) / sizeof(float));
+    std::vector<uint16_t> half(static_cast<size_t>(sizeHalf) / sizeof(uint16_t));
+    ASSERT_EQ(m_stream->getFramesByIndexTensor(frameSequence, reinterpret_cast<uint8_t*>(single.data()),
+                  PixelFormat::RGB32FP, TensorLayout::NHWC, TensorType::Float32),
+        1U);
+    ASSERT_EQ(m_stream->getFramesByIndexTensor(frameSequence, reinterpret_cast<uint8_t*>(half.data()),
+                  PixelFormat::RGB32FP, TensorLayout::NHWC, TensorType::Float16),
+        1U);
+    // Half values in the range [0, 1] have at least 11 bits of precision
+    for (size_t i = 0; i < single.size(); i += 997) {
+        const auto exponent = static_cast<int32_t>((half[i] >> 10) & 0x1F);
+        const uint32_t mantissa = half[i] & 0x3FF;
+        const float value = exponent == 0 ? std::ldexp(static_cast<float>(mantissa), -24) :
+                                            std::ldexp(static_cast<float>(mantissa | 0x400), exponent - 25);
+        ASSERT_NEAR(value, single[i], 0.0005f);
+    }
+}
+
+TEST_P(StreamTest1, getFramesTensorUInt8)
+{
+    const std::vector<int64_t> frameSequence = {0};
+    const auto sizeFloat =
+        getTensorSize(PixelFormat::RGB32FP, m_stream->getWidth(), m_stream->getHeight(), 1, TensorType::Float32);
+    const auto sizeByte =
+        getTensorSize(PixelFormat::RGB32FP, m_stream->getWidth(), m_stream->getHeight(), 1, TensorType::UInt8);
+    std::vector<float> single(static_cast<size_t>(sizeFloat) / sizeof(float));
+    std::vector<uint8_t> bytes(static_cast<size_t>(sizeByte));
+    ASSERT_EQ(m_stream->getFramesByIndexTensor(frameSequence, reinterpret_cast<uint8_t*>(single.data()),
+                  PixelFormat::RGB32FP, TensorLayout::NCHW, TensorType::Float32),
+        1U);
+    ASSERT_EQ(m_stream->getFramesByIndexTensor(
+                  frameSequence, bytes.data(), PixelFormat::RGB32FP, TensorLayout::NCHW, TensorType::UInt8),
+        1U);
+    // Byte values are rounded to nearest
+    for (size_t i = 0; i < single.size(); i += 997) {
+        ASSERT_NEAR(static_cast<float>(bytes[i]), single[i] * 255.0f, 0.501f);
+    }
+
+    // Channel swapping is only valid for RGB output
+    ConvertOptions options;
+    options.m_swapRB = true;
+    ASSERT_EQ(m_stream->getFramesByIndexTensor(frameSequence, bytes.data(), PixelFormat::YUV444P, TensorLayout::NCHW,
+                  TensorType::UInt8, options),
+        0U);
+}
+
+TEST(StreamTest2, intraOnlyConcurrent)
+{
+    const auto& testData = g_testData[1];
+    DecoderOptions options;
+    options.m_scale = {640, 360};
+    auto source = Stream::getStream(testData.m_fileName, options);
+    ASSERT_NE(source, nullptr);
+    ASSERT_FALSE(source->isIntraOnly());
+    const std::string fileName = "cache_intra.mkv";
+    ASSERT_TRUE(Encoder::cacheStream(fileName, source));
+
+    // Frames decoded concurrently must match those from a single decoder
+    auto concurrent = Stream::getStream(fileName);
+    ASSERT_NE(concurrent, nullptr);
+    ASSERT_TRUE(concurrent->isIntraOnly());
+    DecoderOptions options2;
+    options2.m_decodeInstances = 1;
+    auto sequential = Stream::getStream(fileName, options2);
+    ASSERT_NE(sequential, nullptr);
+    const std::vector<int64_t> frames = {48, 2, 3, 30, 11, 0, 25, 26, 40, 7};
+    const auto frames1 = concurrent->getFramesByIndex(frames);
+    const auto frames2 = sequential->getFramesByIndex(frames);
+    ASSERT_EQ(frames1.size(), frames.size());
+    ASSERT_EQ(frames2.size(), frames.size());
+    for (size_t i = 0; i < frames.size(); ++i) {
+        ASSERT_EQ(frames1[i]->getFrameNumber(), frames[i]);
+        ASSERT_EQ(frames2[i]->getFrameNumber(), frames[i]);
+        ASSERT_EQ(frames1[i]->getTimeStamp(), frames2[i]->getTimeStamp());
+        const auto data1 = frames1[i]->getFrameData(0);
+        const auto data2 = frames2[i]->getFrameData(0);
+        for (uint32_t y = 0; y < 360; ++y) {
+            ASSERT_EQ(memcmp(data1.first + y * data1.second, data2.first + y * data2.second, 640), 0);
+        }
+    }
+
+    // The stream continues from after the last requested frame in the same way as a sequential retrieval
+    const auto next1 = concurrent->getNextFrame();
+    const auto next2 = sequential->getNextFrame();
+    ASSERT_NE(next1, nullptr);
+    ASSERT_NE(next2, nullptr);
+    ASSERT_EQ(next1->getFrameNumber(), frames.back() + 1);
+    ASSERT_EQ(next2->getFrameNumber(), frames.back() + 1);
+
+    // Frames held by the additional decoders are included in the memory usage
+    ASSERT_GE(concurrent->getMemoryUsage(), sequential->getMemoryUsage());
+
+    // The stream can continue to be used after a concurrent retrieval
+    ASSERT_TRUE(concurrent->seekFrame(20));
+    const auto frame = concurrent->getNextFrame();
+    ASSERT_NE(frame, nullptr);
+    ASSERT_EQ(frame->getFrameNumber(), 20);
+}
+
 INSTANTIATE_TEST_SUITE_P(StreamTestData, StreamTest1, ::testing::ValuesIn(g_testData));